@@ -17,11 +17,50 @@
 *           2015/06/12  1.9 output patch level in header
 *           2016/09/07  1.10 add option -sys
 *-----------------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 199506
 #include <stdarg.h>
+#include <sys/stat.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
 #include "rtklib.h"
 
 #define PROGNAME    "rnx2rtkp"          /* program name */
 #define MAXFILE     16                  /* max number of input files */
+#define MAXARGS     64                  /* max number of arguments of batch job */
+#define MAXTHREAD   256                 /* max number of batch threads */
+#define MAXPRODC    16                  /* max cached precise products */
+
+typedef struct {        /* batch job type */
+    prcopt_t prcopt;    /* processing options */
+    solopt_t solopt;    /* solution options */
+    filopt_t filopt;    /* file options */
+    gtime_t ts,te;      /* processing start/end time */
+    double tint;        /* processing interval (s) */
+    char *infile[MAXFILE]; /* input files */
+    int n;              /* number of input files */
+    char *outfile;      /* output file */
+    char *line;         /* job line (arguments buffer) */
+    double size;        /* rover obs file size (bytes) */
+    int stat;           /* status (0:ok,0>:error,1:aborted,-2:not executed) */
+    double tt;          /* processing time (s) */
+    int nsol,nfix;      /* number of solutions and fixed solutions */
+} job_t;
+
+typedef struct {        /* batch job queue type */
+    int *jobs;          /* job indexes */
+    int head,tail;      /* queue head (stolen) and tail (taken by owner) */
+    rtklib_lock_t lock; /* queue lock */
+} jobq_t;
+
+typedef struct {        /* batch worker type */
+    int id;             /* worker id */
+    int nq;             /* number of workers and queues */
+    jobq_t *q;          /* job queues of all workers */
+    job_t *job;         /* batch jobs */
+} worker_t;
+
+static int batch=0;     /* batch mode */
 
 /* help text -----------------------------------------------------------------*/
 static const char *help[]={
@@ -72,12 +111,26 @@ static const char *help[]={
 " -l lat lon hgt reference (base) receiver latitude/longitude/height (deg/m)",
 "           rover latitude/longitude/height for fixed or ppp-fixed mode",
 " -y level  output solution status (0:off,1:states,2:residuals) [0]",
-" -x level  debug trace level (0:off) [0]"
+" -x level  debug trace level (0:off) [0]",
+" -batch file process batch jobs listed in file [off]",
+" -j n      number of threads for batch jobs [number of cpus]",
+"",
+" In the batch mode, each line of the job list file specifies a job by the",
+" options and the input files in the same form as the command line (\"...\"",
+" for paths with spaces or wild-cards, # for comments). -o file is required for",
+" each job. The command line options and input files are the defaults of all",
+" of the jobs. The input files of the job precede the ones of the command line,",
+" so precise products common to the jobs can be specified in the command line.",
+" The jobs are processed concurrently and a summary of the jobs is output to",
+" stdout. Precise products are read once and shared by the jobs. -x, -y and",
+" external geoid models are not available with the concurrent jobs. Jobs with",
+" invalid options are skipped."
 };
 /* show message --------------------------------------------------------------*/
 extern int showmsg(const char *format, ...)
 {
     va_list arg;
+    if (batch) return 0; /* no progress message for concurrent jobs */
     va_start(arg,format); vfprintf(stderr,format,arg); va_end(arg);
     fprintf(stderr,"\r");
     return 0;
@@ -92,101 +145,466 @@ static void printhelp(void)
     for (i=0;i<(int)(sizeof(help)/sizeof(*help));i++) fprintf(stderr,"%s\n",help[i]);
     exit(0);
 }
-/* rnx2rtkp main -------------------------------------------------------------*/
-int main(int argc, char **argv)
+/* load options from configuration file --------------------------------------*/
+static int loadconf(int argc, char **argv, prcopt_t *prcopt, solopt_t *solopt,
+                    filopt_t *filopt)
 {
-    prcopt_t prcopt=prcopt_default;
-    solopt_t solopt=solopt_default;
-    filopt_t filopt={""};
-    gtime_t ts={0},te={0};
-    double tint=0.0,es[]={2000,1,1,0,0,0},ee[]={2000,12,31,23,59,59},pos[3];
-    int i,j,n,ret;
-    char *infile[MAXFILE],*outfile="",*p;
-
-    prcopt.mode  =PMODE_KINEMA;
-    prcopt.navsys=0;
-    prcopt.refpos=POSOPT_SINGLE;
-    prcopt.glomodear=GLO_ARMODE_ON;
-    solopt.timef=0;
-    sprintf(solopt.prog ,"%s ver.%s %s",PROGNAME,VER_RTKLIB,PATCH_LEVEL);
-    sprintf(filopt.trace,"%s.trace",PROGNAME);
+    int i;
 
-    /* load options from configuration file */
     for (i=1;i<argc;i++) {
         if (!strcmp(argv[i],"-k")&&i+1<argc) {
             resetsysopts();
-            if (!loadopts(argv[++i],sysopts)) return EXIT_FAILURE;
-            getsysopts(&prcopt,&solopt,&filopt);
+            if (!loadopts(argv[++i],sysopts)) return 0;
+            getsysopts(prcopt,solopt,filopt);
         }
     }
-    for (i=1,n=0;i<argc;i++) {
-        if      (!strcmp(argv[i],"-o")&&i+1<argc) outfile=argv[++i];
+    return 1;
+}
+/* get options and input files from arguments ----------------------------------
+* return : index of invalid option or --version in arguments (0:ok)
+*-----------------------------------------------------------------------------*/
+static int getargs(int argc, char **argv, prcopt_t *prcopt, solopt_t *solopt,
+                    filopt_t *filopt, gtime_t *ts, gtime_t *te, double *tint,
+                    char **infile, int *n, char **outfile)
+{
+    double es[]={2000,1,1,0,0,0},ee[]={2000,12,31,23,59,59},pos[3];
+    int i,j;
+    char *p;
+
+    for (i=1;i<argc;i++) {
+        if      (!strcmp(argv[i],"-o")&&i+1<argc) *outfile=argv[++i];
         else if (!strcmp(argv[i],"-ts")&&i+2<argc) {
             sscanf(argv[++i],"%lf/%lf/%lf",es,es+1,es+2);
             sscanf(argv[++i],"%lf:%lf:%lf",es+3,es+4,es+5);
-            ts=epoch2time(es);
+            *ts=epoch2time(es);
         }
         else if (!strcmp(argv[i],"-te")&&i+2<argc) {
             sscanf(argv[++i],"%lf/%lf/%lf",ee,ee+1,ee+2);
             sscanf(argv[++i],"%lf:%lf:%lf",ee+3,ee+4,ee+5);
-            te=epoch2time(ee);
+            *te=epoch2time(ee);
         }
-        else if (!strcmp(argv[i],"-ti")&&i+1<argc) tint=atof(argv[++i]);
+        else if (!strcmp(argv[i],"-ti")&&i+1<argc) *tint=atof(argv[++i]);
         else if (!strcmp(argv[i],"-k")&&i+1<argc) {++i; continue;}
-        else if (!strcmp(argv[i],"-p")&&i+1<argc) prcopt.mode=atoi(argv[++i]);
-        else if (!strcmp(argv[i],"-f")&&i+1<argc) prcopt.nf=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-batch")&&i+1<argc) {++i; continue;}
+        else if (!strcmp(argv[i],"-j")&&i+1<argc) {++i; continue;}
+        else if (!strcmp(argv[i],"-p")&&i+1<argc) prcopt->mode=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-f")&&i+1<argc) prcopt->nf=atoi(argv[++i]);
         else if (!strcmp(argv[i],"-sys")&&i+1<argc) {
-            prcopt.navsys=0;
+            prcopt->navsys=0;
             for (p=argv[++i];*p;p++) {
                 switch (*p) {
-                    case 'G': prcopt.navsys|=SYS_GPS;break;
-                    case 'R': prcopt.navsys|=SYS_GLO;break;
-                    case 'E': prcopt.navsys|=SYS_GAL;break;
-                    case 'J': prcopt.navsys|=SYS_QZS;break;
-                    case 'C': prcopt.navsys|=SYS_CMP;break;
-                    case 'I': prcopt.navsys|=SYS_IRN;break;
+                    case 'G': prcopt->navsys|=SYS_GPS;break;
+                    case 'R': prcopt->navsys|=SYS_GLO;break;
+                    case 'E': prcopt->navsys|=SYS_GAL;break;
+                    case 'J': prcopt->navsys|=SYS_QZS;break;
+                    case 'C': prcopt->navsys|=SYS_CMP;break;
+                    case 'I': prcopt->navsys|=SYS_IRN;break;
                 }
                 if (!(p=strchr(p,','))) break;
             }
         }
-        else if (!strcmp(argv[i],"-m")&&i+1<argc) prcopt.elmin=atof(argv[++i])*D2R;
-        else if (!strcmp(argv[i],"-v")&&i+1<argc) prcopt.thresar[0]=atof(argv[++i]);
-        else if (!strcmp(argv[i],"-s")&&i+1<argc) strcpy(solopt.sep,argv[++i]);
-        else if (!strcmp(argv[i],"-d")&&i+1<argc) solopt.timeu=atoi(argv[++i]);
-        else if (!strcmp(argv[i],"-b")) prcopt.soltype=1;
-        else if (!strcmp(argv[i],"-c")) prcopt.soltype=2;
-        else if (!strcmp(argv[i],"-i")) prcopt.modear=2;
-        else if (!strcmp(argv[i],"-h")) prcopt.modear=3;
-        else if (!strcmp(argv[i],"-t")) solopt.timef=1;
-        else if (!strcmp(argv[i],"-u")) solopt.times=TIMES_UTC;
-        else if (!strcmp(argv[i],"-e")) solopt.posf=SOLF_XYZ;
-        else if (!strcmp(argv[i],"-a")) solopt.posf=SOLF_ENU;
-        else if (!strcmp(argv[i],"-n")) solopt.posf=SOLF_NMEA;
-        else if (!strcmp(argv[i],"-g")) solopt.degf=1;
+        else if (!strcmp(argv[i],"-m")&&i+1<argc) prcopt->elmin=atof(argv[++i])*D2R;
+        else if (!strcmp(argv[i],"-v")&&i+1<argc) prcopt->thresar[0]=atof(argv[++i]);
+        else if (!strcmp(argv[i],"-s")&&i+1<argc) strcpy(solopt->sep,argv[++i]);
+        else if (!strcmp(argv[i],"-d")&&i+1<argc) solopt->timeu=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-b")) prcopt->soltype=1;
+        else if (!strcmp(argv[i],"-c")) prcopt->soltype=2;
+        else if (!strcmp(argv[i],"-i")) prcopt->modear=2;
+        else if (!strcmp(argv[i],"-h")) prcopt->modear=3;
+        else if (!strcmp(argv[i],"-t")) solopt->timef=1;
+        else if (!strcmp(argv[i],"-u")) solopt->times=TIMES_UTC;
+        else if (!strcmp(argv[i],"-e")) solopt->posf=SOLF_XYZ;
+        else if (!strcmp(argv[i],"-a")) solopt->posf=SOLF_ENU;
+        else if (!strcmp(argv[i],"-n")) solopt->posf=SOLF_NMEA;
+        else if (!strcmp(argv[i],"-g")) solopt->degf=1;
         else if (!strcmp(argv[i],"-bl")&&i+2<argc) {
-            for (j=0;j<2;j++) prcopt.baseline[j]=atof(argv[++i]);
+            for (j=0;j<2;j++) prcopt->baseline[j]=atof(argv[++i]);
         }
         else if (!strcmp(argv[i],"-r")&&i+3<argc) {
-            prcopt.refpos=prcopt.rovpos=0;
-            for (j=0;j<3;j++) prcopt.rb[j]=atof(argv[++i]);
-            matcpy(prcopt.ru,prcopt.rb,3,1);
+            prcopt->refpos=prcopt->rovpos=0;
+            for (j=0;j<3;j++) prcopt->rb[j]=atof(argv[++i]);
+            matcpy(prcopt->ru,prcopt->rb,3,1);
         }
         else if (!strcmp(argv[i],"-l")&&i+3<argc) {
-            prcopt.refpos=prcopt.rovpos=0;
+            prcopt->refpos=prcopt->rovpos=0;
             for (j=0;j<3;j++) pos[j]=atof(argv[++i]);
             for (j=0;j<2;j++) pos[j]*=D2R;
-            pos2ecef(pos,prcopt.rb);
-            matcpy(prcopt.ru,prcopt.rb,3,1);
+            pos2ecef(pos,prcopt->rb);
+            matcpy(prcopt->ru,prcopt->rb,3,1);
+        }
+        else if (!strcmp(argv[i],"-y")&&i+1<argc) solopt->sstat=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-x")&&i+1<argc) solopt->trace=atoi(argv[++i]);
+        else if (*argv[i]=='-') return i;
+        else if (*n<MAXFILE) infile[(*n)++]=argv[i];
+    }
+    return 0;
+}
+/* default options -----------------------------------------------------------*/
+static void defopts(prcopt_t *prcopt, solopt_t *solopt, filopt_t *filopt)
+{
+    filopt_t filopt0={""};
+
+    *prcopt=prcopt_default;
+    *solopt=solopt_default;
+    *filopt=filopt0;
+    prcopt->mode  =PMODE_KINEMA;
+    prcopt->navsys=0;
+    prcopt->refpos=POSOPT_SINGLE;
+    prcopt->glomodear=GLO_ARMODE_ON;
+    solopt->timef=0;
+    sprintf(solopt->prog ,"%s ver.%s %s",PROGNAME,VER_RTKLIB,PATCH_LEVEL);
+    sprintf(filopt->trace,"%s.trace",PROGNAME);
+}
+/* split job line into arguments ---------------------------------------------*/
+static int splitargs(char *buff, char **args, int nmax)
+{
+    char *p=buff;
+    int n=1;
+
+    args[0]=PROGNAME;
+
+    while (n<nmax) {
+        while (*p==' '||*p=='\t'||*p=='\r'||*p=='\n') p++;
+        if (!*p||*p=='#') break;
+        if (*p=='"') {
+            args[n++]=++p;
+            if (!(p=strchr(p,'"'))) break;
+        }
+        else {
+            args[n++]=p;
+            while (*p&&*p!=' '&&*p!='\t'&&*p!='\r'&&*p!='\n') p++;
+            if (!*p) break;
+        }
+        *p++='\0';
+    }
+    return n;
+}
+/* read batch jobs -------------------------------------------------------------
+* options of each job: program defaults, configuration file (-k) of the job or
+* of the command line, command line options and job options in this order.
+* input files of each job: job input files and command line input files.
+*-----------------------------------------------------------------------------*/
+static job_t *readjobs(const char *file, int argc, char **argv, int *njob)
+{
+    FILE *fp;
+    job_t *job=NULL,*p;
+    struct stat st;
+    char buff[4096],*args[MAXARGS],*infile[MAXFILE],*outfile;
+    int i,n,nmax=0,nin;
+
+    *njob=0;
+
+    if (!(fp=fopen(file,"r"))) {
+        fprintf(stderr,"job list file open error: %s\n",file);
+        return NULL;
+    }
+    while (fgets(buff,sizeof(buff),fp)) {
+        if (*njob>=nmax) {
+            nmax=nmax<=0?64:nmax*2;
+            if (!(p=(job_t *)realloc(job,sizeof(job_t)*nmax))) break;
+            job=p;
+        }
+        p=job+*njob;
+        memset(p,0,sizeof(job_t));
+        if (!(p->line=(char *)malloc(strlen(buff)+1))) break;
+        strcpy(p->line,buff);
+
+        if ((n=splitargs(p->line,args,MAXARGS))<=1) {
+            free(p->line);
+            continue;
+        }
+        defopts(&p->prcopt,&p->solopt,&p->filopt);
+
+        for (i=1;i<n;i++) if (!strcmp(args[i],"-k")) break;
+        if (!(i<n?loadconf(n,args,&p->prcopt,&p->solopt,&p->filopt):
+                   loadconf(argc,argv,&p->prcopt,&p->solopt,&p->filopt))) {
+            fprintf(stderr,"job %d: option load error\n",*njob+1);
+            free(p->line);
+            continue;
+        }
+        nin=0; outfile="";
+        getargs(argc,argv,&p->prcopt,&p->solopt,&p->filopt,&p->ts,&p->te,
+                &p->tint,infile,&nin,&outfile); /* checked in main() */
+        if ((i=getargs(n,args,&p->prcopt,&p->solopt,&p->filopt,&p->ts,&p->te,
+                       &p->tint,p->infile,&p->n,&p->outfile))) {
+            fprintf(stderr,"job %d: invalid option %s (skipped)\n",*njob+1,
+                    args[i]);
+            free(p->line);
+            continue;
+        }
+        for (i=0;i<nin&&p->n<MAXFILE;i++) p->infile[p->n++]=infile[i];
+
+        if (!p->prcopt.navsys) {
+            p->prcopt.navsys=SYS_GPS|SYS_GLO;
+        }
+        if (p->n<=0||!p->outfile||!*p->outfile) {
+            fprintf(stderr,"job %d: no input file or output file\n",*njob+1);
+            free(p->line);
+            continue;
+        }
+        p->size=stat(p->infile[0],&st)?0.0:(double)st.st_size;
+        p->stat=-2;
+        (*njob)++;
+    }
+    fclose(fp);
+    return job;
+}
+/* number of processors ------------------------------------------------------*/
+static int ncpu(void)
+{
+#ifdef WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n=sysconf(_SC_NPROCESSORS_ONLN);
+    return n>0?(int)n:1;
+#endif
+}
+/* take job from own queue or steal job from other queue ---------------------*/
+static int takejob(worker_t *w)
+{
+    jobq_t *q;
+    int i,k,n,nmax,ijob=-1;
+
+    /* take last job from own queue */
+    q=w->q+w->id;
+    rtklib_lock(&q->lock);
+    if (q->head<q->tail) ijob=q->jobs[--q->tail];
+    rtklib_unlock(&q->lock);
+    if (ijob>=0) return ijob;
+
+    /* steal first job from queue with most remaining jobs */
+    for (;;) {
+        for (i=0,k=-1,nmax=0;i<w->nq;i++) {
+            q=w->q+i;
+            rtklib_lock(&q->lock);
+            n=q->tail-q->head;
+            rtklib_unlock(&q->lock);
+            if (n>nmax) {
+                nmax=n; k=i;
+            }
+        }
+        if (k<0) return -1;
+
+        q=w->q+k;
+        rtklib_lock(&q->lock);
+        if (q->head<q->tail) ijob=q->jobs[q->head++];
+        rtklib_unlock(&q->lock);
+        if (ijob>=0) return ijob;
+    }
+}
+/* execute batch job ---------------------------------------------------------*/
+static void execjob(job_t *job)
+{
+    postctx_t *ctx;
+    solbuf_t solbuf;
+    char *outfile=job->outfile;
+    int i;
+
+    if (!(ctx=(postctx_t *)malloc(sizeof(postctx_t)))) {
+        job->stat=-1;
+        return;
+    }
+    job->tt=(double)tickget();
+    postctxinit(ctx,NULL,NULL);
+    job->stat=postposc(ctx,job->ts,job->te,job->tint,0.0,&job->prcopt,
+                       &job->solopt,&job->filopt,job->infile,job->n,
+                       job->outfile,"","");
+    job->tt=((double)tickget()-job->tt)*1E-3;
+    postctxfree(ctx);
+    free(ctx);
+
+    /* count solutions in output file */
+    if (job->stat==0&&readsol(&outfile,1,&solbuf)) {
+        job->nsol=solbuf.n;
+        for (i=0;i<solbuf.n;i++) if (solbuf.data[i].stat==SOLQ_FIX) job->nfix++;
+        freesolbuf(&solbuf);
+    }
+}
+/* batch worker thread -------------------------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI worker(void *arg)
+#else
+static void *worker(void *arg)
+#endif
+{
+    worker_t *w=(worker_t *)arg;
+    int ijob;
+
+    while ((ijob=takejob(w))>=0) execjob(w->job+ijob);
+    return 0;
+}
+/* compare batch jobs by rover obs file size (descending) --------------------*/
+static int cmpjob(const void *p1, const void *p2)
+{
+    const job_t *q1=*(const job_t **)p1,*q2=*(const job_t **)p2;
+    return q1->size<q2->size?1:(q1->size>q2->size?-1:(int)(q1-q2));
+}
+/* output batch summary ------------------------------------------------------*/
+static void outsummary(FILE *fp, const job_t *job, int njob, int nthread,
+                       double tt)
+{
+    const char *stat;
+    double ttj=0.0;
+    int i,nok=0;
+
+    fprintf(fp,"%% %4s %-7s %9s %7s %7s %6s  %s\n","job","status","time(s)",
+            "nsol","nfix","fix(%)","output");
+    for (i=0;i<njob;i++) {
+        if      (job[i].stat== 0) stat=job[i].nsol>0?"ok":"nosol";
+        else if (job[i].stat== 1) stat="aborted";
+        else if (job[i].stat==-2) stat="skipped";
+        else                      stat="error";
+        if (job[i].stat==0&&job[i].nsol>0) nok++;
+        ttj+=job[i].tt;
+        fprintf(fp,"  %4d %-7s %9.2f %7d %7d %6.1f  %s\n",i+1,stat,job[i].tt,
+                job[i].nsol,job[i].nfix,
+                job[i].nsol>0?100.0*job[i].nfix/job[i].nsol:0.0,job[i].outfile);
+    }
+    fprintf(fp,"%% jobs=%d ok=%d threads=%d time=%.2fs (total of jobs %.2fs)\n",
+            njob,nok,nthread,tt,ttj);
+}
+/* execute batch jobs --------------------------------------------------------*/
+static int execbatch(const char *file, int nthread, int argc, char **argv)
+{
+    job_t *job,**sorted;
+    jobq_t q[MAXTHREAD];
+    worker_t w[MAXTHREAD];
+    rtklib_thread_t thread[MAXTHREAD];
+    uint32_t tick;
+    int i,njob,nerr=0,started[MAXTHREAD]={0};
+
+    if (!(job=readjobs(file,argc,argv,&njob))||njob<=0) {
+        fprintf(stderr,"error : no batch job\n");
+        free(job);
+        return EXIT_FAILURE;
+    }
+    if (nthread<=0) nthread=ncpu();
+    if (nthread>njob) nthread=njob;
+    if (nthread>MAXTHREAD) nthread=MAXTHREAD;
+
+    /* debug trace, solution status and external geoid are process-wide */
+    for (i=0;i<njob&&nthread>1;i++) {
+        if (job[i].solopt.trace>0||job[i].solopt.sstat>0||
+            (job[i].solopt.geoid>0&&*job[i].filopt.geoid)) {
+            fprintf(stderr,"job %d: -x, -y or external geoid model not "
+                    "available for concurrent jobs (use -j 1)\n",i+1);
+            nerr++;
+        }
+    }
+    if (nerr) {
+        for (i=0;i<njob;i++) free(job[i].line);
+        free(job);
+        return EXIT_FAILURE;
+    }
+    /* deal jobs to queues in descending order of rover obs file size */
+    if (!(sorted=(job_t **)malloc(sizeof(job_t *)*njob))) {
+        fprintf(stderr,"error : memory allocation\n");
+        for (i=0;i<njob;i++) free(job[i].line);
+        free(job);
+        return EXIT_FAILURE;
+    }
+    for (i=0;i<njob;i++) sorted[i]=job+i;
+    qsort(sorted,njob,sizeof(job_t *),cmpjob);
+
+    for (i=0;i<nthread;i++) {
+        if (!(q[i].jobs=(int *)malloc(sizeof(int)*(njob/nthread+1)))) break;
+        q[i].head=q[i].tail=0;
+        rtklib_initlock(&q[i].lock);
+        w[i].id=i; w[i].nq=nthread; w[i].q=q; w[i].job=job;
+    }
+    if (i<nthread) {
+        fprintf(stderr,"error : memory allocation\n");
+        while (--i>=0) {
+            rtklib_destroylock(&q[i].lock);
+            free(q[i].jobs);
         }
-        else if (!strcmp(argv[i],"-y")&&i+1<argc) solopt.sstat=atoi(argv[++i]);
-        else if (!strcmp(argv[i],"-x")&&i+1<argc) solopt.trace=atoi(argv[++i]);
-        else if (!strcmp(argv[i], "--version")) {
-            fprintf(stderr, "rnx2rtkp RTKLIB %s %s\n", VER_RTKLIB, PATCH_LEVEL);
-            exit(0);
+        for (i=0;i<njob;i++) free(job[i].line);
+        free(sorted);
+        free(job);
+        return EXIT_FAILURE;
+    }
+    for (i=njob-1;i>=0;i--) { /* owner takes from tail: largest first */
+        q[i%nthread].jobs[q[i%nthread].tail++]=(int)(sorted[i]-job);
+    }
+    free(sorted);
+
+    /* share precise products among jobs */
+    setprodcache(MAXPRODC);
+    batch=nthread>1;
+
+    tick=tickget();
+
+    /* jobs of the workers not started are stolen by the others */
+    for (i=1;i<nthread;i++) {
+#ifdef WIN32
+        started[i]=(thread[i]=CreateThread(NULL,0,worker,w+i,0,NULL))!=NULL;
+#else
+        started[i]=!pthread_create(thread+i,NULL,worker,w+i);
+#endif
+        if (!started[i]) fprintf(stderr,"worker %d: thread create error\n",i);
+    }
+    worker(w);
+
+    for (i=1;i<nthread;i++) {
+        if (!started[i]) continue;
+#ifdef WIN32
+        WaitForSingleObject(thread[i],INFINITE);
+        CloseHandle(thread[i]);
+#else
+        pthread_join(thread[i],NULL);
+#endif
+    }
+    batch=0;
+    freeprodcache();
+
+    outsummary(stdout,job,njob,nthread,(tickget()-tick)*1E-3);
+
+    for (i=0;i<njob;i++) {
+        if (job[i].stat!=0||job[i].nsol<=0) nerr++;
+        free(job[i].line);
+    }
+    for (i=0;i<nthread;i++) {
+        rtklib_destroylock(&q[i].lock);
+        free(q[i].jobs);
+    }
+    free(job);
+    return nerr?EXIT_FAILURE:0;
+}
+/* rnx2rtkp main -------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    prcopt_t prcopt;
+    solopt_t solopt;
+    filopt_t filopt;
+    gtime_t ts={0},te={0};
+    double tint=0.0;
+    int i,n=0,ret,nthread=0;
+    char *infile[MAXFILE],*outfile="",*jobfile=NULL;
+
+    defopts(&prcopt,&solopt,&filopt);
+
+    for (i=1;i<argc;i++) {
+        if      (!strcmp(argv[i],"-batch")&&i+1<argc) jobfile=argv[++i];
+        else if (!strcmp(argv[i],"-j")&&i+1<argc) nthread=atoi(argv[++i]);
+    }
+    /* load options from configuration file */
+    if (!jobfile&&!loadconf(argc,argv,&prcopt,&solopt,&filopt)) {
+        return EXIT_FAILURE;
+    }
+    if ((i=getargs(argc,argv,&prcopt,&solopt,&filopt,&ts,&te,&tint,infile,&n,
+                   &outfile))) {
+        if (!strcmp(argv[i],"--version")) {
+            fprintf(stderr,"rnx2rtkp RTKLIB %s %s\n",VER_RTKLIB,PATCH_LEVEL);
+            return 0;
         }
-        else if (*argv[i]=='-') printhelp();
-        else if (n<MAXFILE) infile[n++]=argv[i];
+        printhelp();
+    }
+    if (jobfile) {
+        return execbatch(jobfile,nthread,argc,argv);
     }
+
     if (!prcopt.navsys) {
         prcopt.navsys=SYS_GPS|SYS_GLO;
     }
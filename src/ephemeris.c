@@ -93,6 +93,7 @@
 
 #define ERREPH_GLO 5.0            /* error of glonass ephemeris (m) */
 #define TSTEP    60.0             /* integration step glonass ephemeris (s) */
+#define NGLONODE 32               /* max integration nodes of glonass cache */
 #define RTOL_KEPLER 1E-13         /* relative tolerance for Kepler equation */
 
 #define DEFURASSR 0.15            /* default accuracy of ssr corr (m) */
@@ -204,25 +205,62 @@ extern double eph2clk(gtime_t time, const eph_t *eph)
 
     return eph->f0+eph->f1*t+eph->f2*t*t;
 }
-/* broadcast ephemeris to satellite position and clock bias --------------------
-* compute satellite position and clock bias with broadcast ephemeris (gps,
-* galileo, qzss)
-* args   : gtime_t time     I   time (gpst)
-*          eph_t *eph       I   broadcast ephemeris
-*          double *rs       O   satellite position (ecef) {x,y,z} (m)
-*          double *dts      O   satellite clock bias (s)
-*          double *var      O   satellite position and clock variance (m^2)
+/* derived constants of broadcast ephemeris -------------------------------*/
+static void setephc(const eph_t *eph, ephc_t *c)
+{
+    int prn;
+    
+    c->sat=eph->sat;
+    c->A=eph->A; c->e=eph->e; c->deln=eph->deln; c->toes=eph->toes;
+    c->OMGd=eph->OMGd;
+    
+    switch ((c->sys=satsys(eph->sat,&prn))) {
+        case SYS_GAL: c->mu=MU_GAL; c->omge=OMGE_GAL; break;
+        case SYS_CMP: c->mu=MU_CMP; c->omge=OMGE_CMP; break;
+        default:      c->mu=MU_GPS; c->omge=OMGE;     break;
+    }
+    c->geo=c->sys==SYS_CMP&&(prn<=5||prn>=59); /* ref [9] table 4-1 */
+    c->n=sqrt(c->mu/(eph->A*eph->A*eph->A))+eph->deln;
+    c->sqe=sqrt(1.0-eph->e*eph->e);
+    c->OMGdo=eph->OMGd-c->omge;
+    c->omgt=c->omge*eph->toes;
+    c->rel=2.0*sqrt(c->mu*eph->A)*eph->e;
+}
+/* test derived constants valid for ephemeris --------------------------------*/
+static int validephc(const eph_t *eph)
+{
+    const ephc_t *c=&eph->c;
+    
+    return c->sat==eph->sat&&c->sat>0&&c->A==eph->A&&c->e==eph->e&&
+           c->deln==eph->deln&&c->toes==eph->toes&&c->OMGd==eph->OMGd;
+}
+/* precompute derived constants of broadcast ephemeris -------------------------
+* precompute the constants of broadcast ephemeris used by eph2pos()
+* args   : eph_t  *eph      IO  broadcast ephemeris
 * return : none
-* notes  : see ref [1],[7],[8]
-*          satellite clock includes relativity correction without code bias
-*          (tgd or bgd)
+* notes  : the constants are stored in eph->c with the orbit parameters they
+*          are derived from. eph2pos() uses them only if the parameters are
+*          unchanged and computes them otherwise, so the results are the same.
 *-----------------------------------------------------------------------------*/
-extern void eph2pos(gtime_t time, const eph_t *eph, double *rs, double *dts,
-                    double *var)
+extern void ephconst(eph_t *eph)
 {
-    double tk,M,E,Ek,sinE,cosE,u,r,i,O,sin2u,cos2u,x,y,sinO,cosO,cosi,mu,omge;
+    ephc_t c0={0};
+    
+    if (eph->sat<=0||eph->A<=0.0) {
+        eph->c=c0;
+        return;
+    }
+    setephc(eph,&eph->c);
+}
+/* broadcast ephemeris to satellite position and clock bias ------------------*/
+static void ephtopos(gtime_t time, const eph_t *eph, int warm, double *Es,
+                     double *rs, double *dts, double *var)
+{
+    const ephc_t *c=&eph->c;
+    ephc_t c0;
+    double tk,M,E,Ek,sinE,cosE,u,r,i,O,sin2u,cos2u,x,y,sinO,cosO,cosi;
     double xg,yg,zg,sino,coso;
-    int n,sys,prn;
+    int n;
 
     trace(4,"eph2pos : time=%s sat=%2d\n",time_str(time,3),eph->sat);
 
@@ -230,26 +268,26 @@ extern void eph2pos(gtime_t time, const eph_t *eph, double *rs, double *dts,
         rs[0]=rs[1]=rs[2]=*dts=*var=0.0;
         return;
     }
+    if (!validephc(eph)) {
+        setephc(eph,&c0);
+        c=&c0;
+    }
     tk=timediff(time,eph->toe);
 
-    switch ((sys=satsys(eph->sat,&prn))) {
-        case SYS_GAL: mu=MU_GAL; omge=OMGE_GAL; break;
-        case SYS_CMP: mu=MU_CMP; omge=OMGE_CMP; break;
-        default:      mu=MU_GPS; omge=OMGE;     break;
-    }
-    M=eph->M0+(sqrt(mu/(eph->A*eph->A*eph->A))+eph->deln)*tk;
+    M=eph->M0+c->n*tk;
 
-    for (n=0,E=M,Ek=0.0;fabs(E-Ek)>RTOL_KEPLER&&n<MAX_ITER_KEPLER;n++) {
+    for (n=0,E=warm?*Es:M,Ek=0.0;fabs(E-Ek)>RTOL_KEPLER&&n<MAX_ITER_KEPLER;n++) {
         Ek=E; E-=(E-eph->e*sin(E)-M)/(1.0-eph->e*cos(E));
     }
     if (n>=MAX_ITER_KEPLER) {
         trace(2,"eph2pos: kepler iteration overflow sat=%2d\n",eph->sat);
     }
     sinE=sin(E); cosE=cos(E);
+    if (Es) *Es=E;
 
     trace(4,"kepler: sat=%2d e=%8.5f n=%2d del=%10.3e\n",eph->sat,eph->e,n,E-Ek);
 
-    u=atan2(sqrt(1.0-eph->e*eph->e)*sinE,cosE-eph->e)+eph->omg;
+    u=atan2(c->sqe*sinE,cosE-eph->e)+eph->omg;
     r=eph->A*(1.0-eph->e*cosE);
     i=eph->i0+eph->idot*tk;
     sin2u=sin(2.0*u); cos2u=cos(2.0*u);
@@ -259,19 +297,19 @@ extern void eph2pos(gtime_t time, const eph_t *eph, double *rs, double *dts,
     x=r*cos(u); y=r*sin(u); cosi=cos(i);
 
     /* beidou geo satellite */
-    if (sys==SYS_CMP&&(prn<=5||prn>=59)) { /* ref [9] table 4-1 */
-        O=eph->OMG0+eph->OMGd*tk-omge*eph->toes;
+    if (c->geo) {
+        O=eph->OMG0+eph->OMGd*tk-c->omgt;
         sinO=sin(O); cosO=cos(O);
         xg=x*cosO-y*cosi*sinO;
         yg=x*sinO+y*cosi*cosO;
         zg=y*sin(i);
-        sino=sin(omge*tk); coso=cos(omge*tk);
+        sino=sin(c->omge*tk); coso=cos(c->omge*tk);
         rs[0]= xg*coso+yg*sino*COS_5+zg*sino*SIN_5;
         rs[1]=-xg*sino+yg*coso*COS_5+zg*coso*SIN_5;
         rs[2]=-yg*SIN_5+zg*COS_5;
     }
     else {
-        O=eph->OMG0+(eph->OMGd-omge)*tk-omge*eph->toes;
+        O=eph->OMG0+c->OMGdo*tk-c->omgt;
         sinO=sin(O); cosO=cos(O);
         rs[0]=x*cosO-y*cosi*sinO;
         rs[1]=x*sinO+y*cosi*cosO;
@@ -281,13 +319,31 @@ extern void eph2pos(gtime_t time, const eph_t *eph, double *rs, double *dts,
     *dts=eph->f0+eph->f1*tk+eph->f2*tk*tk;
 
     /* relativity correction */
-    *dts-=2.0*sqrt(mu*eph->A)*eph->e*sinE/SQR(CLIGHT);
+    *dts-=c->rel*sinE/SQR(CLIGHT);
 
     /* position and clock error variance */
-    *var=var_uraeph(sys,eph->sva);
+    *var=var_uraeph(c->sys,eph->sva);
     trace(4,"eph2pos: sat=%d, dts=%.10f rs=%.4f %.4f %.4f var=%.3f\n",eph->sat,
         *dts,rs[0],rs[1],rs[2],*var);
 }
+/* broadcast ephemeris to satellite position and clock bias --------------------
+* compute satellite position and clock bias with broadcast ephemeris (gps,
+* galileo, qzss)
+* args   : gtime_t time     I   time (gpst)
+*          eph_t *eph       I   broadcast ephemeris
+*          double *rs       O   satellite position (ecef) {x,y,z} (m)
+*          double *dts      O   satellite clock bias (s)
+*          double *var      O   satellite position and clock variance (m^2)
+* return : none
+* notes  : see ref [1],[7],[8]
+*          satellite clock includes relativity correction without code bias
+*          (tgd or bgd)
+*-----------------------------------------------------------------------------*/
+extern void eph2pos(gtime_t time, const eph_t *eph, double *rs, double *dts,
+                    double *var)
+{
+    ephtopos(time,eph,0,NULL,rs,dts,var);
+}
 /* glonass orbit differential equations --------------------------------------*/
 static void deq(const double *x, double *xdot, const double *acc)
 {
@@ -341,6 +397,72 @@ extern double geph2clk(gtime_t time, const geph_t *geph)
         geph->gamn);
     return -geph->taun+geph->gamn*t;
 }
+/* glonass orbit integration cache -------------------------------------------*/
+typedef struct {        /* glonass orbit integration cache type */
+    gtime_t toe;        /* toe of ephemeris integrated */
+    double pos[3],vel[3],acc[3]; /* initial state of ephemeris integrated */
+    int n[2];           /* number of nodes {forward,backward} */
+    double x[2][NGLONODE+1][6]; /* states at nodes k*TSTEP from toe */
+} gloc_t;
+
+static rtklib_tls gloc_t gloc[MAXPRNGLO+1];
+
+/* glonass state at integration node -------------------------------------------
+* get glonass position and velocity at the last full integration step before
+* the time. the states at the steps from toe are cached per satellite, so the
+* integration continues from the nearest cached step instead of toe. the
+* steps are the same as the integration from toe and the results are the same
+* as without the cache.
+* args   : geph_t *geph     I   glonass ephemeris
+*          double *t        IO  time from toe (s) (O: time from node)
+*          double *x        O   state at node {pos,vel} (ecef) (m,m/s)
+* return : none
+*-----------------------------------------------------------------------------*/
+static void glonode(const geph_t *geph, double *t, double *x)
+{
+    gloc_t *c=NULL;
+    double tt=*t<0.0?-TSTEP:TSTEP;
+    int i,j,k,prn,dir=*t<0.0;
+
+    /* number of full steps and time from node */
+    for (k=0;fabs(*t)>=TSTEP;k++) *t-=tt;
+
+    if (satsys(geph->sat,&prn)==SYS_GLO&&prn>=1&&prn<=MAXPRNGLO) {
+        c=gloc+prn;
+        if (timediff(c->toe,geph->toe)!=0.0||
+            memcmp(c->pos,geph->pos,sizeof(c->pos))||
+            memcmp(c->vel,geph->vel,sizeof(c->vel))||
+            memcmp(c->acc,geph->acc,sizeof(c->acc))) {
+            c->toe=geph->toe;
+            matcpy(c->pos,geph->pos,3,1);
+            matcpy(c->vel,geph->vel,3,1);
+            matcpy(c->acc,geph->acc,3,1);
+            c->n[0]=c->n[1]=0;
+        }
+    }
+    if (!c||c->n[dir]<=0) {
+        for (i=0;i<3;i++) {
+            x[i  ]=geph->pos[i];
+            x[i+3]=geph->vel[i];
+        }
+        j=0;
+        if (c) {
+            matcpy(c->x[dir][0],x,6,1);
+            c->n[dir]=1;
+        }
+    }
+    else {
+        j=k<c->n[dir]-1?k:c->n[dir]-1;
+        matcpy(x,c->x[dir][j],6,1);
+    }
+    for (;j<k;j++) {
+        glorbit(tt,x,geph->acc);
+        if (c&&j+1==c->n[dir]&&j+1<=NGLONODE) {
+            matcpy(c->x[dir][j+1],x,6,1);
+            c->n[dir]++;
+        }
+    }
+}
 /* glonass ephemeris to satellite position and clock bias ----------------------
 * compute satellite position and clock bias with glonass ephemeris
 * args   : gtime_t time     I   time (gpst)
@@ -354,8 +476,7 @@ extern double geph2clk(gtime_t time, const geph_t *geph)
 extern void geph2pos(gtime_t time, const geph_t *geph, double *rs, double *dts,
                      double *var)
 {
-    double t,tt,x[6];
-    int i;
+    double t,x[6];
 
     trace(4,"geph2pos: time=%s sat=%2d\n",time_str(time,3),geph->sat);
 
@@ -364,15 +485,12 @@ extern void geph2pos(gtime_t time, const geph_t *geph, double *rs, double *dts,
     *dts=-geph->taun+geph->gamn*t;
     trace(4,"geph2pos: sat=%d\n",geph->sat);
 
-    for (i=0;i<3;i++) {
-        x[i  ]=geph->pos[i];
-        x[i+3]=geph->vel[i];
-    }
-    for (tt=t<0.0?-TSTEP:TSTEP;fabs(t)>1E-9;t-=tt) {
-        if (fabs(t)<TSTEP) tt=t;
-        glorbit(tt,x,geph->acc);
-    }
-    for (i=0;i<3;i++) rs[i]=x[i];
+    glonode(geph,&t,x);
+
+    /* last partial step from integration node */
+    if (fabs(t)>1E-9) glorbit(t,x,geph->acc);
+
+    rs[0]=x[0]; rs[1]=x[1]; rs[2]=x[2];
 
     *var=SQR(ERREPH_GLO);
 }
@@ -424,41 +542,115 @@ extern void seph2pos(gtime_t time, const seph_t *seph, double *rs, double *dts,
 
     *var=var_uraeph(SYS_SBS,seph->sva);
 }
+/* ephemeris index search hints (last position by index type and sat) -------*/
+static rtklib_tls int idxhint[3][MAXSAT];
+
+/* test ephemeris index valid ------------------------------------------------*/
+static int validx(const navidx_t *ix, const void *eph, int n, const nav_t *nav)
+{
+    return ix->eph&&ix->eph==eph&&ix->n==n&&ix->ver==nav->nver;
+}
+/* search ephemeris index ------------------------------------------------------
+* search position of first toe after time in index entries of satellite. the
+* position of the last search for the satellite is tried first.
+*-----------------------------------------------------------------------------*/
+static int srchidx(const navidx_t *ix, int type, int sat, gtime_t time)
+{
+    int i=ix->off[sat-1],j=ix->off[sat],k,*h=&idxhint[type][sat-1];
+    
+    if (*h>=i&&*h<=j&&(*h==i||timediff(ix->toe[*h-1],time)<=0.0)&&
+        (*h==j||timediff(ix->toe[*h],time)>0.0)) {
+        return *h;
+    }
+    while (i<j) {
+        k=(i+j)/2;
+        if (timediff(ix->toe[k],time)<=0.0) i=k+1; else j=k;
+    }
+    return *h=i;
+}
+/* test ephemeris for selection ----------------------------------------------*/
+static int testeph(const eph_t *eph, int iode, int sys, gtime_t time)
+{
+    int sel;
+    
+    if (iode>=0&&eph->iode!=iode) return 0;
+    if (sys==SYS_GAL) {
+        sel=getseleph(SYS_GAL);
+        /* this code is from 2.4.3 b34 but does not seem to be fully supported,
+           so for now I have dropped back to the b33 code */
+        /* if (sel==0&&!(eph->code&(1<<9))) return 0; */ /* I/NAV */
+        /*if (sel==1&&!(eph->code&(1<<8))) return 0; */ /* F/NAV */
+        if (sel==1&&!(eph->code&(1<<9))) return 0; /* I/NAV */
+        if (sel==2&&!(eph->code&(1<<8))) return 0; /* F/NAV */
+        if (timediff(eph->toe,time)>=0.0) return 0; /* AOD<=0 */
+    }
+    return 1;
+}
+/* select ephemeris by index ---------------------------------------------------
+* same selection as the linear search: with iode, the first ephemeris (in
+* array order) matching iode within tmax; without iode, the ephemeris with toe
+* closest to time, the last one in array order among equal distances.
+* entries are scanned outward from time and the scan stops beyond tmax or the
+* closest distance found.
+*-----------------------------------------------------------------------------*/
+static int selidx(const navidx_t *ix, int type, int sat, int iode, gtime_t time,
+                  double tmax, const nav_t *nav, int sys, double *tmin)
+{
+    const int dir[2]={-1,1};
+    double t;
+    int i,j=-1,k,d,p,lo=ix->off[sat-1],hi=ix->off[sat];
+    
+    if (lo>=hi) return -1;
+    p=srchidx(ix,type,sat,time);
+    
+    for (d=0;d<2;d++) {
+        for (k=d?p:p-1;k>=lo&&k<hi;k+=dir[d]) {
+            t=fabs(timediff(ix->toe[k],time));
+            if (t>tmax||(iode<0&&j>=0&&t>*tmin)) break;
+            i=ix->idx[k];
+            if (type==0&&!testeph(nav->eph+i,iode,sys,time)) continue;
+            if (type==1&&iode>=0&&nav->geph[i].iode!=iode) continue;
+            if (iode>=0) {
+                if (j<0||i<j) j=i;
+            }
+            else if (j<0||t<*tmin||(t==*tmin&&i>j)) {
+                j=i; *tmin=t;
+            }
+        }
+    }
+    return j;
+}
 /* select ephemeris --------------------------------------------------------*/
 static eph_t *seleph(gtime_t time, int sat, int iode, const nav_t *nav)
 {
     double t,tmax,tmin;
-    int i,j=-1,sys,sel=0;
+    int i,j=-1,sys;
 
     trace(4,"seleph  : time=%s sat=%2d iode=%d\n",time_str(time,3),sat,iode);
 
     sys=satsys(sat,NULL);
     switch (sys) {
-        case SYS_GPS: tmax=MAXDTOE+1.0    ; sel=eph_sel[0]; break;
-        case SYS_GAL: tmax=MAXDTOE_GAL    ; sel=eph_sel[2]; break;
-        case SYS_QZS: tmax=MAXDTOE_QZS+1.0; sel=eph_sel[3]; break;
-        case SYS_CMP: tmax=MAXDTOE_CMP+1.0; sel=eph_sel[4]; break;
-        case SYS_IRN: tmax=MAXDTOE_IRN+1.0; sel=eph_sel[5]; break;
+        case SYS_GPS: tmax=MAXDTOE+1.0    ; break;
+        case SYS_GAL: tmax=MAXDTOE_GAL    ; break;
+        case SYS_QZS: tmax=MAXDTOE_QZS+1.0; break;
+        case SYS_CMP: tmax=MAXDTOE_CMP+1.0; break;
+        case SYS_IRN: tmax=MAXDTOE_IRN+1.0; break;
         default: tmax=MAXDTOE+1.0; break;
     }
     tmin=tmax+1.0;
 
-    for (i=0;i<nav->n;i++) {
-        if (nav->eph[i].sat!=sat) continue;
-        if (iode>=0&&nav->eph[i].iode!=iode) continue;
-        if (sys==SYS_GAL) {
-            sel=getseleph(SYS_GAL);
-            /* this code is from 2.4.3 b34 but does not seem to be fully supported,
-               so for now I have dropped back to the b33 code */
-            /* if (sel==0&&!(nav->eph[i].code&(1<<9))) continue; */ /* I/NAV */
-            /*if (sel==1&&!(nav->eph[i].code&(1<<8))) continue; */ /* F/NAV */
-            if (sel==1&&!(nav->eph[i].code&(1<<9))) continue; /* I/NAV */
-            if (sel==2&&!(nav->eph[i].code&(1<<8))) continue; /* F/NAV */
-            if (timediff(nav->eph[i].toe,time)>=0.0) continue; /* AOD<=0 */
+    if (validx(&nav->ieph,nav->eph,nav->n,nav)) {
+        j=selidx(&nav->ieph,0,sat,iode,time,tmax,nav,sys,&tmin);
+        if (iode>=0&&j>=0) return nav->eph+j;
+    }
+    else {
+        for (i=0;i<nav->n;i++) {
+            if (nav->eph[i].sat!=sat) continue;
+            if (!testeph(nav->eph+i,iode,sys,time)) continue;
+            if ((t=fabs(timediff(nav->eph[i].toe,time)))>tmax) continue;
+            if (iode>=0) return nav->eph+i;
+            if (t<=tmin) {j=i; tmin=t;} /* toe closest to time */
         }
-        if ((t=fabs(timediff(nav->eph[i].toe,time)))>tmax) continue;
-        if (iode>=0) return nav->eph+i;
-        if (t<=tmin) {j=i; tmin=t;} /* toe closest to time */
     }
     if (iode>=0||j<0) {
         trace(2,"no broadcast ephemeris: %s sat=%2d iode=%3d\n",time_str(time,0),
@@ -476,12 +668,18 @@ static geph_t *selgeph(gtime_t time, int sat, int iode, const nav_t *nav)
 
     trace(4,"selgeph : time=%s sat=%2d iode=%2d\n",time_str(time,3),sat,iode);
 
-    for (i=0;i<nav->ng;i++) {
-        if (nav->geph[i].sat!=sat) continue;
-        if (iode>=0&&nav->geph[i].iode!=iode) continue;
-        if ((t=fabs(timediff(nav->geph[i].toe,time)))>tmax) continue;
-        if (iode>=0) return nav->geph+i;
-        if (t<=tmin) {j=i; tmin=t;} /* toe closest to time */
+    if (validx(&nav->igeph,nav->geph,nav->ng,nav)) {
+        j=selidx(&nav->igeph,1,sat,iode,time,tmax,nav,SYS_GLO,&tmin);
+        if (iode>=0&&j>=0) return nav->geph+j;
+    }
+    else {
+        for (i=0;i<nav->ng;i++) {
+            if (nav->geph[i].sat!=sat) continue;
+            if (iode>=0&&nav->geph[i].iode!=iode) continue;
+            if ((t=fabs(timediff(nav->geph[i].toe,time)))>tmax) continue;
+            if (iode>=0) return nav->geph+i;
+            if (t<=tmin) {j=i; tmin=t;} /* toe closest to time */
+        }
     }
     if (iode>=0||j<0) {
         trace(3,"no glonass ephemeris  : %s sat=%2d iode=%2d\n",time_str(time,0),
@@ -499,10 +697,15 @@ static seph_t *selseph(gtime_t time, int sat, const nav_t *nav)
 
     trace(4,"selseph : time=%s sat=%2d\n",time_str(time,3),sat);
 
-    for (i=0;i<nav->ns;i++) {
-        if (nav->seph[i].sat!=sat) continue;
-        if ((t=fabs(timediff(nav->seph[i].t0,time)))>tmax) continue;
-        if (t<=tmin) {j=i; tmin=t;} /* toe closest to time */
+    if (validx(&nav->iseph,nav->seph,nav->ns,nav)) {
+        j=selidx(&nav->iseph,2,sat,-1,time,tmax,nav,SYS_SBS,&tmin);
+    }
+    else {
+        for (i=0;i<nav->ns;i++) {
+            if (nav->seph[i].sat!=sat) continue;
+            if ((t=fabs(timediff(nav->seph[i].t0,time)))>tmax) continue;
+            if (t<=tmin) {j=i; tmin=t;} /* toe closest to time */
+        }
     }
     if (j<0) {
         trace(3,"no sbas ephemeris     : %s sat=%2d\n",time_str(time,0),sat);
@@ -547,7 +750,7 @@ static int ephpos(gtime_t time, gtime_t teph, int sat, const nav_t *nav,
     eph_t  *eph;
     geph_t *geph;
     seph_t *seph;
-    double rst[3],dtst[1],tt=1E-3;
+    double rst[3],dtst[1],E,tt=1E-3;
     int i,sys;
 
     trace(4,"ephpos  : time=%s sat=%2d iode=%d\n",time_str(time,3),sat,iode);
@@ -558,9 +761,9 @@ static int ephpos(gtime_t time, gtime_t teph, int sat, const nav_t *nav,
 
     if (sys==SYS_GPS||sys==SYS_GAL||sys==SYS_QZS||sys==SYS_CMP||sys==SYS_IRN) {
         if (!(eph=seleph(teph,sat,iode,nav))) return 0;
-        eph2pos(time,eph,rs,dts,var);
+        ephtopos(time,eph,0,&E,rs,dts,var);
         time=timeadd(time,tt);
-        eph2pos(time,eph,rst,dtst,var);
+        ephtopos(time,eph,1,&E,rst,dtst,var); /* start kepler at E of time */
         *svh=eph->svh;
     }
     else if (sys==SYS_GLO) {
@@ -746,6 +949,87 @@ extern int satpos(gtime_t time, gtime_t teph, int sat, int ephopt,
     *svh=-1;
     return 0;
 }
+/* satellite state cache (per thread) ----------------------------------------*/
+#define NSATC    4                /* number of cached states per satellite */
+
+typedef struct {        /* cached satellite state type */
+    const nav_t *nav;   /* navigation data */
+    int ephopt;         /* ephemeris option */
+    gtime_t teph;       /* time to select ephemeris */
+    gtime_t time;       /* transmission time */
+    double rs[6];       /* satellite position/velocity */
+    double dts[2];      /* satellite clock bias/drift */
+    double var;         /* satellite position and clock variance */
+    int svh;            /* satellite health flag */
+    int stat;           /* status of satpos() */
+} satc_t;
+
+static rtklib_tls int satc_ena=0;       /* cache enabled */
+static rtklib_tls double satc_tol=0.0;  /* time tolerance (s) */
+static rtklib_tls int satc_n[MAXSAT];   /* number of cached states */
+static rtklib_tls satc_t satc[MAXSAT][NSATC]; /* cached states */
+
+/* set satellite state cache ---------------------------------------------------
+* enable or disable the satellite state cache of the calling thread. the cache
+* is cleared in both cases.
+* args   : int    ena       I   enable (1) or disable (0) cache
+*          double tol       I   tolerance of transmission time (s)
+* return : none
+* notes  : while enabled, satposs() reuses the state computed by satpos() for
+*          the same satellite, navigation data, ephemeris option and time to
+*          select ephemeris if the transmission times differ by tol or less.
+*          the reused state is extrapolated to the transmission time by the
+*          satellite velocity and clock drift. with tol=0, only states at the
+*          identical transmission time are reused and the results are the same
+*          as without the cache.
+*          call it with ena=1 at start of an epoch and with ena=0 at the end,
+*          as the cache is not invalidated by changes of navigation data.
+*-----------------------------------------------------------------------------*/
+extern void setsatcache(int ena, double tol)
+{
+    int i;
+    
+    for (i=0;i<MAXSAT;i++) satc_n[i]=0;
+    satc_ena=ena;
+    satc_tol=tol<0.0?0.0:tol;
+}
+/* satellite position and clock with cache -----------------------------------*/
+static int satposc(gtime_t time, gtime_t teph, int sat, int ephopt,
+                   const nav_t *nav, double *rs, double *dts, double *var,
+                   int *svh)
+{
+    satc_t *p;
+    double dt;
+    int i,j,n;
+    
+    if (!satc_ena||sat<1||sat>MAXSAT) {
+        return satpos(time,teph,sat,ephopt,nav,rs,dts,var,svh);
+    }
+    n=satc_n[sat-1];
+    for (i=0;i<n&&i<NSATC;i++) {
+        p=satc[sat-1]+i;
+        if (p->nav!=nav||p->ephopt!=ephopt||timediff(p->teph,teph)!=0.0) {
+            continue;
+        }
+        if (fabs(dt=timediff(time,p->time))>satc_tol) continue;
+        
+        for (j=0;j<3;j++) rs[j]=p->rs[j]+p->rs[j+3]*dt;
+        for (j=3;j<6;j++) rs[j]=p->rs[j];
+        dts[0]=p->dts[0]+p->dts[1]*dt;
+        dts[1]=p->dts[1];
+        *var=p->var; *svh=p->svh;
+        trace(4,"satposc: sat=%2d dt=%.9f cached\n",sat,dt);
+        return p->stat;
+    }
+    p=satc[sat-1]+n%NSATC;
+    p->stat=satpos(time,teph,sat,ephopt,nav,rs,dts,var,svh);
+    p->nav=nav; p->ephopt=ephopt; p->teph=teph; p->time=time;
+    for (i=0;i<6;i++) p->rs[i]=rs[i];
+    p->dts[0]=dts[0]; p->dts[1]=dts[1];
+    p->var=*var; p->svh=*svh;
+    satc_n[sat-1]=n+1;
+    return p->stat;
+}
 /* satellite positions and clocks ----------------------------------------------
 * compute satellite positions, velocities and clocks
 * args   : gtime_t teph     I   time to select ephemeris (gpst)
@@ -769,6 +1053,7 @@ extern int satpos(gtime_t time, gtime_t teph, int sat, int ephopt,
 *          satellite clock does not include code bias correction (tgd or bgd)
 *          any pseudorange and broadcast ephemeris are always needed to get
 *          signal transmission time
+*          satellite states are reused if the cache is enabled by setsatcache()
 *-----------------------------------------------------------------------------*/
 extern void satposs(gtime_t teph, const obsd_t *obs, int n, const nav_t *nav,
                     int ephopt, double *rs, double *dts, double *var, int *svh)
@@ -802,8 +1087,8 @@ extern void satposs(gtime_t teph, const obsd_t *obs, int n, const nav_t *nav,
         time[i]=timeadd(time[i],-dt);
 
         /* satellite position and clock at transmission time */
-        if (!satpos(time[i],teph,obs[i].sat,ephopt,nav,rs+i*6,dts+i*2,var+i,
-                    svh+i)) {
+        if (!satposc(time[i],teph,obs[i].sat,ephopt,nav,rs+i*6,dts+i*2,var+i,
+                     svh+i)) {
             trace(3,"no ephemeris %s sat=%2d\n",time_str(time[i],3),obs[i].sat);
             continue;
         }
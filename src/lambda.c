@@ -25,10 +25,10 @@
 #define SWAP(x,y)   do {double tmp_; tmp_=x; x=y; y=tmp_;} while (0)
 
 /* LD factorization (Q=L'*diag(D)*L) -----------------------------------------*/
-static int LD(int n, const double *Q, double *L, double *D)
+static int LD(int n, const double *Q, double *L, double *D, wsp_t *ws)
 {
-    int i,j,k,info=0;
-    double a,*A=mat(n,n);
+    int i,j,k,info=0,mark=wspmark(ws);
+    double a,*A=wspmat(ws,n,n);
     
     memcpy(A,Q,sizeof(double)*n*n);
     for (i=n-1;i>=0;i--) {
@@ -38,7 +38,7 @@ static int LD(int n, const double *Q, double *L, double *D)
         for (j=0;j<=i-1;j++) for (k=0;k<=j;k++) A[j+k*n]-=L[i+k*n]*L[i+j*n];
         for (j=0;j<=i;j++) L[i+j*n]/=L[i+i*n];
     }
-    free(A);
+    wsprelease(ws,mark);
     if (info) fprintf(stderr,"%s : LD factorization error\n",__FILE__);
     return info;
 }
@@ -71,9 +71,9 @@ static void perm(int n, double *L, double *D, int j, double del, double *Z)
     for (k=0;k<n;k++) SWAP(Z[k+j*n],Z[k+(j+1)*n]);
 }
 /* lambda reduction (z=Z'*a, Qz=Z'*Q*Z=L'*diag(D)*L) (ref.[1]) ---------------*/
-static void reduction(int n, double *L, double *D, double *Z)
+static int reduction(int n, double *L, double *D, double *Z)
 {
-    int i,j,k;
+    int i,j,k,np=0;
     double del;
     
     j=n-2; k=n-2;
@@ -82,10 +82,31 @@ static void reduction(int n, double *L, double *D, double *Z)
         del=D[j]+L[j+1+j*n]*L[j+1+j*n]*D[j+1];
         if (del+1E-6<D[j+1]) { /* compared considering numerical error */
             perm(n,L,D,j,del,Z);
-            k=j; j=n-2;
+            k=j; j=n-2; np++;
         }
         else j--;
     }
+    return np;
+}
+/* restore max-heap of candidate slots by sift-down --------------------------*/
+static void siftdown(int *h, int nh, const double *s, int i)
+{
+    int c,t;
+    
+    for (;(c=2*i+1)<nh;i=c) {
+        if (c+1<nh&&s[h[c+1]]>s[h[c]]) c++;
+        if (s[h[c]]<=s[h[i]]) break;
+        t=h[i]; h[i]=h[c]; h[c]=t;
+    }
+}
+/* restore max-heap of candidate slots by sift-up ----------------------------*/
+static void siftup(int *h, const double *s, int i)
+{
+    int p,t;
+    
+    for (;i>0&&s[h[p=(i-1)/2]]<s[h[i]];i=p) {
+        t=h[i]; h[i]=h[p]; h[p]=t;
+    }
 }
 /* modified lambda (mlambda) search (ref. [2]) -------------------------------
 * args   : n      I  number of float parameters
@@ -93,13 +114,29 @@ static void reduction(int n, double *L, double *D, double *Z)
            L,D    I  transformed covariance matrix
            zs     I  transformed double-diff phase biases
            zn     O  fixed solutions
-           s      O  sum of residuals for fixed solutions                    */
+           s      O  sum of residuals for fixed solutions
+           ws     IO workspace
+           stat   O  search statistics (NULL: no output)
+* notes  : the partial sums S and the factor L are held row-major in the loop
+*          so that the update of level k walks contiguous memory. candidates
+*          are kept in a max-heap of slots keyed by s; the root is the one to
+*          be replaced and gives the shrinking search radius.                */
 static int search(int n, int m, const double *L, const double *D,
-                  const double *zs, double *zn, double *s)
+                  const double *zs, double *zn, double *s, wsp_t *ws,
+                  lambstat_t *stat)
 {
-    int i,j,k,c,nn=0,imax=0;
-    double newdist,maxdist=1E99,y;
-    double *S=zeros(n,n),*dist=mat(n,1),*zb=mat(n,1),*z=mat(n,1),*step=mat(n,1);
+    int i,j,k,c,nn=0,nnode=0,ncand=0,mark=wspmark(ws),*h;
+    double newdist,maxdist=1E99,y,dz,*Sk,*Sk1,*Lk1;
+    double *S,*LR,*dist,*zb,*z,*step,*E,*t;
+    
+    S=wspmat(ws,n,n); LR=wspmat(ws,n,n);
+    dist=wspmat(ws,n,1); zb=wspmat(ws,n,1); z=wspmat(ws,n,1);
+    step=wspmat(ws,n,1); E=wspmat(ws,n,m); t=wspmat(ws,m,1);
+    h=wspimat(ws,m,1);
+    
+    /* row-major copy of lower triangle of L */
+    for (i=0;i<n;i++) for (j=0;j<=i;j++) LR[i*n+j]=L[i+j*n];
+    for (i=0;i<n;i++) S[(n-1)*n+i]=0.0;
     
     k=n-1; dist[k]=0.0;
     zb[k]=zs[k];
@@ -109,30 +146,35 @@ static int search(int n, int m, const double *L, const double *D,
     for (c=0;c<LOOPMAX;c++) {
         newdist=dist[k]+y*y/D[k];  /* newdist=sum(((z(j)-zb(j))^2/d(j))) */
         if (newdist<maxdist) {
+            nnode++;
+            
             /* Case 1: move down */
             if (k!=0) {
                 dist[--k]=newdist;
-                for (i=0;i<=k;i++)
-                    S[k+i*n]=S[k+1+i*n]+(z[k+1]-zb[k+1])*L[k+1+i*n];
-                zb[k]=zs[k]+S[k+k*n];
+                Sk=S+k*n; Sk1=Sk+n; Lk1=LR+(k+1)*n; dz=z[k+1]-zb[k+1];
+                for (i=0;i<=k;i++) Sk[i]=Sk1[i]+dz*Lk1[i];
+                zb[k]=zs[k]+Sk[k];
                 z[k]=ROUND(zb[k]); /* next valid integer */
                 y=zb[k]-z[k];
                 step[k]=SGN(y);
             }
             /* Case 2: store the found candidate and try next valid integer */
             else {
+                ncand++;
                 if (nn<m) {  /* store the first m initial points */
-                    if (nn==0||newdist>s[imax]) imax=nn;
                     for (i=0;i<n;i++) zn[i+nn*n]=z[i];
-                    s[nn++]=newdist;
+                    s[nn]=newdist;
+                    h[nn]=nn;
+                    siftup(h,s,nn++);
                 }
                 else {
-                    if (newdist<s[imax]) {
-                        for (i=0;i<n;i++) zn[i+imax*n]=z[i];
-                        s[imax]=newdist;
-                        for (i=imax=0;i<m;i++) if (s[imax]<s[i]) imax=i;
+                    if (newdist<s[h[0]]) { /* replace worst candidate */
+                        j=h[0];
+                        for (i=0;i<n;i++) zn[i+j*n]=z[i];
+                        s[j]=newdist;
+                        siftdown(h,m,s,0);
                     }
-                    maxdist=s[imax];
+                    maxdist=s[h[0]];
                 }
                 z[0]+=step[0]; /* next valid integer */
                 y=zb[0]-z[0];
@@ -150,14 +192,24 @@ static int search(int n, int m, const double *L, const double *D,
             }
         }
     }
-    for (i=0;i<m-1;i++) { /* sort by s */
-        for (j=i+1;j<m;j++) {
-            if (s[i]<s[j]) continue;
-            SWAP(s[i],s[j]);
-            for (k=0;k<n;k++) SWAP(zn[k+i*n],zn[k+j*n]);
-        }
+    /* sort by s (heap sort of slots, then permute candidates) */
+    for (i=nn-1;i>0;i--) {
+        j=h[0]; h[0]=h[i]; h[i]=j;
+        siftdown(h,i,s,0);
+    }
+    for (i=0;i<nn;i++) {
+        t[i]=s[h[i]];
+        memcpy(E+i*n,zn+h[i]*n,sizeof(double)*n);
+    }
+    for (i=0;i<nn;i++) s[i]=t[i];
+    memcpy(zn,E,sizeof(double)*n*nn);
+    
+    if (stat) {
+        stat->nloop=c;
+        stat->nnode=nnode;
+        stat->ncand=ncand;
     }
-    free(S); free(dist); free(zb); free(z); free(step);
+    wsprelease(ws,mark);
     
     if (c>=LOOPMAX) {
         fprintf(stderr,"%s : search loop count overflow\n",__FILE__);
@@ -180,28 +232,100 @@ static int search(int n, int m, const double *L, const double *D,
 extern int lambda(int n, int m, const double *a, const double *Q, double *F,
                   double *s)
 {
+    wsp_t ws;
     int info;
-    double *L,*D,*Z,*z,*E;
     
+    wspinit(&ws,0);
+    info=lambdaw(n,m,a,Q,F,s,NULL,&ws,NULL);
+    wspfree(&ws);
+    return info;
+}
+/* lambda/mlambda with workspace -----------------------------------------------
+* integer least-square estimation as lambda() with scratch matrices taken from
+* a caller-owned workspace, optional warm-start of the reduction and search
+* statistics output
+* args   : int    n      I  number of float parameters
+*          int    m      I  number of fixed solutions
+*          double *a     I  float parameters (n x 1) (double-diff phase biases)
+*          double *Q     I  covariance matrix of float parameters (n x n)
+*          double *F     O  fixed solutions (n x m)
+*          double *s     O  sum of squared residulas of fixed solutions (1 x m)
+*          double *Z     IO reduction matrix (n x n) (NULL: not used)
+*                           input : initial integer unimodular transformation
+*                                   (identity for cold start)
+*                           output: reduction matrix of this estimation
+*          wsp_t  *ws    IO workspace (released to entry mark on return)
+*          lambstat_t *stat O search statistics (NULL: no output)
+* return : status (0:ok,other:error)
+* notes  : with a Z of the previous epoch for the same ambiguities, Q is first
+*          transformed by Z and the reduction only has to repair the
+*          decorrelation, which needs few permutations if Q changes slowly.
+*          with Z, the fixed solutions are rounded to the integers, removing
+*          the error of the back-transformation F=Z'\E which depends on Z, so
+*          the warm and cold starts give identical results. they can differ
+*          from those without Z (not rounded) by the error (~1E-6 cycle).
+*          if the factorization of the transformed Q fails, the estimation
+*          falls back to the cold start.
+*-----------------------------------------------------------------------------*/
+extern int lambdaw(int n, int m, const double *a, const double *Q, double *F,
+                   double *s, double *Z, wsp_t *ws, lambstat_t *stat)
+{
+    int i,info,warm=0,mark;
+    double *L,*D,*Zt,*z,*E,*QZ,*Qz;
+    
+    if (stat) stat->nloop=stat->nnode=stat->ncand=stat->nperm=0;
     if (n<=0||m<=0) return -1;
-    L=zeros(n,n); D=mat(n,1); Z=eye(n); z=mat(n,1); E=mat(n,m);
     
-    /* LD (lower diagonal) factorization (Q=L'*diag(D)*L) */
-    if (!(info=LD(n,Q,L,D))) {
+    mark=wspmark(ws);
+    L=wspzeros(ws,n,n); D=wspmat(ws,n,1); Zt=wspzeros(ws,n,n);
+    z=wspmat(ws,n,1); E=wspmat(ws,n,m);
+    
+    /* warm start if initial transformation is not identity */
+    if (Z) {
+        for (i=0;i<n*n;i++) {
+            if (Z[i]!=(i%(n+1)==0?1.0:0.0)) {warm=1; break;}
+        }
+    }
+    if (warm) {
+        QZ=wspmat(ws,n,n); Qz=wspmat(ws,n,n);
+        matmul("NN",n,n,n,Q,Z,QZ);
+        matmul("TN",n,n,n,Z,QZ,Qz); /* Qz=Z'*Q*Z */
+        
+        if (!LD(n,Qz,L,D,ws)) {
+            matcpy(Zt,Z,n,n);
+        }
+        else {
+            trace(2,"lambdaw: warm start failed n=%d\n",n);
+            for (i=0;i<n*n;i++) L[i]=0.0;
+            warm=0;
+        }
+    }
+    if (!warm) {
+        for (i=0;i<n;i++) Zt[i+i*n]=1.0;
+        info=LD(n,Q,L,D,ws); /* LD (lower diagonal) factorization (Q=L'*diag(D)*L) */
+    }
+    else info=0;
+    
+    if (!info) {
         
         /* lambda reduction (z=Z'*a, Qz=Z'*Q*Z=L'*diag(D)*L) */
-        reduction(n,L,D,Z);
-        matmul("TN",n,1,n,Z,a,z); /* z=Z'*a */
+        i=reduction(n,L,D,Zt);
+        if (stat) stat->nperm=i;
+        matmul("TN",n,1,n,Zt,a,z); /* z=Z'*a */
         
         /* mlambda search 
             z = transformed double-diff phase biases
             L,D = transformed covariance matrix */
-        if (!(info=search(n,m,L,D,z,E,s))) {  /* returns 0 if no error */
+        if (!(info=search(n,m,L,D,z,E,s,ws,stat))) {  /* returns 0 if no error */
+            
+            info=solve("T",Zt,E,n,m,F); /* F=Z'\E */
             
-            info=solve("T",Z,E,n,m,F); /* F=Z'\E */
+            /* round off error of back-transformation depending on Z */
+            if (Z) for (i=0;i<n*m;i++) F[i]=ROUND(F[i]);
         }
+        if (Z) matcpy(Z,Zt,n,n);
     }
-    free(L); free(D); free(Z); free(z); free(E);
+    wsprelease(ws,mark);
     return info;
 }
 /* lambda reduction ------------------------------------------------------------
@@ -213,25 +337,27 @@ extern int lambda(int n, int m, const double *a, const double *Q, double *F,
 *-----------------------------------------------------------------------------*/
 extern int lambda_reduction(int n, const double *Q, double *Z)
 {
+    wsp_t ws;
     double *L,*D;
     int i,j,info;
     
     if (n<=0) return -1;
     
-    L=zeros(n,n); D=mat(n,1);
+    wspinit(&ws,0);
+    L=wspzeros(&ws,n,n); D=wspmat(&ws,n,1);
     
     for (i=0;i<n;i++) for (j=0;j<n;j++) {
         Z[i+j*n]=i==j?1.0:0.0;
     }
     /* LD factorization */
-    if ((info=LD(n,Q,L,D))) {
-        free(L); free(D);
+    if ((info=LD(n,Q,L,D,&ws))) {
+        wspfree(&ws);
         return info;
     }
     /* lambda reduction */
     reduction(n,L,D,Z);
      
-    free(L); free(D);
+    wspfree(&ws);
     return 0;
 }
 /* mlambda search --------------------------------------------------------------
@@ -247,21 +373,23 @@ extern int lambda_reduction(int n, const double *Q, double *Z)
 extern int lambda_search(int n, int m, const double *a, const double *Q,
                          double *F, double *s)
 {
+    wsp_t ws;
     double *L,*D;
     int info;
     
     if (n<=0||m<=0) return -1;
     
-    L=zeros(n,n); D=mat(n,1);
+    wspinit(&ws,0);
+    L=wspzeros(&ws,n,n); D=wspmat(&ws,n,1);
     
     /* LD factorization */
-    if ((info=LD(n,Q,L,D))) {
-        free(L); free(D);
+    if ((info=LD(n,Q,L,D,&ws))) {
+        wspfree(&ws);
         return info;
     }
     /* mlambda search */
-    info=search(n,m,L,D,a,F,s);
+    info=search(n,m,L,D,a,F,s,&ws,NULL);
     
-    free(L); free(D);
+    wspfree(&ws);
     return info;
 }
@@ -92,6 +92,7 @@ EXPORT opt_t sysopts[]={
     {"pos2-gloarmode",  3,  (void *)&prcopt_.glomodear,  GAROPT },
     {"pos2-bdsarmode",  3,  (void *)&prcopt_.bdsmodear,  SWTOPT },
     {"pos2-arfilter",   3,  (void *)&prcopt_.arfilter,   SWTOPT },
+    {"pos2-arwarm",     3,  (void *)&prcopt_.arwarm,     SWTOPT },
     {"pos2-arthres",    1,  (void *)&prcopt_.thresar[0], ""     },
     {"pos2-arthresmin", 1,  (void *)&prcopt_.thresar[5], ""     },
     {"pos2-arthresmax", 1,  (void *)&prcopt_.thresar[6], ""     },
@@ -117,6 +118,12 @@ EXPORT opt_t sysopts[]={
     {"pos2-rejionno",   1,  (void *)&prcopt_.maxinno[0], "m"    },
     {"pos2-rejcode",    1,  (void *)&prcopt_.maxinno[1], "m"    },
     {"pos2-niter",      0,  (void *)&prcopt_.niter,      ""     },
+    {"pos2-seqfilter",  3,  (void *)&prcopt_.seqfilter,  SWTOPT },
+    {"pos2-sattol",     1,  (void *)&prcopt_.sattol,     "s"    },
+    {"pos2-pephcheb",   3,  (void *)&prcopt_.pephcheb,   SWTOPT },
+    {"pos2-pephstrm",   3,  (void *)&prcopt_.pephstrm,   SWTOPT },
+    {"pos2-nthread",    0,  (void *)&prcopt_.nthread,    ""     },
+    {"pos2-sunmoonint", 1,  (void *)&prcopt_.sunmoonint, "s"    },
     {"pos2-baselen",    1,  (void *)&prcopt_.baseline[0],"m"    },
     {"pos2-basesig",    1,  (void *)&prcopt_.baseline[1],"m"    },
     
@@ -44,6 +44,8 @@
 *                            delete function to use L2 instead of L5 PCV
 *                            writing solution file in binary mode
 *-----------------------------------------------------------------------------*/
+#include <sys/stat.h>
+#include <sys/types.h>
 #include "rtklib.h"
 
 #define MIN(x,y)    ((x)<(y)?(x):(y))
@@ -51,40 +53,51 @@
 
 #define MAXPRCDAYS  100          /* max days of continuous processing */
 #define MAXINFILE   1000         /* max number of input files */
-#define MAXINVALIDTM 100         /* max number of invalid time marks */
-
-/* constants/global variables ------------------------------------------------*/
-
-static pcvs_t pcvss={0};        /* satellite antenna parameters */
-static pcvs_t pcvsr={0};        /* receiver antenna parameters */
-static obs_t obss={0};          /* observation data */
-static nav_t navs={0};          /* navigation data */
-static sbs_t sbss={0};          /* sbas messages */
-static sta_t stas[MAXRCV];      /* station information */
-static int nepoch=0;            /* number of observation epochs */
-static int nitm  =0;            /* number of invalid time marks */
-static int iobsu =0;            /* current rover observation data index */
-static int iobsr =0;            /* current reference observation data index */
-static int isbs  =0;            /* current sbas message index */
-static int iitm  =0;            /* current invalid time mark index */
-static int reverse=0;           /* analysis direction (0:forward,1:backward) */
-static int aborts=0;            /* abort status */
-static sol_t *solf;             /* forward solutions */
-static sol_t *solb;             /* backward solutions */
-static double *rbf;             /* forward base positions */
-static double *rbb;             /* backward base positions */
-static int isolf=0;             /* current forward solutions index */
-static int isolb=0;             /* current backward solutions index */
-static char proc_rov [64]="";   /* rover for current processing */
-static char proc_base[64]="";   /* base station for current processing */
-static char rtcm_file[1024]=""; /* rtcm data file */
-static char rtcm_path[1024]=""; /* rtcm data path */
-static gtime_t invalidtm[MAXINVALIDTM]={{0}};/* invalid time marks */
-static rtcm_t rtcm;             /* rtcm control struct */
-static FILE *fp_rtcm=NULL;      /* rtcm data file pointer */
+
+#define PROD_PEPH   0            /* product type: precise ephemeris */
+#define PROD_PCLK   1            /* product type: precise clock */
+#define PROD_TEC    2            /* product type: tec grid */
+#define PROD_PCVS   3            /* product type: satellite antenna */
+#define PROD_PCVR   4            /* product type: receiver antenna */
+
+/* type definitions ----------------------------------------------------------*/
+typedef struct prodent_tag { /* precise product cache entry */
+    int type;           /* product type (PROD_???) */
+    char *key;          /* paths, sizes and modified times of product files */
+    int nref;           /* number of references by sessions */
+    int stat;           /* status (0:loading,1:loaded,-1:error) */
+    rtklib_lock_t lock; /* lock held while loading or fitting */
+    pephs_t pephs;      /* precise ephemeris (compact storage) */
+    pclk_t *pclk;       /* precise clock */
+    tec_t *tec;         /* tec grid data */
+    pephc_t pephc;      /* precise ephemeris coefficients (fitted on request) */
+    int n;              /* number of peph, pclk or tec data */
+    pcvs_t pcvs;        /* antenna parameters */
+    struct prodent_tag *next; /* next entry (most recently used first) */
+} prodent_t;
+
+typedef struct {        /* processing pass state */
+    int iobsu;          /* current rover observation data index */
+    int iobsr;          /* current reference observation data index */
+    int isbs;           /* current sbas message index */
+    int reverse;        /* analysis direction (0:forward,1:backward) */
+    sol_t *sol;         /* solutions (combined mode) */
+    double *rb;         /* base positions (combined mode) */
+    int isol;           /* current solutions index */
+    rtk_t *rtk;         /* rtk control/result struct */
+    const prcopt_t *popt; /* processing options */
+    const solopt_t *sopt; /* solution options */
+    postctx_t *ctx;     /* post-processing context */
+} pass_t;
+
+/* global variables ----------------------------------------------------------*/
+static prodent_t *prodents=NULL; /* precise product cache entries */
+static int prodmax=0;           /* max unreferenced entries kept (0:no cache) */
+static int prodinit=0;          /* precise product cache lock initialized */
+static rtklib_lock_t prodlock;  /* lock for precise product cache */
 
 /* show message and check break ----------------------------------------------*/
-static int checkbrk(const char *format, ...)
+static int checkbrk(postctx_t *ctx, const char *format, ...)
 {
     va_list arg;
     char buff[1024],*p=buff;
@@ -92,9 +105,11 @@ static int checkbrk(const char *format, ...)
     va_start(arg,format);
     p+=vsprintf(p,format,arg);
     va_end(arg);
-    if (*proc_rov&&*proc_base) sprintf(p," (%s-%s)",proc_rov,proc_base);
-    else if (*proc_rov ) sprintf(p," (%s)",proc_rov );
-    else if (*proc_base) sprintf(p," (%s)",proc_base);
+    if (*ctx->proc_rov&&*ctx->proc_base) {
+        sprintf(p," (%s-%s)",ctx->proc_rov,ctx->proc_base);
+    }
+    else if (*ctx->proc_rov ) sprintf(p," (%s)",ctx->proc_rov );
+    else if (*ctx->proc_base) sprintf(p," (%s)",ctx->proc_base);
     return showmsg(buff);
 }
 /* output reference position -------------------------------------------------*/
@@ -124,8 +139,8 @@ static void outrpos(FILE *fp, const double *r, const solopt_t *opt)
     }
 }
 /* output header -------------------------------------------------------------*/
-static void outheader(FILE *fp, char **file, int n, const prcopt_t *popt,
-                      const solopt_t *sopt)
+static void outheader(FILE *fp, char **file, int n, const obs_t *obs,
+                      const prcopt_t *popt, const solopt_t *sopt)
 {
     const char *s1[]={"GPST","UTC","JST"};
     gtime_t ts,te;
@@ -148,11 +163,11 @@ static void outheader(FILE *fp, char **file, int n, const prcopt_t *popt,
         for (i=0;i<n;i++) {
             fprintf(fp,"%s inp file  : %s\n",COMMENTH,file[i]);
         }
-        for (i=0;i<obss.n;i++)    if (obss.data[i].rcv==1) break;
-        for (j=obss.n-1;j>=0;j--) if (obss.data[j].rcv==1) break;
+        for (i=0;i<obs->n;i++)    if (obs->data[i].rcv==1) break;
+        for (j=obs->n-1;j>=0;j--) if (obs->data[j].rcv==1) break;
         if (j<i) {fprintf(fp,"\n%s no rover obs data\n",COMMENTH); return;}
-        ts=obss.data[i].time;
-        te=obss.data[j].time;
+        ts=obs->data[i].time;
+        te=obs->data[j].time;
         t1=time2gpst(ts,&w1);
         t2=time2gpst(te,&w2);
         if (sopt->times>=1) ts=gpst2utc(ts);
@@ -202,125 +217,137 @@ static int nextobsb(const obs_t *obs, int *i, int rcv)
     return n;
 }
 /* update rtcm ssr correction ------------------------------------------------*/
-static void update_rtcm_ssr(gtime_t time)
+static void update_rtcm_ssr(postctx_t *ctx, gtime_t time)
 {
     char path[1024];
     int i;
 
     /* open or swap rtcm file */
-    reppath(rtcm_file,path,time,"","");
+    reppath(ctx->rtcm_file,path,time,"","");
 
-    if (strcmp(path,rtcm_path)) {
-        strcpy(rtcm_path,path);
+    if (strcmp(path,ctx->rtcm_path)) {
+        strcpy(ctx->rtcm_path,path);
 
-        if (fp_rtcm) fclose(fp_rtcm);
-        fp_rtcm=fopen(path,"rb");
-        if (fp_rtcm) {
-            rtcm.time=time;
-            input_rtcm3f(&rtcm,fp_rtcm);
-            trace(2,"rtcm file open: %s\n",path);
+        if (ctx->fp_rtcm) fclose(ctx->fp_rtcm);
+        ctx->fp_rtcm=fopen(path,"rb");
+        if (ctx->fp_rtcm) {
+            ctx->rtcm.time=time;
+            input_rtcm3f(&ctx->rtcm,ctx->fp_rtcm);
+            trace(2,"ctx->rtcm file open: %s\n",path);
         }
     }
-    if (!fp_rtcm) return;
+    if (!ctx->fp_rtcm) return;
 
     /* read rtcm file until current time */
-    while (timediff(rtcm.time,time)<1E-3) {
-        if (input_rtcm3f(&rtcm,fp_rtcm)<-1) break;
+    while (timediff(ctx->rtcm.time,time)<1E-3) {
+        if (input_rtcm3f(&ctx->rtcm,ctx->fp_rtcm)<-1) break;
 
         /* update ssr corrections */
         for (i=0;i<MAXSAT;i++) {
-            if (!rtcm.ssr[i].update||
-                rtcm.ssr[i].iod[0]!=rtcm.ssr[i].iod[1]||
-                timediff(time,rtcm.ssr[i].t0[0])<-1E-3) continue;
-            navs.ssr[i]=rtcm.ssr[i];
-            rtcm.ssr[i].update=0;
+            if (!ctx->rtcm.ssr[i].update||
+                ctx->rtcm.ssr[i].iod[0]!=ctx->rtcm.ssr[i].iod[1]||
+                timediff(time,ctx->rtcm.ssr[i].t0[0])<-1E-3) continue;
+            ctx->navs.ssr[i]=ctx->rtcm.ssr[i];
+            ctx->rtcm.ssr[i].update=0;
         }
     }
 }
 /* input obs data, navigation messages and sbas correction -------------------*/
-static int inputobs(obsd_t *obs, int solq, const prcopt_t *popt)
+static int inputobs(obsd_t *obs, int solq, const prcopt_t *popt, pass_t *ps)
 {
+    postctx_t *ctx=ps->ctx;
+    const obs_t *obss=&ctx->obss;
+    const sbs_t *sbss=&ctx->sbss;
     gtime_t time={0};
-    int i,nu,nr,n=0;
+    int i,nu,nr,n=0,stat;
     double dt,dt_next;
+    char tstr[40];
 
-    trace(3,"\ninfunc  : dir=%d iobsu=%d iobsr=%d isbs=%d\n",reverse,iobsu,iobsr,isbs);
+    trace(3,"\ninfunc  : dir=%d iobsu=%d iobsr=%d isbs=%d\n",ps->reverse,
+          ps->iobsu,ps->iobsr,ps->isbs);
 
-    if (0<=iobsu&&iobsu<obss.n) {
-        settime((time=obss.data[iobsu].time));
-        if (checkbrk("processing : %s Q=%d",time_str(time,0),solq)) {
-            aborts=1; showmsg("aborted"); return -1;
+    /* forward and backward passes may run concurrently */
+    rtklib_lock(&ctx->lock);
+    if (!ctx->aborts&&0<=ps->iobsu&&ps->iobsu<obss->n) {
+        settime((time=obss->data[ps->iobsu].time));
+        time2str(time,tstr,0);
+        if (checkbrk(ctx,"processing : %s Q=%d",tstr,solq)) {
+            ctx->aborts=1; showmsg("aborted");
         }
     }
-    if (!reverse) { /* input forward data */
-        if ((nu=nextobsf(&obss,&iobsu,1))<=0) return -1;
+    stat=ctx->aborts;
+    rtklib_unlock(&ctx->lock);
+    if (stat) return -1;
+
+    if (!ps->reverse) { /* input forward data */
+        if ((nu=nextobsf(obss,&ps->iobsu,1))<=0) return -1;
         if (popt->intpref) {
             /* interpolate nearest timestamps */
-            for (;(nr=nextobsf(&obss,&iobsr,2))>0;iobsr+=nr)
-                if (timediff(obss.data[iobsr].time,obss.data[iobsu].time)>-DTTOL) break;
+            for (;(nr=nextobsf(obss,&ps->iobsr,2))>0;ps->iobsr+=nr)
+                if (timediff(obss->data[ps->iobsr].time,obss->data[ps->iobsu].time)>-DTTOL) break;
         }
         else {
             /* find closest timestamp */
-            dt=timediff(obss.data[iobsr].time,obss.data[iobsu].time);
-            for (i=iobsr;(nr=nextobsf(&obss,&i,2))>0;iobsr=i,i+=nr) {
-                dt_next=timediff(obss.data[i].time,obss.data[iobsu].time);
+            dt=timediff(obss->data[ps->iobsr].time,obss->data[ps->iobsu].time);
+            for (i=ps->iobsr;(nr=nextobsf(obss,&i,2))>0;ps->iobsr=i,i+=nr) {
+                dt_next=timediff(obss->data[i].time,obss->data[ps->iobsu].time);
                 if (fabs(dt_next)>fabs(dt)) break;
                 dt=dt_next;
             }
         }
-        nr=nextobsf(&obss,&iobsr,2);
+        nr=nextobsf(obss,&ps->iobsr,2);
         if (nr<=0) {
-            nr=nextobsf(&obss,&iobsr,2);
+            nr=nextobsf(obss,&ps->iobsr,2);
         }
-        for (i=0;i<nu&&n<MAXOBS*2;i++) obs[n++]=obss.data[iobsu+i];
-        for (i=0;i<nr&&n<MAXOBS*2;i++) obs[n++]=obss.data[iobsr+i];
-        iobsu+=nu;
+        for (i=0;i<nu&&n<MAXOBS*2;i++) obs[n++]=obss->data[ps->iobsu+i];
+        for (i=0;i<nr&&n<MAXOBS*2;i++) obs[n++]=obss->data[ps->iobsr+i];
+        ps->iobsu+=nu;
 
         /* update sbas corrections */
-        while (isbs<sbss.n) {
-            time=gpst2time(sbss.msgs[isbs].week,sbss.msgs[isbs].tow);
+        while (ps->isbs<sbss->n) {
+            time=gpst2time(sbss->msgs[ps->isbs].week,sbss->msgs[ps->isbs].tow);
 
-            if (getbitu(sbss.msgs[isbs].msg,8,6)!=9) { /* except for geo nav */
-                sbsupdatecorr(sbss.msgs+isbs,&navs);
+            if (getbitu(sbss->msgs[ps->isbs].msg,8,6)!=9) { /* except for geo nav */
+                sbsupdatecorr(sbss->msgs+ps->isbs,&ctx->navs);
             }
             if (timediff(time,obs[0].time)>-1.0-DTTOL) break;
-            isbs++;
+            ps->isbs++;
         }
         /* update rtcm ssr corrections */
-        if (*rtcm_file) {
-            update_rtcm_ssr(obs[0].time);
+        if (*ctx->rtcm_file) {
+            update_rtcm_ssr(ctx,obs[0].time);
         }
     }
     else { /* input backward data */
-        if ((nu=nextobsb(&obss,&iobsu,1))<=0) return -1;
+        if ((nu=nextobsb(obss,&ps->iobsu,1))<=0) return -1;
         if (popt->intpref) {
             /* interpolate nearest timestamps */
-            for (;(nr=nextobsb(&obss,&iobsr,2))>0;iobsr-=nr)
-                if (timediff(obss.data[iobsr].time,obss.data[iobsu].time)<DTTOL) break;
+            for (;(nr=nextobsb(obss,&ps->iobsr,2))>0;ps->iobsr-=nr)
+                if (timediff(obss->data[ps->iobsr].time,obss->data[ps->iobsu].time)<DTTOL) break;
         }
         else {
             /* find closest timestamp */
-            dt=iobsr>=0?timediff(obss.data[iobsr].time,obss.data[iobsu].time):0;
-            for (i=iobsr;(nr=nextobsb(&obss,&i,2))>0;iobsr=i,i-=nr) {
-                dt_next=timediff(obss.data[i].time,obss.data[iobsu].time);
+            dt=ps->iobsr>=0?timediff(obss->data[ps->iobsr].time,obss->data[ps->iobsu].time):0;
+            for (i=ps->iobsr;(nr=nextobsb(obss,&i,2))>0;ps->iobsr=i,i-=nr) {
+                dt_next=timediff(obss->data[i].time,obss->data[ps->iobsu].time);
                 if (fabs(dt_next)>fabs(dt)) break;
                 dt=dt_next;
             }
         }
-        nr=nextobsb(&obss,&iobsr,2);
-        for (i=0;i<nu&&n<MAXOBS*2;i++) obs[n++]=obss.data[iobsu-nu+1+i];
-        for (i=0;i<nr&&n<MAXOBS*2;i++) obs[n++]=obss.data[iobsr-nr+1+i];
-        iobsu-=nu;
+        nr=nextobsb(obss,&ps->iobsr,2);
+        for (i=0;i<nu&&n<MAXOBS*2;i++) obs[n++]=obss->data[ps->iobsu-nu+1+i];
+        for (i=0;i<nr&&n<MAXOBS*2;i++) obs[n++]=obss->data[ps->iobsr-nr+1+i];
+        ps->iobsu-=nu;
 
         /* update sbas corrections */
-        while (isbs>=0) {
-            time=gpst2time(sbss.msgs[isbs].week,sbss.msgs[isbs].tow);
+        while (ps->isbs>=0) {
+            time=gpst2time(sbss->msgs[ps->isbs].week,sbss->msgs[ps->isbs].tow);
 
-            if (getbitu(sbss.msgs[isbs].msg,8,6)!=9) { /* except for geo nav */
-                sbsupdatecorr(sbss.msgs+isbs,&navs);
+            if (getbitu(sbss->msgs[ps->isbs].msg,8,6)!=9) { /* except for geo nav */
+                sbsupdatecorr(sbss->msgs+ps->isbs,&ctx->navs);
             }
             if (timediff(time,obs[0].time)<1.0+DTTOL) break;
-            isbs--;
+            ps->isbs--;
         }
     }
     return n;
@@ -398,8 +425,9 @@ static void corr_phase_bias_ssr(obsd_t *obs, int n, const nav_t *nav)
 }
 /* process positioning -------------------------------------------------------*/
 static void procpos(FILE *fp, FILE *fptm, const prcopt_t *popt, const solopt_t *sopt,
-                    rtk_t *rtk, int mode)
+                    rtk_t *rtk, int mode, pass_t *ps)
 {
+    postctx_t *ctx=ps->ctx;
     gtime_t time={0};
     sol_t sol={{0}},oldsol={{0}},newsol={{0}};
     obsd_t *obs_ptr = (obsd_t *)malloc(sizeof(obsd_t)*MAXOBS*2); /* for rover and base */
@@ -411,9 +439,9 @@ static void procpos(FILE *fp, FILE *fptm, const prcopt_t *popt, const solopt_t *
     solstatic=sopt->solstatic&&
               (popt->mode==PMODE_STATIC||popt->mode==PMODE_STATIC_START||popt->mode==PMODE_PPP_STATIC);
     
-    rtcm_path[0]='\0';
+    if (!ps->reverse) ctx->rtcm_path[0]='\0'; /* rtcm ssr for forward only */
 
-    while ((nobs=inputobs(obs_ptr,rtk->sol.stat,popt))>=0) {
+    while ((nobs=inputobs(obs_ptr,rtk->sol.stat,popt,ps))>=0) {
 
         /* exclude satellites */
         for (i=n=0;i<nobs;i++) {
@@ -422,16 +450,19 @@ static void procpos(FILE *fp, FILE *fptm, const prcopt_t *popt, const solopt_t *
         }
         if (n<=0) continue;
 
+        /* precise ephemeris/clock in time window */
+        if (ctx->pstrm.n>0) updpstrm(&ctx->pstrm,obs_ptr[0].time,&ctx->navs);
+
         /* carrier-phase bias correction */
         if (!strstr(popt->pppopt,"-ENA_FCB")) {
-            corr_phase_bias_ssr(obs_ptr,n,&navs);
+            corr_phase_bias_ssr(obs_ptr,n,&ctx->navs);
         }
-        if (!rtkpos(rtk, obs_ptr,n,&navs)) {
+        if (!rtkpos(rtk, obs_ptr,n,&ctx->navs)) {
             if (rtk->sol.eventime.time != 0) {
                 if (mode == SOLMODE_SINGLE_DIR) {
                     outinvalidtm(fptm, sopt, rtk->sol.eventime);
-                } else if (!reverse&&nitm<MAXINVALIDTM) {
-                    invalidtm[nitm++] = rtk->sol.eventime;
+                } else if (!ps->reverse&&ctx->nitm<MAXINVALIDTM) {
+                    ctx->invalidtm[ctx->nitm++] = rtk->sol.eventime;
                 }
             }
             continue;
@@ -459,23 +490,14 @@ static void procpos(FILE *fp, FILE *fptm, const prcopt_t *popt, const solopt_t *
             }
             oldsol = rtk->sol;
         }
-        else if (!reverse) { /* combined-forward */
-            if (isolf >= nepoch) {
-                free(obs_ptr);
-                return;
-            }
-            solf[isolf]=rtk->sol;
-            for (i=0;i<3;i++) rbf[i+isolf*3]=rtk->rb[i];
-            isolf++;
-        }
-        else { /* combined-backward */
-            if (isolb>=nepoch) {
+        else { /* combined-forward or combined-backward */
+            if (ps->isol>=ctx->nepoch) {
                 free(obs_ptr);
                 return;
             }
-            solb[isolb]=rtk->sol;
-            for (i=0;i<3;i++) rbb[i+isolb*3]=rtk->rb[i];
-            isolb++;
+            ps->sol[ps->isol]=rtk->sol;
+            for (i=0;i<3;i++) ps->rb[i+ps->isol*3]=rtk->rb[i];
+            ps->isol++;
         }
     }
     if (mode==SOLMODE_SINGLE_DIR && solstatic&&time.time!=0.0) {
@@ -485,6 +507,65 @@ static void procpos(FILE *fp, FILE *fptm, const prcopt_t *popt, const solopt_t *
 
     free(obs_ptr); /* moved from stack to heap to kill a stack overflow warning */
 }
+/* initialize processing pass -----------------------------------------------*/
+static void initpass(postctx_t *ctx, pass_t *ps, int reverse, sol_t *sol,
+                     double *rb, rtk_t *rtk, const prcopt_t *popt,
+                     const solopt_t *sopt)
+{
+    ps->reverse=reverse;
+    ps->iobsu=ps->iobsr=reverse?ctx->obss.n-1:0;
+    ps->isbs=reverse?ctx->sbss.n-1:0;
+    ps->sol=sol;
+    ps->rb=rb;
+    ps->isol=0;
+    ps->rtk=rtk;
+    ps->popt=popt;
+    ps->sopt=sopt;
+    ps->ctx=ctx;
+}
+/* processing pass thread for combined mode ----------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI procthread(void *arg)
+#else
+static void *procthread(void *arg)
+#endif
+{
+    pass_t *ps=(pass_t *)arg;
+
+    procpos(NULL,NULL,ps->popt,ps->sopt,ps->rtk,SOLMODE_COMBINED,ps);
+    return 0;
+}
+/* check if passes of combined mode can run concurrently -----------------------
+* the passes share only read-only obs and nav data. it is not applied if the
+* backward pass continues the forward filter (no phase reset), or if the passes
+* update shared sbas/ssr corrections in navs or status or trace output outside
+* of rtk_t.
+*-----------------------------------------------------------------------------*/
+static int parcomb(const postctx_t *ctx, const prcopt_t *popt,
+                   const solopt_t *sopt)
+{
+    return popt->soltype==SOLTYPE_COMBINED&&ctx->sbss.n<=0&&!*ctx->rtcm_file&&
+           sopt->sstat<=0&&sopt->trace<=0;
+}
+/* execute forward pass and backward pass in another thread ------------------*/
+static int procpar(pass_t *pf, pass_t *pb)
+{
+#ifdef WIN32
+    HANDLE thread;
+
+    if (!(thread=CreateThread(NULL,0,procthread,pb,0,NULL))) return 0;
+    procthread(pf);
+    WaitForSingleObject(thread,INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_t thread;
+
+    if (pthread_create(&thread,NULL,procthread,pb)) return 0;
+    procthread(pf);
+    pthread_join(thread,NULL);
+#endif
+    return 1;
+}
 /* validation of combined solutions ------------------------------------------*/
 static int valcomb(const sol_t *solf, const sol_t *solb, double *rbf,
         double *rbb, const prcopt_t *popt)
@@ -512,12 +593,16 @@ static int valcomb(const sol_t *solf, const sol_t *solb, double *rbf,
     return 1;
 }
 /* combine forward/backward solutions and save results ---------------------*/
-static void combres(FILE *fp, FILE *fptm, const prcopt_t *popt, const solopt_t *sopt)
+static void combres(postctx_t *ctx, FILE *fp, FILE *fptm, const prcopt_t *popt,
+                   const solopt_t *sopt)
 {
     gtime_t time={0};
     sol_t sols={{0}},sol={{0}},oldsol={{0}},newsol={{0}};
     double tt,Qf[9],Qb[9],Qs[9],rbs[3]={0},rb[3]={0},rr_f[3],rr_b[3],rr_s[3];
+    const sol_t *solf=ctx->solf,*solb=ctx->solb;
+    double *rbf=ctx->rbf,*rbb=ctx->rbb;
     int i,j,k,solstatic,num=0,pri[]={7,1,2,3,4,5,1,6};
+    int isolf=ctx->isolf,isolb=ctx->isolb;
 
     trace(3,"combres : isolf=%d isolb=%d\n",isolf,isolb);
 
@@ -611,10 +696,11 @@ static void combres(FILE *fp, FILE *fptm, const prcopt_t *popt, const solopt_t *
                 time=sols.time;
             }
         }
-        if (iitm < nitm && timediff(invalidtm[iitm],sols.time)<0.0)
+        if (ctx->iitm<ctx->nitm&&
+            timediff(ctx->invalidtm[ctx->iitm],sols.time)<0.0)
         {
-            outinvalidtm(fptm,sopt,invalidtm[iitm]);
-            iitm++;
+            outinvalidtm(fptm,sopt,ctx->invalidtm[ctx->iitm]);
+            ctx->iitm++;
         }
         if (sols.eventime.time != 0)
         {
@@ -631,11 +717,309 @@ static void combres(FILE *fp, FILE *fptm, const prcopt_t *popt, const solopt_t *
         outsol(fp,&sol,rb,sopt);
     }
 }
+/* test file of precise product type -----------------------------------------
+* test if the file may include the precise products of the type. only the
+* extension (sp3) or the rinex version/type header line (rinex clock) is
+* checked. the files not tested (e.g. compressed) are regarded as products.
+*-----------------------------------------------------------------------------*/
+static int prodfile(int type, const char *file)
+{
+    FILE *fp;
+    char buff[1024]="",*ext=strrchr(file,'.');
+
+    if (type==PROD_PEPH) { /* same as readsp3() */
+        return ext&&(strstr(ext,".sp3")||strstr(ext,".SP3")||
+                     strstr(ext,".eph")||strstr(ext,".EPH"));
+    }
+    if (type!=PROD_PCLK||!(fp=fopen(file,"r"))) return 1;
+
+    if (!fgets(buff,sizeof(buff),fp)) *buff='\0';
+    fclose(fp);
+    if (strlen(buff)<80||!strstr(buff+60,"RINEX VERSION / TYPE")) return 1;
+    return buff[20]=='C';
+}
+/* generate precise product cache key ----------------------------------------
+* key is generated from paths, sizes and modified times of the files of the
+* product type matched by the path (wild-card * expanded). return NULL if no
+* file matched.
+*-----------------------------------------------------------------------------*/
+static char *prodkey(int type, const char *file)
+{
+    struct stat st;
+    char *efiles[MAXEXFILE],*key=NULL,*p;
+    int i,n,len=0;
+
+    for (i=0;i<MAXEXFILE;i++) {
+        if (!(efiles[i]=(char *)malloc(1024))) {
+            for (i--;i>=0;i--) free(efiles[i]);
+            return NULL;
+        }
+    }
+    n=expath(file,efiles,MAXEXFILE);
+
+    for (i=0;i<n;i++) len+=(int)strlen(efiles[i])+48;
+
+    if (len>0&&(key=p=(char *)malloc(len+1))) {
+        *p='\0';
+        for (i=0;i<n;i++) {
+            if (stat(efiles[i],&st)||!prodfile(type,efiles[i])) continue;
+            p+=sprintf(p,"%s %.0f %.0f;",efiles[i],(double)st.st_size,
+                       (double)st.st_mtime);
+        }
+        if (!*key) {
+            free(key); key=NULL;
+        }
+    }
+    for (i=0;i<MAXEXFILE;i++) free(efiles[i]);
+    return key;
+}
+/* free precise product cache entry ------------------------------------------*/
+static void prodfree(prodent_t *ent)
+{
+    int i;
+
+    for (i=0;i<MAXSAT;i++) {
+        free(ent->pephs.pos[i]);
+        free(ent->pephs.std[i]);
+    }
+    free(ent->pephs.time);
+    free(ent->pephs.index);
+    free(ent->pclk);
+    free(ent->pephc.tc);
+    free(ent->pephc.tw);
+    free(ent->pephc.off);
+    free(ent->pephc.coef);
+    for (i=0;ent->tec&&i<ent->n;i++) {
+        free(ent->tec[i].data);
+        free(ent->tec[i].rms );
+    }
+    free(ent->tec);
+    free(ent->pcvs.pcv);
+    free(ent->key);
+    rtklib_destroylock(&ent->lock);
+    free(ent);
+}
+/* read precise product files to cache entry ---------------------------------
+* the files are read in the order and by the same functions as without cache
+*-----------------------------------------------------------------------------*/
+static int prodread(prodent_t *ent, char **files, int n)
+{
+    nav_t *nav;
+    int i;
+
+    if (ent->type==PROD_PCVS||ent->type==PROD_PCVR) {
+        for (i=0;i<n;i++) {
+            if (!readpcv(files[i],&ent->pcvs)) return 0;
+        }
+        return 1;
+    }
+    if (!(nav=(nav_t *)calloc(1,sizeof(nav_t)))) return 0;
+
+    for (i=0;i<n;i++) {
+        switch (ent->type) {
+            case PROD_PEPH: readsp3 (files[i],nav,16); break;
+            case PROD_PCLK: readrnxc(files[i],nav  ); break;
+            case PROD_TEC : readtec (files[i],nav,1); break;
+        }
+    }
+    ent->pephs=nav->pephs; ent->pclk=nav->pclk; ent->tec=nav->tec;
+    ent->n=ent->type==PROD_PEPH?nav->pephs.ne:
+           (ent->type==PROD_PCLK?nav->nc:nav->nt);
+
+    /* free data not of the product type (e.g. broadcast ephemeris) */
+    if (ent->type!=PROD_PEPH) freepephs(nav);
+    free(nav->peph);
+    if (ent->type!=PROD_PCLK) free(nav->pclk);
+    free(nav->eph); free(nav->geph); free(nav->seph);
+    free(nav);
+    return ent->n>0;
+}
+/* free least recently used entries not referenced over limit ---------------*/
+static void prodevict(int nmax)
+{
+    prodent_t *p,*prev=NULL;
+    int n=0;
+
+    for (p=prodents;p;) {
+        if (p->nref<=0&&(p->stat<0||++n>nmax)) {
+            if (prev) prev->next=p->next; else prodents=p->next;
+            prodfree(p);
+            p=prev?prev->next:prodents;
+            continue;
+        }
+        prev=p; p=p->next;
+    }
+}
+/* release precise products to cache -----------------------------------------*/
+static void prodrelease(prodent_t *ent)
+{
+    if (!ent) return;
+
+    rtklib_lock(&prodlock);
+    ent->nref--;
+    prodevict(prodmax);
+    rtklib_unlock(&prodlock);
+}
+/* search or read precise product cache entry ----------------------------------
+* the entry is searched and published under the cache lock but the files are
+* read out of it with the entry lock held, so the sessions reading other
+* products are not blocked. the sessions requesting the entry being loaded
+* wait for the entry lock.
+*-----------------------------------------------------------------------------*/
+static prodent_t *prodget(int type, char *key, char **files, int n)
+{
+    prodent_t *ent,*prev=NULL;
+    int stat;
+
+    rtklib_lock(&prodlock);
+
+    if (!prodmax) {
+        rtklib_unlock(&prodlock);
+        free(key);
+        return NULL;
+    }
+    for (ent=prodents;ent;prev=ent,ent=ent->next) {
+        if (ent->type!=type||strcmp(ent->key,key)) continue;
+        if (prev) { /* move to most recently used */
+            prev->next=ent->next; ent->next=prodents; prodents=ent;
+        }
+        ent->nref++;
+        rtklib_unlock(&prodlock);
+        free(key);
+
+        /* wait for loading by other session */
+        rtklib_lock(&ent->lock);
+        stat=ent->stat;
+        rtklib_unlock(&ent->lock);
+
+        if (stat>0) return ent;
+        prodrelease(ent);
+        return NULL;
+    }
+    if (!(ent=(prodent_t *)calloc(1,sizeof(prodent_t)))) {
+        rtklib_unlock(&prodlock);
+        free(key);
+        return NULL;
+    }
+    ent->type=type; ent->key=key; ent->nref=1;
+    rtklib_initlock(&ent->lock);
+    rtklib_lock(&ent->lock);
+    ent->next=prodents; prodents=ent;
+
+    rtklib_unlock(&prodlock);
+
+    trace(3,"prodget : type=%d key=%s\n",type,key);
+
+    ent->stat=stat=prodread(ent,files,n)?1:-1;
+    rtklib_unlock(&ent->lock);
+
+    if (stat>0) return ent;
+    prodrelease(ent);
+    return NULL;
+}
+/* acquire precise products from cache ---------------------------------------
+* args   : int    type      I   product type (PROD_???)
+*          char   **files   I   product file paths (%r and %b paths skipped)
+*          int    n         I   number of files
+*          prodent_t **ent  O   cache entry (NULL: no product)
+* return : status (1:ok,0:cache disabled)
+* notes  : the products of all the files are cached in a single entry. files
+*          without the product type (e.g. observation data) are not included
+*          to the key, so sessions sharing the product files share the entry
+*          regardless of the other input files.
+*-----------------------------------------------------------------------------*/
+static int prodacquire(int type, char **files, int n, prodent_t **ent)
+{
+    char *key,*keys=NULL,*q,**pfiles;
+    int i,np=0,len=0;
+
+    *ent=NULL;
+
+    if (!prodinit) return 0;
+
+    rtklib_lock(&prodlock);
+    i=prodmax;
+    rtklib_unlock(&prodlock);
+
+    if (!i||!(pfiles=(char **)malloc(sizeof(char *)*(n>0?n:1)))) return 0;
+
+    for (i=0;i<n;i++) {
+        if (strstr(files[i],"%r")||strstr(files[i],"%b")) continue;
+        if (!(key=prodkey(type,files[i]))) continue;
+        len+=(int)strlen(key)+1;
+        if (!(q=(char *)realloc(keys,len+1))) {
+            free(key);
+            break;
+        }
+        if (!keys) *q='\0';
+        keys=q; strcat(keys,key); strcat(keys,"\n");
+        free(key);
+        pfiles[np++]=files[i];
+    }
+    if (np>0) *ent=prodget(type,keys,pfiles,np);
+    else free(keys);
+
+    free(pfiles);
+    return 1;
+}
+/* fit coefficients of cached precise ephemeris ------------------------------*/
+static void prodpephc(prodent_t *ent, nav_t *nav)
+{
+    rtklib_lock(&ent->lock);
+    if (!ent->pephc.peph&&pephcoef(nav)) ent->pephc=nav->pephc;
+    nav->pephc=ent->pephc;
+    rtklib_unlock(&ent->lock);
+}
+/* set precise product cache ---------------------------------------------------
+* enable or disable process-wide cache of precise products shared by sessions
+* args   : int    nmax      I   max number of cached products not referenced
+*                               by any session (0: disable cache)
+* return : none
+* notes  : precise ephemeris (sp3), precise clock (rinex clock), tec grid
+*          (ionex) and satellite/receiver antenna parameters (antex) are cached.
+*          the cached products are keyed by the file paths, sizes and modified
+*          times, read only once and shared by the sessions as read-only data.
+*          call the function before executing postpos() or postposc().
+*-----------------------------------------------------------------------------*/
+extern void setprodcache(int nmax)
+{
+    trace(3,"setprodcache: nmax=%d\n",nmax);
+
+    if (!prodinit) {
+        rtklib_initlock(&prodlock);
+        prodinit=1;
+    }
+    rtklib_lock(&prodlock);
+    prodmax=nmax>0?nmax:0;
+    rtklib_unlock(&prodlock);
+
+    if (nmax<=0) freeprodcache();
+}
+/* free precise product cache --------------------------------------------------
+* free precise products cached and not referenced by any session
+* args   : none
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void freeprodcache(void)
+{
+    trace(3,"freeprodcache:\n");
+
+    if (!prodinit) return;
+
+    rtklib_lock(&prodlock);
+    prodevict(0);
+    rtklib_unlock(&prodlock);
+}
 /* read prec ephemeris, sbas data, tec grid and open rtcm --------------------*/
-static void readpreceph(char **infile, int n, const prcopt_t *prcopt,
-                        nav_t *nav, sbs_t *sbs)
+static void readpreceph(postctx_t *ctx, char **infile, int n,
+                        const prcopt_t *prcopt)
 {
+    nav_t *nav=&ctx->navs;
+    sbs_t *sbs=&ctx->sbss;
     seph_t seph0={0};
+    pephs_t pephs0={0};
+    pephc_t pephc0={0};
+    prodent_t *pe,*pc;
     int i;
     char *ext;
 
@@ -643,17 +1027,47 @@ static void readpreceph(char **infile, int n, const prcopt_t *prcopt,
 
     nav->ne=nav->nemax=0;
     nav->nc=nav->ncmax=0;
+    nav->pephs=pephs0;
+    nav->pephc=pephc0;
     sbs->n =sbs->nmax =0;
 
-    /* read precise ephemeris files */
-    for (i=0;i<n;i++) {
-        if (strstr(infile[i],"%r")||strstr(infile[i],"%b")) continue;
-        readsp3(infile[i],nav,0);
+    if (ctx->prod) { /* shared precise ephemeris and clock */
+        nav->peph=ctx->prod->peph; nav->ne=nav->nemax=ctx->prod->ne;
+        nav->pclk=ctx->prod->pclk; nav->nc=nav->ncmax=ctx->prod->nc;
+        nav->pephs=ctx->prod->pephs;
+        nav->pephc=ctx->prod->pephc;
     }
-    /* read precise clock files */
-    for (i=0;i<n;i++) {
-        if (strstr(infile[i],"%r")||strstr(infile[i],"%b")) continue;
-        readrnxc(infile[i],nav);
+    else if (prcopt->pephstrm&&prcopt->soltype==0) { /* precise eph/clock stream */
+        for (i=0;i<n;i++) {
+            if (strstr(infile[i],"%r")||strstr(infile[i],"%b")) continue;
+            openpstrm(&ctx->pstrm,infile[i],0);
+        }
+    }
+    else if (prodacquire(PROD_PEPH,infile,n,&pe)) { /* cached products */
+        prodacquire(PROD_PCLK,infile,n,&pc);
+        ctx->prodc[PROD_PEPH]=pe;
+        ctx->prodc[PROD_PCLK]=pc;
+        if (pe) {
+            nav->pephs=pe->pephs;
+            if (prcopt->pephcheb) prodpephc(pe,nav);
+        }
+        if (pc) {
+            nav->pclk=pc->pclk; nav->nc=nav->ncmax=pc->n;
+        }
+    }
+    else {
+        /* read precise ephemeris files */
+        for (i=0;i<n;i++) {
+            if (strstr(infile[i],"%r")||strstr(infile[i],"%b")) continue;
+            readsp3(infile[i],nav,16);
+        }
+        /* chebyshev coefficients of precise ephemeris */
+        if (prcopt->pephcheb) pephcoef(nav);
+        /* read precise clock files */
+        for (i=0;i<n;i++) {
+            if (strstr(infile[i],"%r")||strstr(infile[i],"%b")) continue;
+            readrnxc(infile[i],nav);
+        }
     }
     /* read sbas message files */
     for (i=0;i<n;i++) {
@@ -670,41 +1084,68 @@ static void readpreceph(char **infile, int n, const prcopt_t *prcopt,
     for (i=0;i<nav->ns;i++) nav->seph[i]=seph0;
 
     /* set rtcm file and initialize rtcm struct */
-    rtcm_file[0]=rtcm_path[0]='\0'; fp_rtcm=NULL;
+    ctx->rtcm_file[0]=ctx->rtcm_path[0]='\0'; ctx->fp_rtcm=NULL;
 
     for (i=0;i<n;i++) {
         if ((ext=strrchr(infile[i],'.'))&&
             (!strcmp(ext,".rtcm3")||!strcmp(ext,".RTCM3"))) {
-            strcpy(rtcm_file,infile[i]);
-            init_rtcm(&rtcm);
+            strcpy(ctx->rtcm_file,infile[i]);
+            init_rtcm(&ctx->rtcm);
             break;
         }
     }
 }
 /* free prec ephemeris and sbas data -----------------------------------------*/
-static void freepreceph(nav_t *nav, sbs_t *sbs)
+static void freepreceph(postctx_t *ctx)
 {
+    nav_t *nav=&ctx->navs;
+    sbs_t *sbs=&ctx->sbss;
+    pephs_t pephs0={0};
+    pephc_t pephc0={0};
     int i;
 
     trace(3,"freepreceph:\n");
 
-    free(nav->peph); nav->peph=NULL; nav->ne=nav->nemax=0;
-    free(nav->pclk); nav->pclk=NULL; nav->nc=nav->ncmax=0;
+    if (ctx->prod) ;
+    else if (ctx->prodc[PROD_PEPH]||ctx->prodc[PROD_PCLK]) {
+        prodrelease((prodent_t *)ctx->prodc[PROD_PEPH]);
+        prodrelease((prodent_t *)ctx->prodc[PROD_PCLK]);
+        ctx->prodc[PROD_PEPH]=ctx->prodc[PROD_PCLK]=NULL;
+    }
+    else {
+        closepstrm(&ctx->pstrm);
+        free(nav->peph);
+        free(nav->pclk);
+        freepephs(nav);
+        freepephc(nav);
+    }
+    nav->pephs=pephs0;
+    nav->pephc=pephc0;
+    nav->peph=NULL; nav->ne=nav->nemax=0;
+    nav->pclk=NULL; nav->nc=nav->ncmax=0;
     free(nav->seph); nav->seph=NULL; nav->ns=nav->nsmax=0;
     free(sbs->msgs); sbs->msgs=NULL; sbs->n =sbs->nmax =0;
-    for (i=0;i<nav->nt;i++) {
-        free(nav->tec[i].data);
-        free(nav->tec[i].rms );
+    if (ctx->prodc[PROD_TEC]) {
+        prodrelease((prodent_t *)ctx->prodc[PROD_TEC]);
+        ctx->prodc[PROD_TEC]=NULL;
     }
-    free(nav->tec ); nav->tec =NULL; nav->nt=nav->ntmax=0;
+    else {
+        for (i=0;i<nav->nt;i++) {
+            free(nav->tec[i].data);
+            free(nav->tec[i].rms );
+        }
+        free(nav->tec);
+    }
+    nav->tec=NULL; nav->nt=nav->ntmax=0;
 
-    if (fp_rtcm) fclose(fp_rtcm);
-    free_rtcm(&rtcm);
+    if (ctx->fp_rtcm) fclose(ctx->fp_rtcm);
+    free_rtcm(&ctx->rtcm);
 }
 /* read obs and nav data -----------------------------------------------------*/
-static int readobsnav(gtime_t ts, gtime_t te, double ti, char **infile,
-                      const int *index, int n, const prcopt_t *prcopt,
-                      obs_t *obs, nav_t *nav, sta_t *sta)
+static int readobsnav(postctx_t *ctx, gtime_t ts, gtime_t te, double ti,
+                      char **infile, const int *index, int n,
+                      const prcopt_t *prcopt, obs_t *obs, nav_t *nav,
+                      sta_t *sta)
 {
     int i,j,ind=0,nobs=0,rcv=1;
 
@@ -715,10 +1156,10 @@ static int readobsnav(gtime_t ts, gtime_t te, double ti, char **infile,
     nav->geph=NULL; nav->ng=nav->ngmax=0;
     /* free(nav->seph); */ /* is this needed to avoid memory leak??? */
     nav->seph=NULL; nav->ns=nav->nsmax=0;
-    nepoch=0;
+    ctx->nepoch=0;
 
     for (i=0;i<n;i++) {
-        if (checkbrk("")) return 0;
+        if (checkbrk(ctx,"")) return 0;
 
         if (index[i]!=ind) {
             if (obs->n>nobs) rcv++;
@@ -727,27 +1168,30 @@ static int readobsnav(gtime_t ts, gtime_t te, double ti, char **infile,
         /* read rinex obs and nav file */
         if (readrnxt(infile[i],rcv,ts,te,ti,prcopt->rnxopt[rcv<=1?0:1],obs,nav,
                      rcv<=2?sta+rcv-1:NULL)<0) {
-            checkbrk("error : insufficient memory");
+            checkbrk(ctx,"error : insufficient memory");
             trace(1,"insufficient memory\n");
             return 0;
         }
     }
     if (obs->n<=0) {
-        checkbrk("error : no obs data");
+        checkbrk(ctx,"error : no obs data");
         trace(1,"\n");
         return 0;
     }
     if (nav->n<=0&&nav->ng<=0&&nav->ns<=0) {
-        checkbrk("error : no nav data");
+        checkbrk(ctx,"error : no nav data");
         trace(1,"\n");
         return 0;
     }
     /* sort observation data */
-    nepoch=sortobs(obs);
+    ctx->nepoch=sortobs(obs);
 
     /* delete duplicated ephemeris */
     uniqnav(nav);
 
+    /* derived constants of broadcast ephemeris */
+    for (i=0;i<nav->n;i++) ephconst(nav->eph+i);
+
     /* set time span for progress display */
     if (ts.time==0||te.time==0) {
         for (i=0;   i<obs->n;i++) if (obs->data[i].rcv==1) break;
@@ -769,10 +1213,11 @@ static void freeobsnav(obs_t *obs, nav_t *nav)
     free(nav->eph ); nav->eph =NULL; nav->n =nav->nmax =0;
     free(nav->geph); nav->geph=NULL; nav->ng=nav->ngmax=0;
     free(nav->seph); nav->seph=NULL; nav->ns=nav->nsmax=0;
+    freenavidx(nav);
 }
 /* average of single position ------------------------------------------------*/
-static int avepos(double *ra, int rcv, const obs_t *obs, const nav_t *nav,
-                  const prcopt_t *opt)
+static int avepos(double *ra, int rcv, const obs_t *obs, nav_t *nav,
+                  pstrm_t *strm, const prcopt_t *opt)
 {
     obsd_t data[MAXOBS];
     gtime_t ts={0};
@@ -793,6 +1238,8 @@ static int avepos(double *ra, int rcv, const obs_t *obs, const nav_t *nav,
         }
         if (j<=0||!screent(data[0].time,ts,ts,1.0)) continue; /* only 1 hz */
 
+        if (strm->n>0) updpstrm(strm,data[0].time,nav);
+
         if (!pntpos(data,j,nav,opt,&sol,NULL,NULL,msg)) continue;
 
         for (i=0;i<3;i++) ra[i]+=sol.rr[i];
@@ -806,10 +1253,11 @@ static int avepos(double *ra, int rcv, const obs_t *obs, const nav_t *nav,
     return 1;
 }
 /* station position from file ------------------------------------------------*/
-static int getstapos(const char *file, char *name, double *r)
+static int getstapos(const char *file, const char *name, double *r)
 {
     FILE *fp;
-    char buff[256],sname[256],*p,*q;
+    char buff[256],sname[256],*p;
+    const char *q;
     double pos[3];
 
     trace(3,"getstapos: file=%s name=%s\n",file,name);
@@ -839,66 +1287,89 @@ static int getstapos(const char *file, char *name, double *r)
     return 0;
 }
 /* antenna phase center position ---------------------------------------------*/
-static int antpos(prcopt_t *opt, int rcvno, const obs_t *obs, const nav_t *nav,
-                  const sta_t *sta, const char *posfile)
+static int antpos(prcopt_t *opt, int rcvno, const obs_t *obs, nav_t *nav,
+                  pstrm_t *strm, const sta_t *sta, const char *posfile)
 {
     double *rr=rcvno==1?opt->ru:opt->rb,del[3],pos[3],dr[3]={0};
     int i,postype=rcvno==1?opt->rovpos:opt->refpos;
-    char *name;
+    const char *name;
 
     trace(3,"antpos  : rcvno=%d\n",rcvno);
 
     if (postype==POSOPT_SINGLE) { /* average of single position */
-        if (!avepos(rr,rcvno,obs,nav,opt)) {
+        if (!avepos(rr,rcvno,obs,nav,strm,opt)) {
             showmsg("error : station pos computation");
             return 0;
         }
     }
     else if (postype==POSOPT_FILE) { /* read from position file */
-        name=stas[rcvno==1?0:1].name;
+        name=sta[rcvno==1?0:1].name;
         if (!getstapos(posfile,name,rr)) {
             showmsg("error : no position of %s in %s",name,posfile);
             return 0;
         }
     }
     else if (postype==POSOPT_RINEX) { /* get from rinex header */
-        if (norm(stas[rcvno==1?0:1].pos,3)<=0.0) {
+        if (norm(sta[rcvno==1?0:1].pos,3)<=0.0) {
             showmsg("error : no position in rinex header");
             trace(1,"no position in rinex header\n");
             return 0;
         }
         /* add antenna delta unless already done in antpcv() */
         if (!strcmp(opt->anttype[rcvno],"*")) {
-            if (stas[rcvno==1?0:1].deltype==0) { /* enu */
-                for (i=0;i<3;i++) del[i]=stas[rcvno==1?0:1].del[i];
-                del[2]+=stas[rcvno==1?0:1].hgt;
-                ecef2pos(stas[rcvno==1?0:1].pos,pos);
+            if (sta[rcvno==1?0:1].deltype==0) { /* enu */
+                for (i=0;i<3;i++) del[i]=sta[rcvno==1?0:1].del[i];
+                del[2]+=sta[rcvno==1?0:1].hgt;
+                ecef2pos(sta[rcvno==1?0:1].pos,pos);
                 enu2ecef(pos,del,dr);
             }  else { /* xyz */
-                for (i=0;i<3;i++) dr[i]=stas[rcvno==1?0:1].del[i];
+                for (i=0;i<3;i++) dr[i]=sta[rcvno==1?0:1].del[i];
             }
         }
-        for (i=0;i<3;i++) rr[i]=stas[rcvno==1?0:1].pos[i]+dr[i];
+        for (i=0;i<3;i++) rr[i]=sta[rcvno==1?0:1].pos[i]+dr[i];
     }
     return 1;
 }
 /* open processing session ----------------------------------------------------*/
-static int openses(const prcopt_t *popt, const solopt_t *sopt,
-                   const filopt_t *fopt, nav_t *nav, pcvs_t *pcvs, pcvs_t *pcvr)
+static int openses(postctx_t *ctx, const prcopt_t *popt, const solopt_t *sopt,
+                   const filopt_t *fopt)
 {
+    pcvs_t *pcvs=&ctx->pcvss,*pcvr=&ctx->pcvsr;
+    prodent_t *pa;
+    int stat;
+    char *satantp=(char *)fopt->satantp,*rcvantp=(char *)fopt->rcvantp;
+
     trace(3,"openses :\n");
 
     /* read satellite antenna parameters */
-    if (*fopt->satantp&&!(readpcv(fopt->satantp,pcvs))) {
-        showmsg("error : no sat ant pcv in %s",fopt->satantp);
-        trace(1,"sat antenna pcv read error: %s\n",fopt->satantp);
-        return 0;
+    if (!ctx->pcvp&&*fopt->satantp) {
+        if (prodacquire(PROD_PCVS,&satantp,1,&pa)) { /* cached parameters */
+            if (pa) *pcvs=pa->pcvs;
+            ctx->prodc[PROD_PCVS]=pa;
+            stat=pa!=NULL;
+        }
+        else stat=readpcv(fopt->satantp,pcvs);
+
+        if (!stat) {
+            showmsg("error : no sat ant pcv in %s",fopt->satantp);
+            trace(1,"sat antenna pcv read error: %s\n",fopt->satantp);
+            return 0;
+        }
     }
     /* read receiver antenna parameters */
-    if (*fopt->rcvantp&&!(readpcv(fopt->rcvantp,pcvr))) {
-        showmsg("error : no rec ant pcv in %s",fopt->rcvantp);
-        trace(1,"rec antenna pcv read error: %s\n",fopt->rcvantp);
-        return 0;
+    if (*fopt->rcvantp) {
+        if (prodacquire(PROD_PCVR,&rcvantp,1,&pa)) { /* cached parameters */
+            if (pa) *pcvr=pa->pcvs;
+            ctx->prodc[PROD_PCVR]=pa;
+            stat=pa!=NULL;
+        }
+        else stat=readpcv(fopt->rcvantp,pcvr);
+
+        if (!stat) {
+            showmsg("error : no rec ant pcv in %s",fopt->rcvantp);
+            trace(1,"rec antenna pcv read error: %s\n",fopt->rcvantp);
+            return 0;
+        }
     }
     /* open geoid data */
     if (sopt->geoid>0&&*fopt->geoid) {
@@ -910,23 +1381,32 @@ static int openses(const prcopt_t *popt, const solopt_t *sopt,
     return 1;
 }
 /* close processing session ---------------------------------------------------*/
-static void closeses(nav_t *nav, pcvs_t *pcvs, pcvs_t *pcvr)
+static void closeses(postctx_t *ctx, const solopt_t *sopt,
+                     const filopt_t *fopt)
 {
+    pcvs_t *pcvs=&ctx->pcvss,*pcvr=&ctx->pcvsr;
+    nav_t *nav=&ctx->navs;
+
     trace(3,"closeses:\n");
 
     /* free antenna parameters */
-    free(pcvs->pcv); pcvs->pcv=NULL; pcvs->n=pcvs->nmax=0;
-    free(pcvr->pcv); pcvr->pcv=NULL; pcvr->n=pcvr->nmax=0;
+    if (ctx->prodc[PROD_PCVS]) prodrelease((prodent_t *)ctx->prodc[PROD_PCVS]);
+    else free(pcvs->pcv);
+    if (ctx->prodc[PROD_PCVR]) prodrelease((prodent_t *)ctx->prodc[PROD_PCVR]);
+    else free(pcvr->pcv);
+    ctx->prodc[PROD_PCVS]=ctx->prodc[PROD_PCVR]=NULL;
+    pcvs->pcv=NULL; pcvs->n=pcvs->nmax=0;
+    pcvr->pcv=NULL; pcvr->n=pcvr->nmax=0;
 
     /* close geoid data */
-    closegeoid();
+    if (sopt->geoid>0&&*fopt->geoid) closegeoid();
 
     /* free erp data */
     free(nav->erp.data); nav->erp.data=NULL; nav->erp.n=nav->erp.nmax=0;
 
     /* close solution statistics and debug trace */
-    rtkclosestat();
-    traceclose();
+    if (sopt->sstat>0) rtkclosestat();
+    if (sopt->trace>0) traceclose();
 }
 /* set antenna parameters ----------------------------------------------------*/
 static void setpcv(gtime_t time, prcopt_t *popt, nav_t *nav, const pcvs_t *pcvs,
@@ -960,7 +1440,7 @@ static void setpcv(gtime_t time, prcopt_t *popt, nav_t *nav, const pcvs_t *pcvs,
                 }
             }
             else { /* enu */
-                for (j=0;j<3;j++) popt->antdel[i][j]=stas[i].del[j];
+                for (j=0;j<3;j++) popt->antdel[i][j]=sta[i].del[j];
             }
         }
         if (!(pcv=searchpcv(0,popt->anttype[i],time,pcvr))) {
@@ -982,7 +1462,7 @@ static void readotl(prcopt_t *popt, const char *file, const sta_t *sta)
     }
 }
 /* write header to output file -----------------------------------------------*/
-static int outhead(const char *outfile, char **infile, int n,
+static int outhead(const char *outfile, char **infile, int n, const obs_t *obs,
                    const prcopt_t *popt, const solopt_t *sopt)
 {
     FILE *fp=stdout;
@@ -998,7 +1478,7 @@ static int outhead(const char *outfile, char **infile, int n,
         }
     }
     /* output header */
-    outheader(fp,infile,n,popt,sopt);
+    outheader(fp,infile,n,obs,popt,sopt);
 
     if (*outfile) fclose(fp);
 
@@ -1029,13 +1509,18 @@ static void namefiletm(char *outfiletm, const char *outfile)
     strcat(outfiletm, "_events.pos");
 }
 /* execute processing session ------------------------------------------------*/
-static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
-                   const solopt_t *sopt, const filopt_t *fopt, int flag,
-                   char **infile, const int *index, int n, char *outfile)
+static int execses(postctx_t *ctx, gtime_t ts, gtime_t te, double ti,
+                   const prcopt_t *popt, const solopt_t *sopt,
+                   const filopt_t *fopt, int flag, char **infile,
+                   const int *index, int n, char *outfile)
 {
     rtk_t *rtk_ptr = (rtk_t *)malloc(sizeof(rtk_t)); /* moved from stack to heap to avoid stack overflow warning */
+    rtk_t *rtk_b;
+    pass_t pf,pb;
     prcopt_t popt_=*popt;
+    prodent_t *pt;
     char tracefile[1024],statfile[1024],path[1024],*ext,outfiletm[1024]={0};
+    char *pathp=path;
     int i,j,k,dcb_ok;
 
     trace(3,"execses : n=%d outfile=%s\n",n,outfile);
@@ -1058,22 +1543,30 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
         if (strlen(ext)==4&&(ext[3]=='i'||ext[3]=='I'||
                              strcmp(ext,".INX")==0||strcmp(ext,".inx")==0)) {
             reppath(fopt->iono,path,ts,"","");
-            readtec(path,&navs,1);
+            if (prodacquire(PROD_TEC,&pathp,1,&pt)) { /* cached tec grid */
+                prodrelease((prodent_t *)ctx->prodc[PROD_TEC]);
+                ctx->prodc[PROD_TEC]=pt;
+                ctx->navs.tec=pt?pt->tec:NULL;
+                ctx->navs.nt=ctx->navs.ntmax=pt?pt->n:0;
+            }
+            else readtec(path,&ctx->navs,1);
         }
     }
     /* read erp data */
     if (*fopt->eop) {
-        free(navs.erp.data); navs.erp.data=NULL; navs.erp.n=navs.erp.nmax=0;
+        free(ctx->navs.erp.data); ctx->navs.erp.data=NULL;
+        ctx->navs.erp.n=ctx->navs.erp.nmax=0;
         reppath(fopt->eop,path,ts,"","");
-        if (!readerp(path,&navs.erp)) {
+        if (!readerp(path,&ctx->navs.erp)) {
             showmsg("error : no erp data %s",path);
             trace(2,"no erp data %s\n",path);
         }
     }
     /* read obs and nav data */
-    if (!readobsnav(ts,te,ti,infile,index,n,&popt_,&obss,&navs,stas)) {
+    if (!readobsnav(ctx,ts,te,ti,infile,index,n,&popt_,&ctx->obss,&ctx->navs,
+                    ctx->stas)) {
         /* free obs and nav data */
-        freeobsnav(&obss, &navs);
+        freeobsnav(&ctx->obss, &ctx->navs);
         free(rtk_ptr);
         return 0;
     }
@@ -1082,44 +1575,48 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
     dcb_ok = 0;
     for (i=0;i<MAX_CODE_BIASES;i++) for (k=0;k<MAX_CODE_BIAS_FREQS;k++) {
         /* FIXME: cbias later initialized with 0 in readdcb()!  */
-        for (j=0;j<MAXSAT;j++) navs.cbias[j][k][i]=-1;
-        for (j=0;j<MAXRCV;j++) navs.rbias[j][k][i]=0;
+        for (j=0;j<MAXSAT;j++) ctx->navs.cbias[j][k][i]=-1;
+        for (j=0;j<MAXRCV;j++) ctx->navs.rbias[j][k][i]=0;
     }
     for (i=0,j=0;i<n;i++) {  /* first check infiles for .BIA or .BSX files */
-        if ((dcb_ok=readdcb(infile[i],&navs,stas))) break;
+        if ((dcb_ok=readdcb(infile[i],&ctx->navs,ctx->stas))) break;
     }
     if (!dcb_ok&&*fopt->dcb) {  /* then check if DCB file specified */
         reppath(fopt->dcb,path,ts,"","");
-        dcb_ok=readdcb(path,&navs,stas);
+        dcb_ok=readdcb(path,&ctx->navs,ctx->stas);
     }
     if (!dcb_ok) {
 
     }
     /* set antenna parameters */
     if (popt_.mode!=PMODE_SINGLE) {
-        setpcv(obss.n>0?obss.data[0].time:timeget(),&popt_,&navs,&pcvss,&pcvsr,
-               stas);
+        setpcv(ctx->obss.n>0?ctx->obss.data[0].time:timeget(),&popt_,&ctx->navs,
+               ctx->pcvp?ctx->pcvp:&ctx->pcvss,&ctx->pcvsr,
+               ctx->stas);
     }
     /* read ocean tide loading parameters */
     if (popt_.mode>PMODE_SINGLE&&*fopt->blq) {
-        readotl(&popt_,fopt->blq,stas);
+        readotl(&popt_,fopt->blq,ctx->stas);
     }
     /* rover/reference fixed position */
     if (popt_.mode==PMODE_FIXED) {
-        if (!antpos(&popt_,1,&obss,&navs,stas,fopt->stapos)) {
-            freeobsnav(&obss,&navs);
+        if (!antpos(&popt_,1,&ctx->obss,&ctx->navs,&ctx->pstrm,ctx->stas,
+                    fopt->stapos)) {
+            freeobsnav(&ctx->obss,&ctx->navs);
             free(rtk_ptr);
             return 0;
         }
-        if (!antpos(&popt_,2,&obss,&navs,stas,fopt->stapos)) {
-            freeobsnav(&obss,&navs);
+        if (!antpos(&popt_,2,&ctx->obss,&ctx->navs,&ctx->pstrm,ctx->stas,
+                    fopt->stapos)) {
+            freeobsnav(&ctx->obss,&ctx->navs);
             free(rtk_ptr);
             return 0;
         }
     }
     else if (PMODE_DGPS<=popt_.mode&&popt_.mode<=PMODE_STATIC_START) {
-        if (!antpos(&popt_,2,&obss,&navs,stas,fopt->stapos)) {
-            freeobsnav(&obss,&navs);
+        if (!antpos(&popt_,2,&ctx->obss,&ctx->navs,&ctx->pstrm,ctx->stas,
+                    fopt->stapos)) {
+            freeobsnav(&ctx->obss,&ctx->navs);
             free(rtk_ptr);
             return 0;
         }
@@ -1132,25 +1629,26 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
         rtkopenstat(statfile,sopt->sstat);
     }
     /* write header to output file */
-    if (flag&&!outhead(outfile,infile,n,&popt_,sopt)) {
-        freeobsnav(&obss,&navs);
+    if (flag&&!outhead(outfile,infile,n,&ctx->obss,&popt_,sopt)) {
+        freeobsnav(&ctx->obss,&ctx->navs);
         free(rtk_ptr);
         return 0;
     }
     /* name time events file */
     namefiletm(outfiletm,outfile);
     /* write header to file with time marks */
-    outhead(outfiletm,infile,n,&popt_,sopt);
+    outhead(outfiletm,infile,n,&ctx->obss,&popt_,sopt);
 
-    iobsu=iobsr=isbs=reverse=aborts=0;
+    ctx->aborts=0;
 
     if (popt_.mode==PMODE_SINGLE||popt_.soltype==SOLTYPE_FORWARD) {
         FILE *fp=openfile(outfile);
         if (fp) {
             FILE *fptm=openfile(outfiletm);
             if (fptm) {
+                initpass(ctx,&pf,0,NULL,NULL,rtk_ptr,&popt_,sopt);
                 rtkinit(rtk_ptr,&popt_);
-                procpos(fp,fptm,&popt_,sopt,rtk_ptr,SOLMODE_SINGLE_DIR);
+                procpos(fp,fptm,&popt_,sopt,rtk_ptr,SOLMODE_SINGLE_DIR,&pf);
                 rtkfree(rtk_ptr);
                 fclose(fptm);
             }
@@ -1162,9 +1660,9 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
         if (fp) {
             FILE *fptm=openfile(outfiletm);
             if (fptm) {
-                reverse=1; iobsu=iobsr=obss.n-1; isbs=sbss.n-1;
+                initpass(ctx,&pb,1,NULL,NULL,rtk_ptr,&popt_,sopt);
                 rtkinit(rtk_ptr,&popt_);
-                procpos(fp,fptm,&popt_,sopt,rtk_ptr,SOLMODE_SINGLE_DIR);
+                procpos(fp,fptm,&popt_,sopt,rtk_ptr,SOLMODE_SINGLE_DIR,&pb);
                 rtkfree(rtk_ptr);
                 fclose(fptm);
             }
@@ -1172,31 +1670,47 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
         }
     }
     else { /* combined or combined with no phase reset */
-        solf=(sol_t *)malloc(sizeof(sol_t)*nepoch);
-        solb=(sol_t *)malloc(sizeof(sol_t)*nepoch);
-        rbf=(double *)malloc(sizeof(double)*nepoch*3);
-        rbb=(double *)malloc(sizeof(double)*nepoch*3);
+        ctx->solf=(sol_t *)malloc(sizeof(sol_t)*ctx->nepoch);
+        ctx->solb=(sol_t *)malloc(sizeof(sol_t)*ctx->nepoch);
+        ctx->rbf=(double *)malloc(sizeof(double)*ctx->nepoch*3);
+        ctx->rbb=(double *)malloc(sizeof(double)*ctx->nepoch*3);
 
-        if (solf&&solb) {
-            isolf=isolb=0;
+        if (ctx->solf&&ctx->solb) {
+            initpass(ctx,&pf,0,ctx->solf,ctx->rbf,rtk_ptr,&popt_,sopt);
             rtkinit(rtk_ptr,&popt_);
-            procpos(NULL,NULL,&popt_,sopt,rtk_ptr,SOLMODE_COMBINED); /* forward */
-            reverse=1; iobsu=iobsr=obss.n-1; isbs=sbss.n-1;
-            if (popt_.soltype!=SOLTYPE_COMBINED_NORESET) {
-                /* Reset */
-                rtkfree(rtk_ptr);
-                rtkinit(rtk_ptr,&popt_);
+
+            /* forward and backward in parallel with separate rtk_t */
+            if (parcomb(ctx,&popt_,sopt)&&(rtk_b=(rtk_t *)malloc(sizeof(rtk_t)))) {
+                initpass(ctx,&pb,1,ctx->solb,ctx->rbb,rtk_b,&popt_,sopt);
+                rtkinit(rtk_b,&popt_);
+                if (!procpar(&pf,&pb)) {
+                    procthread(&pf);
+                    procthread(&pb);
+                }
+                rtkfree(rtk_b);
+                free(rtk_b);
+            }
+            else {
+                procpos(NULL,NULL,&popt_,sopt,rtk_ptr,SOLMODE_COMBINED,&pf); /* forward */
+                initpass(ctx,&pb,1,ctx->solb,ctx->rbb,rtk_ptr,&popt_,sopt);
+                if (popt_.soltype!=SOLTYPE_COMBINED_NORESET) {
+                    /* Reset */
+                    rtkfree(rtk_ptr);
+                    rtkinit(rtk_ptr,&popt_);
+                }
+                procpos(NULL,NULL,&popt_,sopt,rtk_ptr,SOLMODE_COMBINED,&pb); /* backward */
             }
-            procpos(NULL,NULL,&popt_,sopt,rtk_ptr,SOLMODE_COMBINED); /* backward */
             rtkfree(rtk_ptr);
+            ctx->isolf=pf.isol;
+            ctx->isolb=pb.isol;
 
             /* combine forward/backward solutions */
-            if (!aborts) {
+            if (!ctx->aborts) {
                 FILE *fp=openfile(outfile);
                 if (fp) {
                     FILE *fptm=openfile(outfiletm);
                     if (fptm) {
-                        combres(fp,fptm,&popt_,sopt);
+                        combres(ctx,fp,fptm,&popt_,sopt);
                         fclose(fptm);
                     }
                     fclose(fp);
@@ -1204,22 +1718,22 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
             }
         }
         else showmsg("error : memory allocation");
-        free(solf);
-        free(solb);
-        free(rbf);
-        free(rbb);
+        free(ctx->solf);
+        free(ctx->solb);
+        free(ctx->rbf);
+        free(ctx->rbb);
     }
     /* free rtk, obs and nav data */
     free(rtk_ptr);
-    freeobsnav(&obss,&navs);
+    freeobsnav(&ctx->obss,&ctx->navs);
 
-    return aborts?1:0;
+    return ctx->aborts?1:0;
 }
 /* execute processing session for each rover ---------------------------------*/
-static int execses_r(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
-                     const solopt_t *sopt, const filopt_t *fopt, int flag,
-                     char **infile, const int *index, int n, char *outfile,
-                     const char *rov)
+static int execses_r(postctx_t *ctx, gtime_t ts, gtime_t te, double ti,
+                     const prcopt_t *popt, const solopt_t *sopt,
+                     const filopt_t *fopt, int flag, char **infile,
+                     const int *index, int n, char *outfile, const char *rov)
 {
     gtime_t t0={0};
     int i,stat=0;
@@ -1243,9 +1757,9 @@ static int execses_r(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
             if ((q=strchr(p,' '))) *q='\0';
 
             if (*p) {
-                strcpy(proc_rov,p);
+                strcpy(ctx->proc_rov,p);
                 if (ts.time) time2str(ts,s,0); else *s='\0';
-                if (checkbrk("reading    : %s",s)) {
+                if (checkbrk(ctx,"reading    : %s",s)) {
                     stat=1;
                     break;
                 }
@@ -1253,7 +1767,8 @@ static int execses_r(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
                 reppath(outfile,ofile,t0,p,"");
 
                 /* execute processing session */
-                stat=execses(ts,te,ti,popt,sopt,fopt,flag,ifile,index,n,ofile);
+                stat=execses(ctx,ts,te,ti,popt,sopt,fopt,flag,ifile,index,n,
+                             ofile);
             }
             if (stat==1||!q) break;
         }
@@ -1261,15 +1776,17 @@ static int execses_r(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
     }
     else {
         /* execute processing session */
-        stat=execses(ts,te,ti,popt,sopt,fopt,flag,infile,index,n,outfile);
+        stat=execses(ctx,ts,te,ti,popt,sopt,fopt,flag,infile,index,n,
+                     outfile);
     }
     return stat;
 }
 /* execute processing session for each base station --------------------------*/
-static int execses_b(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
-                     const solopt_t *sopt, const filopt_t *fopt, int flag,
-                     char **infile, const int *index, int n, char *outfile,
-                     const char *rov, const char *base)
+static int execses_b(postctx_t *ctx, gtime_t ts, gtime_t te, double ti,
+                     const prcopt_t *popt, const solopt_t *sopt,
+                     const filopt_t *fopt, int flag, char **infile,
+                     const int *index, int n, char *outfile, const char *rov,
+                     const char *base)
 {
     gtime_t t0={0};
     int i,stat=0;
@@ -1278,13 +1795,13 @@ static int execses_b(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
     trace(3,"execses_b: n=%d outfile=%s\n",n,outfile);
 
     /* read prec ephemeris and sbas data */
-    readpreceph(infile,n,popt,&navs,&sbss);
+    readpreceph(ctx,infile,n,popt);
 
     for (i=0;i<n;i++) if (strstr(infile[i],"%b")) break;
 
     if (i<n) { /* include base station keywords */
         if (!(base_=(char *)malloc(strlen(base)+1))) {
-            freepreceph(&navs,&sbss);
+            freepreceph(ctx);
             return 0;
         }
         strcpy(base_,base);
@@ -1292,7 +1809,7 @@ static int execses_b(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
         for (i=0;i<n;i++) {
             if (!(ifile[i]=(char *)malloc(1024))) {
                 free(base_); for (;i>=0;i--) free(ifile[i]);
-                freepreceph(&navs,&sbss);
+                freepreceph(ctx);
                 return 0;
             }
         }
@@ -1300,76 +1817,78 @@ static int execses_b(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
             if ((q=strchr(p,' '))) *q='\0';
 
             if (*p) {
-                strcpy(proc_base,p);
+                strcpy(ctx->proc_base,p);
                 if (ts.time) time2str(ts,s,0); else *s='\0';
-                if (checkbrk("reading    : %s",s)) {
+                if (checkbrk(ctx,"reading    : %s",s)) {
                     stat=1;
                     break;
                 }
                 for (i=0;i<n;i++) reppath(infile[i],ifile[i],t0,"",p);
                 reppath(outfile,ofile,t0,"",p);
 
-                stat=execses_r(ts,te,ti,popt,sopt,fopt,flag,ifile,index,n,ofile,rov);
+                stat=execses_r(ctx,ts,te,ti,popt,sopt,fopt,flag,ifile,index,n,
+                               ofile,rov);
             }
             if (stat==1||!q) break;
         }
         free(base_); for (i=0;i<n;i++) free(ifile[i]);
     }
     else {
-        stat=execses_r(ts,te,ti,popt,sopt,fopt,flag,infile,index,n,outfile,rov);
+        stat=execses_r(ctx,ts,te,ti,popt,sopt,fopt,flag,infile,index,n,
+                       outfile,rov);
     }
     /* free prec ephemeris and sbas data */
-    freepreceph(&navs,&sbss);
+    freepreceph(ctx);
 
     return stat;
 }
-/* post-processing positioning -------------------------------------------------
-* post-processing positioning
-* args   : gtime_t ts       I   processing start time (ts.time==0: no limit)
-*        : gtime_t te       I   processing end time   (te.time==0: no limit)
-*          double ti        I   processing interval  (s) (0:all)
-*          double tu        I   processing unit time (s) (0:all)
-*          prcopt_t *popt   I   processing options
-*          solopt_t *sopt   I   solution options
-*          filopt_t *fopt   I   file options
-*          char   **infile  I   input files (see below)
-*          int    n         I   number of input files
-*          char   *outfile  I   output file ("":stdout, see below)
-*          char   *rov      I   rover id list        (separated by " ")
-*          char   *base     I   base station id list (separated by " ")
+/* initialize post-processing context -----------------------------------------
+* initialize post-processing context
+* args   : postctx_t *ctx   O   post-processing context
+*          nav_t  *prod     I   shared precise ephemeris and clock
+*                               (NULL: read from input files in each session)
+*          pcvs_t *pcvp     I   shared satellite antenna parameters
+*                               (NULL: read from fopt->satantp)
+* return : none
+* notes  : prod and pcvp are only referred, never modified or freed, so they can
+*          be shared by contexts processed concurrently in other threads
+*          free the context by postctxfree() after processing
+*-----------------------------------------------------------------------------*/
+extern void postctxinit(postctx_t *ctx, const nav_t *prod, const pcvs_t *pcvp)
+{
+    trace(3,"postctxinit:\n");
+
+    memset(ctx,0,sizeof(postctx_t));
+    ctx->prod=prod;
+    ctx->pcvp=pcvp;
+    rtklib_initlock(&ctx->lock);
+}
+/* free post-processing context ------------------------------------------------
+* free resources of post-processing context initialized by postctxinit()
+* args   : postctx_t *ctx   IO  post-processing context
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void postctxfree(postctx_t *ctx)
+{
+    trace(3,"postctxfree:\n");
+
+    rtklib_destroylock(&ctx->lock);
+}
+/* post-processing positioning with context ------------------------------------
+* post-processing positioning with context (reentrant)
+* args   : postctx_t *ctx   IO  post-processing context
+*          others               same as postpos()
 * return : status (0:ok,0>:error,1:aborted)
-* notes  : input files should contain observation data, navigation data, precise
-*          ephemeris/clock (optional), sbas log file (optional), ssr message
-*          log file (optional) and tec grid file (optional). only the first
-*          observation data file in the input files is recognized as the rover
-*          data.
-*
-*          the type of an input file is recognized by the file extension as ]
-*          follows:
-*              .sp3,.SP3,.eph*,.EPH*: precise ephemeris (sp3c)
-*              .sbs,.SBS,.ems,.EMS  : sbas message log files (rtklib or ems)
-*              .rtcm3,.RTCM3        : ssr message log files (rtcm3)
-*              .*i,.*I              : tec grid files (ionex)
-*              others               : rinex obs, nav, gnav, hnav, qnav or clock
-*
-*          inputs files can include wild-cards (*). if an file includes
-*          wild-cards, the wild-card expanded multiple files are used.
-*
-*          inputs files can include keywords. if an file includes keywords,
-*          the keywords are replaced by date, time, rover id and base station
-*          id and multiple session analyses run. refer reppath() for the
-*          keywords.
-*
-*          the output file can also include keywords. if the output file does
-*          not include keywords. the results of all multiple session analyses
-*          are output to a single output file.
-*
-*          ssr corrections are valid only for forward estimation.
+* notes  : postposc() can be executed concurrently in threads with separate
+*          contexts. solution status output, debug trace and external geoid
+*          model are process-wide, so sopt->sstat, sopt->trace and fopt->geoid
+*          should be disabled in that case. showmsg() is called from each
+*          thread.
 *-----------------------------------------------------------------------------*/
-extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
-                   const prcopt_t *popt, const solopt_t *sopt,
-                   const filopt_t *fopt, char **infile, int n, char *outfile,
-                   const char *rov, const char *base)
+extern int postposc(postctx_t *ctx, gtime_t ts, gtime_t te, double ti,
+                    double tu, const prcopt_t *popt, const solopt_t *sopt,
+                    const filopt_t *fopt, char **infile, int n, char *outfile,
+                    const char *rov, const char *base)
 {
     gtime_t tts,tte,ttte;
     double tunit,tss;
@@ -1379,18 +1898,18 @@ extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
     trace(3,"postpos : ti=%.0f tu=%.0f n=%d outfile=%s\n",ti,tu,n,outfile);
 
     /* open processing session */
-    if (!openses(popt,sopt,fopt,&navs,&pcvss,&pcvsr)) return -1;
+    if (!openses(ctx,popt,sopt,fopt)) return -1;
 
     if (ts.time!=0&&te.time!=0&&tu>=0.0) {
         if (timediff(te,ts)<0.0) {
             showmsg("error : no period");
-            closeses(&navs,&pcvss,&pcvsr);
+            closeses(ctx,sopt,fopt);
             return 0;
         }
         for (i=0;i<MAXINFILE;i++) {
             if (!(ifile[i]=(char *)malloc(1024))) {
                 for (;i>=0;i--) free(ifile[i]);
-                closeses(&navs,&pcvss,&pcvsr);
+                closeses(ctx,sopt,fopt);
                 return -1;
             }
         }
@@ -1406,9 +1925,9 @@ extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
             if (timediff(tts,ts)<0.0) tts=ts;
             if (timediff(tte,te)>0.0) tte=te;
 
-            strcpy(proc_rov ,"");
-            strcpy(proc_base,"");
-            if (checkbrk("reading    : %s",time_str(tts,0))) {
+            strcpy(ctx->proc_rov ,"");
+            strcpy(ctx->proc_base,"");
+            if (checkbrk(ctx,"reading    : %s",time_str(tts,0))) {
                 stat=1;
                 break;
             }
@@ -1441,7 +1960,7 @@ extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
             if (!reppath(outfile,ofile,tts,"","")&&i>0) flag=0;
 
             /* execute processing session */
-            stat=execses_b(tts,tte,ti,popt,sopt,fopt,flag,ifile,index,nf,ofile,
+            stat=execses_b(ctx,tts,tte,ti,popt,sopt,fopt,flag,ifile,index,nf,ofile,
                            rov,base);
 
             if (stat==1) break;
@@ -1460,7 +1979,7 @@ extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
         reppath(outfile,ofile,ts,"","");
 
         /* execute processing session */
-        stat=execses_b(ts,te,ti,popt,sopt,fopt,1,ifile,index,n,ofile,rov,
+        stat=execses_b(ctx,ts,te,ti,popt,sopt,fopt,1,ifile,index,n,ofile,rov,
                        base);
 
         for (i=0;i<n&&i<MAXINFILE;i++) free(ifile[i]);
@@ -1469,11 +1988,72 @@ extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
         for (i=0;i<n;i++) index[i]=i;
 
         /* execute processing session */
-        stat=execses_b(ts,te,ti,popt,sopt,fopt,1,infile,index,n,outfile,rov,
+        stat=execses_b(ctx,ts,te,ti,popt,sopt,fopt,1,infile,index,n,outfile,rov,
                        base);
     }
     /* close processing session */
-    closeses(&navs,&pcvss,&pcvsr);
+    closeses(ctx,sopt,fopt);
 
     return stat;
 }
+/* post-processing positioning -------------------------------------------------
+* post-processing positioning
+* args   : gtime_t ts       I   processing start time (ts.time==0: no limit)
+*        : gtime_t te       I   processing end time   (te.time==0: no limit)
+*          double ti        I   processing interval  (s) (0:all)
+*          double tu        I   processing unit time (s) (0:all)
+*          prcopt_t *popt   I   processing options
+*          solopt_t *sopt   I   solution options
+*          filopt_t *fopt   I   file options
+*          char   **infile  I   input files (see below)
+*          int    n         I   number of input files
+*          char   *outfile  I   output file ("":stdout, see below)
+*          char   *rov      I   rover id list        (separated by " ")
+*          char   *base     I   base station id list (separated by " ")
+* return : status (0:ok,0>:error,1:aborted)
+* notes  : input files should contain observation data, navigation data, precise
+*          ephemeris/clock (optional), sbas log file (optional), ssr message
+*          log file (optional) and tec grid file (optional). only the first
+*          observation data file in the input files is recognized as the rover
+*          data.
+*
+*          the type of an input file is recognized by the file extension as ]
+*          follows:
+*              .sp3,.SP3,.eph*,.EPH*: precise ephemeris (sp3c)
+*              .sbs,.SBS,.ems,.EMS  : sbas message log files (rtklib or ems)
+*              .rtcm3,.RTCM3        : ssr message log files (rtcm3)
+*              .*i,.*I              : tec grid files (ionex)
+*              others               : rinex obs, nav, gnav, hnav, qnav or clock
+*
+*          inputs files can include wild-cards (*). if an file includes
+*          wild-cards, the wild-card expanded multiple files are used.
+*
+*          inputs files can include keywords. if an file includes keywords,
+*          the keywords are replaced by date, time, rover id and base station
+*          id and multiple session analyses run. refer reppath() for the
+*          keywords.
+*
+*          the output file can also include keywords. if the output file does
+*          not include keywords. the results of all multiple session analyses
+*          are output to a single output file.
+*
+*          ssr corrections are valid only for forward estimation.
+*-----------------------------------------------------------------------------*/
+extern int postpos(gtime_t ts, gtime_t te, double ti, double tu,
+                   const prcopt_t *popt, const solopt_t *sopt,
+                   const filopt_t *fopt, char **infile, int n, char *outfile,
+                   const char *rov, const char *base)
+{
+    postctx_t *ctx;
+    int stat;
+
+    if (!(ctx=(postctx_t *)malloc(sizeof(postctx_t)))) {
+        showmsg("error : memory allocation");
+        return -1;
+    }
+    postctxinit(ctx,NULL,NULL);
+    stat=postposc(ctx,ts,te,ti,tu,popt,sopt,fopt,infile,n,outfile,rov,base);
+    postctxfree(ctx);
+    free(ctx);
+    return stat;
+}
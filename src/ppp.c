@@ -246,15 +246,13 @@ extern int yaw_angle(int sat, const char *type, int opt, double beta, double mu,
     return 1;
 }
 /* satellite attitude model --------------------------------------------------*/
-static int sat_yaw(gtime_t time, int sat, const char *type, int opt,
+static int sat_yaw(const double *rsun, int sat, const char *type, int opt,
                    const double *rs, double *exs, double *eys)
 {
-    double rsun[3],ri[6],es[3],esun[3],n[3],p[3],en[3],ep[3],ex[3],E,beta,mu;
-    double yaw,cosy,siny,erpv[5]={0};
+    double ri[6],es[3],esun[3],n[3],p[3],en[3],ep[3],ex[3],E,beta,mu;
+    double yaw,cosy,siny;
     int i;
 
-    sunmoonpos(gpst2utc(time),erpv,rsun,NULL,NULL);
-
     /* beta and orbit angle */
     matcpy(ri,rs,6,1);
     ri[3]-=OMGE*ri[1];
@@ -283,7 +281,7 @@ static int sat_yaw(gtime_t time, int sat, const char *type, int opt,
     return 1;
 }
 /* phase windup model --------------------------------------------------------*/
-static int model_phw(gtime_t time, int sat, const char *type, int opt,
+static int model_phw(const double *rsun, int sat, const char *type, int opt,
                      const double *rs, const double *rr, double *phw)
 {
     double exs[3],eys[3],ek[3],exr[3],eyr[3],eks[3],ekr[3],E[9];
@@ -293,7 +291,7 @@ static int model_phw(gtime_t time, int sat, const char *type, int opt,
     if (opt<=0) return 1; /* no phase windup */
 
     /* satellite yaw attitude model */
-    if (!sat_yaw(time,sat,type,opt,rs,exs,eys)) return 0;
+    if (!sat_yaw(rsun,sat,type,opt,rs,exs,eys)) return 0;
 
     /* unit vector satellite to receiver */
     for (i=0;i<3;i++) r[i]=rr[i]-rs[i];
@@ -518,8 +516,8 @@ static void detslp_mw(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
 /* temporal update of position -----------------------------------------------*/
 static void udpos_ppp(rtk_t *rtk)
 {
-    double *F,*P,*FP,*x,*xp,pos[3],Q[9]={0},Qv[9],var=0.0;
-    int i,j,*ix,nx;
+    double F[81]={0},xp[9],p[9],q[9],*P,pos[3],Q[9]={0},Qv[9],var=0.0;
+    int i,j,*ix,nx,mark;
 
     trace(3,"udpos_ppp:\n");
 
@@ -563,39 +561,37 @@ static void udpos_ppp(rtk_t *rtk)
         return;
     }
     /* generate valid state index */
-    ix=imat(rtk->nx,1);
+    mark=wspmark(&rtk->ws);
+    ix=wspimat(&rtk->ws,rtk->nx,1);
     for (i=nx=0;i<rtk->nx;i++) {
         if  (i<9||(rtk->x[i]!=0.0&&rtk->P[i+i*rtk->nx]>0.0)) ix[nx++]=i;
     }
     /* state transition of position/velocity/acceleration */
-    F=eye(nx); P=mat(nx,nx); FP=mat(nx,nx); x=mat(nx,1); xp=mat(nx,1);
-
+    for (i=0;i<9;i++) {
+        F[i+i*9]=1.0;
+    }
     for (i=0;i<6;i++) {
-        F[i+(i+3)*nx]=rtk->tt;
+        F[i+(i+3)*9]=rtk->tt;
     }
     /* include accel terms if filter is converged */
     if (var<rtk->opt.thresar[1]) {
         for (i=0;i<3;i++) {
-            F[i+(i+6)*nx]=SQR(rtk->tt)/2.0;
+            F[i+(i+6)*9]=SQR(rtk->tt)/2.0;
         }
     }
     else trace(3,"pos var too high for accel term: %.4f,%.4f\n", var,rtk->opt.thresar[1]);
-    for (i=0;i<nx;i++) {
-        x[i]=rtk->x[ix[i]];
-        for (j=0;j<nx;j++) {
-            P[i+j*nx]=rtk->P[ix[i]+ix[j]*rtk->nx];
-        }
-    }
-    /* x=F*x, P=F*P*F+Q */
-    matmul("NN",nx,1,nx,F,x,xp);
-    matmul("NN",nx,nx,nx,F,P,FP);
-    matmul("NT",nx,nx,nx,FP,F,P);
-
-    for (i=0;i<nx;i++) {
-        rtk->x[ix[i]]=xp[i];
-        for (j=0;j<nx;j++) {
-            rtk->P[ix[i]+ix[j]*rtk->nx]=P[i+j*nx];
-        }
+    /* x=F*x, P=F*P*F+Q (F is identity except pos/vel/acc block) */
+    matmul("NN",9,1,9,F,rtk->x,xp);
+    matcpy(rtk->x,xp,9,1);
+    for (j=0;j<nx;j++) { /* rows of pos/vel/acc: P=F*P */
+        P=rtk->P+ix[j]*rtk->nx;
+        matcpy(p,P,9,1);
+        matmul("NN",9,1,9,F,p,P);
+    }
+    for (i=0;i<nx;i++) { /* columns of pos/vel/acc: P=P*F' */
+        for (j=0;j<9;j++) p[j]=rtk->P[ix[i]+j*rtk->nx];
+        matmul("NT",1,9,9,p,F,q);
+        for (j=0;j<9;j++) rtk->P[ix[i]+j*rtk->nx]=q[j];
     }
     /* process noise added to only acceleration */
     Q[0]=Q[4]=SQR(rtk->opt.prn[3])*fabs(rtk->tt);
@@ -605,7 +601,7 @@ static void udpos_ppp(rtk_t *rtk)
     for (i=0;i<3;i++) for (j=0;j<3;j++) {
         rtk->P[i+6+(j+6)*rtk->nx]+=Qv[i+j*3];
     }
-    free(ix); free(F); free(P); free(FP); free(x); free(xp);
+    wsprelease(&rtk->ws,mark);
 }
 /* temporal update of clock --------------------------------------------------*/
 static void udclk_ppp(rtk_t *rtk)
@@ -926,6 +922,74 @@ static int model_iono(gtime_t time, const double *pos, const double *azel,
     }
     return 0;
 }
+typedef struct {        /* satellite models of ppp_res() type */
+    double r;           /* geometric range (m) */
+    double e[3];        /* line-of-sight vector */
+    double dtdx[3];     /* partial derivatives of trop delay */
+    double dtrp,vart;   /* trop delay and variance (m,m^2) */
+    double dion,vari;   /* iono delay and variance (m,m^2) */
+    double L[NFREQ],P[NFREQ],Lc,Pc; /* corrected phase and code (m) */
+    int stat;           /* status (0:no model,1:ok) */
+} satmod_t;
+
+typedef struct {        /* arguments of ppp_sat() type */
+    const obsd_t *obs;  /* observation data */
+    const double *rs,*var_rs; /* satellite positions and variances */
+    const int *svh;     /* satellite health flags */
+    const nav_t *nav;   /* navigation data */
+    const double *x,*rr,*pos; /* states and receiver position */
+    double rsun[3];     /* sun position for phase windup (ecef) (m) */
+    rtk_t *rtk;         /* rtk control/result struct */
+    int *exc;           /* excluded satellites */
+    double *azel;       /* azimuth/elevation angles */
+    satmod_t *mod;      /* satellite models */
+} satarg_t;
+
+/* satellite models of satellite i (thread) ----------------------------------*/
+static void ppp_sat(void *arg_, int i)
+{
+    const satarg_t *arg=(const satarg_t *)arg_;
+    const obsd_t *obs=arg->obs+i;
+    const nav_t *nav=arg->nav;
+    rtk_t *rtk=arg->rtk;
+    const prcopt_t *opt=&rtk->opt;
+    satmod_t *mod=arg->mod+i;
+    double *azel=arg->azel+i*2,dantr[NFREQ]={0},dants[NFREQ]={0};
+    int sat=obs->sat;
+
+    mod->stat=0;
+
+    if ((mod->r=geodist(arg->rs+i*6,arg->rr,mod->e))<=0.0||
+        satazel(arg->pos,mod->e,azel)<opt->elmin) {
+        arg->exc[i]=1;
+        return;
+    }
+    if (!satsys(sat,NULL)||!rtk->ssat[sat-1].vs||
+        satexclude(sat,arg->var_rs[i],arg->svh[i],opt)||arg->exc[i]) {
+        arg->exc[i]=1;
+        return;
+    }
+    /* tropospheric and ionospheric model */
+    if (!model_trop(obs->time,arg->pos,azel,opt,arg->x,mod->dtdx,nav,&mod->dtrp,
+                    &mod->vart)||
+        !model_iono(obs->time,arg->pos,azel,opt,sat,arg->x,nav,&mod->dion,
+                    &mod->vari)) {
+        return;
+    }
+    /* satellite and receiver antenna model */
+    if (opt->posopt[0]) satantpcv(arg->rs+i*6,arg->rr,nav->pcvs+sat-1,dants);
+    antmodel(opt->pcvr,opt->antdel[0],azel,opt->posopt[1],dantr);
+
+    /* phase windup model */
+    if (!model_phw(arg->rsun,sat,nav->pcvs[sat-1].type,opt->posopt[2]?2:0,
+                   arg->rs+i*6,arg->rr,&rtk->ssat[sat-1].phw)) {
+        return;
+    }
+    /* corrected phase and code measurements */
+    corr_meas(obs,nav,azel,opt,dantr,dants,rtk->ssat[sat-1].phw,mod->L,mod->P,
+              &mod->Lc,&mod->Pc);
+    mod->stat=1;
+}
 /* phase and code residuals --------------------------------------------------*/
 static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
                    const double *dts, const double *var_rs, const int *svh,
@@ -934,10 +998,10 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
                    double *azel)
 {
     prcopt_t *opt=&rtk->opt;
-    double y,r,cdtr,bias,rr[3],pos[3],e[3],dtdx[3],L[NFREQ],P[NFREQ],Lc,Pc;
-    double var[MAXOBS*2],dtrp=0.0,dion=0.0,vart=0.0,vari=0.0,dcb,freq;
-    double dantr[NFREQ]={0},dants[NFREQ]={0};
-    double ve[MAXOBS*2*NFREQ]={0},vmax=0;
+    satarg_t arg;
+    satmod_t mod[MAXOBS],*m;
+    double y,cdtr,bias,rr[3],pos[3],dcb,freq,erpv[5]={0};
+    double var[MAXOBS*2],ve[MAXOBS*2*NFREQ]={0},vmax=0;
     char str[32];
     int ne=0,obsi[MAXOBS*2*NFREQ]={0},frqi[MAXOBS*2*NFREQ],maxobs,maxfrq,rej;
     int i,j,k,sat,sys,nv=0,nx=rtk->nx,stat=1,frq,code;
@@ -949,36 +1013,21 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
     for (i=0;i<3;i++) rr[i]=x[i]+dr[i];
     ecef2pos(rr,pos);
 
+    /* satellite models by threads */
+    arg.obs=obs; arg.rs=rs; arg.var_rs=var_rs; arg.svh=svh; arg.nav=nav;
+    arg.x=x; arg.rr=rr; arg.pos=pos; arg.rtk=rtk; arg.exc=exc; arg.azel=azel;
+    arg.mod=mod;
+    if (opt->posopt[2]) { /* sun position for satellite attitude */
+        sunmoonpos(gpst2utc(rtk->sol.time),erpv,arg.rsun,NULL,NULL);
+    }
+    parexec(rtk->pool,MIN(n,MAXOBS),ppp_sat,&arg);
+
     for (i=0;i<n&&i<MAXOBS;i++) {
         sat=obs[i].sat;
+        m=mod+i;
 
-        if ((r=geodist(rs+i*6,rr,e))<=0.0||
-            satazel(pos,e,azel+i*2)<opt->elmin) {
-            exc[i]=1;
-            continue;
-        }
-        if (!(sys=satsys(sat,NULL))||!rtk->ssat[sat-1].vs||
-            satexclude(sat,var_rs[i],svh[i],opt)||exc[i]) {
-            exc[i]=1;
-            continue;
-        }
-        /* tropospheric and ionospheric model */
-        if (!model_trop(obs[i].time,pos,azel+i*2,opt,x,dtdx,nav,&dtrp,&vart)||
-            !model_iono(obs[i].time,pos,azel+i*2,opt,sat,x,nav,&dion,&vari)) {
-            continue;
-        }
-        /* satellite and receiver antenna model */
-        if (opt->posopt[0]) satantpcv(rs+i*6,rr,nav->pcvs+sat-1,dants);
-        antmodel(opt->pcvr,opt->antdel[0],azel+i*2,opt->posopt[1],dantr);
-
-        /* phase windup model */
-        if (!model_phw(rtk->sol.time,sat,nav->pcvs[sat-1].type,
-                       opt->posopt[2]?2:0,rs+i*6,rr,&rtk->ssat[sat-1].phw)) {
-            continue;
-        }
-        /* corrected phase and code measurements */
-        corr_meas(obs+i,nav,azel+i*2,&rtk->opt,dantr,dants,
-                  rtk->ssat[sat-1].phw,L,P,&Lc,&Pc);
+        if (!m->stat) continue;
+        sys=satsys(sat,NULL);
 
         /* stack phase and code residuals {L1,P1,L2,P2,...} */
         for (j=0;j<2*NF(opt);j++) {
@@ -989,10 +1038,10 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
             frq=j/2;
 
             if (opt->ionoopt==IONOOPT_IFLC) {
-                if ((y=code==0?Lc:Pc)==0.0) continue;
+                if ((y=code==0?m->Lc:m->Pc)==0.0) continue;
             }
             else {
-                if ((y=code==0?L[frq]:P[frq])==0.0) continue;
+                if ((y=code==0?m->L[frq]:m->P[frq])==0.0) continue;
 
                 if ((freq=sat2freq(sat,obs[i].code[frq],nav))==0.0) continue;
                 /* The iono paths have already applied a slant factor. */
@@ -1000,7 +1049,7 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
             }
             if (H) {
                 for (k=0;k<nx;k++) H[k+nx*nv]=0.0;
-                for (k=0;k<3;k++) H[k+nx*nv]=-e[k];
+                for (k=0;k<3;k++) H[k+nx*nv]=-m->e[k];
             }
 
             /* receiver clock */
@@ -1017,7 +1066,7 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
 
                 if (opt->tropopt==TROPOPT_EST||opt->tropopt==TROPOPT_ESTG) {
                     for (k=0;k<(opt->tropopt>=TROPOPT_ESTG?3:1);k++) {
-                        H[IT(opt)+k+nx*nv]=dtdx[k];
+                        H[IT(opt)+k+nx*nv]=m->dtdx[k];
                     }
                 }
             }
@@ -1037,7 +1086,7 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
                 if (H) H[IB(sat,frq,opt)+nx*nv]=1.0;
             }
             /* residual */
-            double res=y-(r+cdtr-CLIGHT*dts[i*2]+dtrp+C*dion+dcb+bias);
+            double res=y-(m->r+cdtr-CLIGHT*dts[i*2]+m->dtrp+C*m->dion+dcb+bias);
             if (v) v[nv]=res;
 
             if (code==0) rtk->ssat[sat-1].resc[frq]=res;  /* carrier phase */
@@ -1047,7 +1096,7 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
             var[nv]=varerr(sat,sys,azel[1+i*2],
                     SNR_UNIT*rtk->ssat[sat-1].snr_rover[frq],
                     j,opt,obs+i);
-            var[nv] +=vart+SQR(C)*vari+var_rs[i];
+            var[nv] +=m->vart+SQR(C)*m->vari+var_rs[i];
             if (sys==SYS_GLO&&code==1) var[nv]+=VAR_GLO_IFB;
 
             trace(3,"%s sat=%2d %s%d res=%9.4f sig=%9.4f el=%4.1f\n",str,sat,
@@ -1183,11 +1232,13 @@ extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
     double *rs,*dts,*var,*v,*H,*R,*azel,*xp,*Pp,dr[3]={0},std[3];
     char str[32];
     int i,j,nv,info,svh[MAXOBS],exc[MAXOBS]={0},stat=SOLQ_SINGLE;
+    int mark=wspmark(&rtk->ws);
 
     time2str(obs[0].time,str,2);
     trace(3,"pppos   : time=%s nx=%d n=%d\n",str,rtk->nx,n);
 
-    rs=mat(6,n); dts=mat(2,n); var=mat(1,n); azel=zeros(2,n);
+    rs=wspmat(&rtk->ws,6,n); dts=wspmat(&rtk->ws,2,n);
+    var=wspmat(&rtk->ws,1,n); azel=wspzeros(&rtk->ws,2,n);
 
     for (i=0;i<MAXSAT;i++) for (j=0;j<opt->nf;j++) rtk->ssat[i].fix[j]=0;
     for (i=0;i<n&&i<MAXOBS;i++) for (j=0;j<opt->nf;j++) {
@@ -1211,8 +1262,9 @@ extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
                  opt->odisp[0],dr);
     }
     nv=n*rtk->opt.nf*2+MAXSAT+3;
-    xp=mat(rtk->nx,1); Pp=zeros(rtk->nx,rtk->nx);
-    v=mat(nv,1); H=mat(rtk->nx,nv); R=mat(nv,nv);
+    xp=wspmat(&rtk->ws,rtk->nx,1); Pp=wspzeros(&rtk->ws,rtk->nx,rtk->nx);
+    v=wspmat(&rtk->ws,nv,1); H=wspmat(&rtk->ws,rtk->nx,nv);
+    R=wspmat(&rtk->ws,nv,nv);
 
     for (i=0;i<MAX_ITER;i++) {
 
@@ -1225,7 +1277,9 @@ extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
             break;
         }
         /* measurement update of ekf states */
-        if ((info=filter(xp,Pp,H,v,R,rtk->nx,nv))) {
+        if (opt->seqfilter) info=filterseq(xp,Pp,H,v,R,rtk->nx,nv,&rtk->ws);
+        else info=filterw(xp,Pp,H,v,R,rtk->nx,nv,&rtk->ws);
+        if (info) {
             trace(2,"%s ppp (%d) filter error info=%d\n",str,i+1,info);
             break;
         }
@@ -1264,6 +1318,5 @@ extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
             rtk->nfix=0;
         }
     }
-    free(rs); free(dts); free(var); free(azel);
-    free(xp); free(Pp); free(v); free(H); free(R);
+    wsprelease(&rtk->ws,mark);
 }
@@ -54,49 +54,13 @@
 #define SQR(x)      ((x)*(x))
 
 #define NMAX        10              /* order of polynomial interpolation */
+#define NCOEF       (NMAX+1)        /* number of chebyshev coefficients */
+#define NPSTRM      (NMAX+1)        /* stream epochs kept before/after time */
 #define MAXDTE      900.0           /* max time difference to ephem time (s) */
 #define EXTERR_CLK  1E-3            /* extrapolation error for clock (m/s) */
 #define EXTERR_EPH  5E-7            /* extrapolation error for ephem (m/s^2) */
 #define MAX_BIAS_SYS 4              /* # of constellations supported */
 
-/* table to translate code to code bias table index  */
-static int8_t code_bias_ix[MAX_BIAS_SYS][MAXCODE];
-/* initialize code bias lookup table -------------------------------------------
-*       -1 = code not supported
-*        0 = reference code (0 bias)
-*        1-3 = table index for code
-* ----------------------------------------------------------------------------*/
-static void init_bias_ix(void) {
-    int i,j;
-
-    for (i=0;i<MAX_BIAS_SYS;i++) for (j=0;j<MAXCODE;j++)
-        code_bias_ix[i][j]=-1;
-
-    /* GPS */
-    code_bias_ix[0][CODE_L1W]=0;
-    code_bias_ix[0][CODE_L1C]=1;
-    code_bias_ix[0][CODE_L1L]=2;
-    code_bias_ix[0][CODE_L1X]=3;
-    code_bias_ix[0][CODE_L2W]=0;
-    code_bias_ix[0][CODE_L2L]=1;
-    code_bias_ix[0][CODE_L2S]=2;
-    code_bias_ix[0][CODE_L2X]=3;
-    /* GLONASS */
-    code_bias_ix[1][CODE_L1P]=0;
-    code_bias_ix[1][CODE_L1C]=1;
-    code_bias_ix[1][CODE_L2P]=0;
-    code_bias_ix[1][CODE_L2C]=1;
-    /* Galileo */
-    code_bias_ix[2][CODE_L1C]=0;
-    code_bias_ix[2][CODE_L1X]=1;
-    code_bias_ix[2][CODE_L5Q]=0;
-    code_bias_ix[2][CODE_L5I]=1;
-    code_bias_ix[2][CODE_L5X]=2;
-    /* Beidou */
-    code_bias_ix[3][CODE_L2I]=0;
-    code_bias_ix[3][CODE_L6I]=0;
-}
-
 /* satellite code to satellite system ----------------------------------------*/
 static int code2sys(char code)
 {
@@ -167,90 +131,149 @@ static int addpeph(nav_t *nav, peph_t *peph)
     nav->peph[nav->ne++]=*peph;
     return 1;
 }
-/* read SP3 body -------------------------------------------------------------*/
-static void readsp3b(FILE *fp, char type, int *sats, int ns, double *bfact,
-                     char *tsys, int index, int opt, nav_t *nav)
+/* extend compact precise ephemeris -----------------------------------------*/
+static int extpephs(pephs_t *ps)
+{
+    gtime_t *time;
+    double *pos;
+    float *std;
+    int *index,i,nemax=ps->nemax+256;
+
+    if (!(time=(gtime_t *)realloc(ps->time,sizeof(gtime_t)*nemax))) return 0;
+    ps->time=time;
+    if (!(index=(int *)realloc(ps->index,sizeof(int)*nemax))) return 0;
+    ps->index=index;
+
+    for (i=0;i<MAXSAT;i++) {
+        if (!ps->pos[i]) continue;
+        if (!(pos=(double *)realloc(ps->pos[i],sizeof(double)*4*nemax))) return 0;
+        ps->pos[i]=pos;
+        if (!(std=(float *)realloc(ps->std[i],sizeof(float)*4*nemax))) return 0;
+        ps->std[i]=std;
+    }
+    ps->nemax=nemax;
+    return 1;
+}
+/* add precise ephemeris to compact storage ----------------------------------*/
+static int addpephs(nav_t *nav, const peph_t *peph)
+{
+    pephs_t *ps=&nav->pephs;
+    int i,j;
+
+    if (ps->ne>=ps->nemax&&!extpephs(ps)) {
+        trace(1,"readsp3b malloc error n=%d\n",ps->nemax);
+        freepephs(nav);
+        return 0;
+    }
+    for (i=0;i<MAXSAT;i++) {
+        if (!ps->pos[i]) {
+            if (norm(peph->pos[i],4)<=0.0) continue;
+            if (!(ps->pos[i]=(double *)calloc(4*ps->nemax,sizeof(double)))||
+                !(ps->std[i]=(float *)calloc(4*ps->nemax,sizeof(float)))) {
+                trace(1,"readsp3b malloc error n=%d\n",ps->nemax);
+                freepephs(nav);
+                return 0;
+            }
+        }
+        for (j=0;j<4;j++) {
+            ps->pos[i][ps->ne*4+j]=peph->pos[i][j];
+            ps->std[i][ps->ne*4+j]=peph->std[i][j];
+        }
+    }
+    ps->time [ps->ne]=peph->time;
+    ps->index[ps->ne++]=peph->index;
+    return 1;
+}
+/* read SP3 epoch ------------------------------------------------------------*/
+static int readsp3e(FILE *fp, char type, int ns, const double *bfact,
+                    const char *tsys, int index, int opt, peph_t *peph)
 {
-    peph_t peph;
     gtime_t time;
     double val,std,base;
     int i,j,sat,sys,prn,n=ns*(type=='P'?1:2),pred_o,pred_c,v;
     char buff[1024];
 
-    trace(3,"readsp3b: type=%c ns=%d index=%d opt=%d\n",type,ns,index,opt);
+    for (;;) {
+        if (!fgets(buff,sizeof(buff),fp)||!strncmp(buff,"EOF",3)) return -1;
 
-    while (fgets(buff,sizeof(buff),fp)) {
+        if (buff[0]=='*'&&!str2time(buff,3,28,&time)) break;
 
-        if (!strncmp(buff,"EOF",3)) break;
+        trace(2,"sp3 invalid epoch %31.31s\n",buff);
+    }
+    if (!strcmp(tsys,"UTC")) time=utc2gpst(time); /* utc->gpst */
+    peph->time =time;
+    peph->index=index;
 
-        if (buff[0]!='*'||str2time(buff,3,28,&time)) {
-            trace(2,"sp3 invalid epoch %31.31s\n",buff);
-            continue;
+    for (i=0;i<MAXSAT;i++) {
+        for (j=0;j<4;j++) {
+            peph->pos[i][j]=0.0;
+            peph->std[i][j]=0.0f;
+            peph->vel[i][j]=0.0;
+            peph->vst[i][j]=0.0f;
         }
-        if (!strcmp(tsys,"UTC")) time=utc2gpst(time); /* utc->gpst */
-        peph.time =time;
-        peph.index=index;
-
-        for (i=0;i<MAXSAT;i++) {
-            for (j=0;j<4;j++) {
-                peph.pos[i][j]=0.0;
-                peph.std[i][j]=0.0f;
-                peph.vel[i][j]=0.0;
-                peph.vst[i][j]=0.0f;
-            }
-            for (j=0;j<3;j++) {
-                peph.cov[i][j]=0.0f;
-                peph.vco[i][j]=0.0f;
-            }
+        for (j=0;j<3;j++) {
+            peph->cov[i][j]=0.0f;
+            peph->vco[i][j]=0.0f;
         }
-        for (i=pred_o=pred_c=v=0;i<n&&fgets(buff,sizeof(buff),fp);i++) {
+    }
+    for (i=pred_o=pred_c=v=0;i<n&&fgets(buff,sizeof(buff),fp);i++) {
 
-            if (strlen(buff)<4||(buff[0]!='P'&&buff[0]!='V')) continue;
+        if (strlen(buff)<4||(buff[0]!='P'&&buff[0]!='V')) continue;
+
+        sys=buff[1]==' '?SYS_GPS:code2sys(buff[1]);
+        prn=(int)str2num(buff,2,2);
+        if      (sys==SYS_SBS) prn+=100;
+        else if (sys==SYS_QZS) prn+=192; /* extension to sp3-c */
+
+        if (!(sat=satno(sys,prn))) continue;
+
+        if (buff[0]=='P') {
+            pred_c=strlen(buff)>=76&&buff[75]=='P';
+            pred_o=strlen(buff)>=80&&buff[79]=='P';
+        }
+        for (j=0;j<4;j++) {
 
-            sys=buff[1]==' '?SYS_GPS:code2sys(buff[1]);
-            prn=(int)str2num(buff,2,2);
-            if      (sys==SYS_SBS) prn+=100;
-            else if (sys==SYS_QZS) prn+=192; /* extension to sp3-c */
+            /* read option for predicted value */
+            if (j< 3&&(opt&1)&& pred_o) continue;
+            if (j< 3&&(opt&2)&&!pred_o) continue;
+            if (j==3&&(opt&1)&& pred_c) continue;
+            if (j==3&&(opt&2)&&!pred_c) continue;
 
-            if (!(sat=satno(sys,prn))) continue;
+            val=str2num(buff, 4+j*14,14);
+            std=str2num(buff,61+j* 3,j<3?2:3);
 
-            if (buff[0]=='P') {
-                pred_c=strlen(buff)>=76&&buff[75]=='P';
-                pred_o=strlen(buff)>=80&&buff[79]=='P';
+            if (buff[0]=='P') { /* position */
+                if (val!=0.0&&fabs(val-999999.999999)>=1E-6) {
+                    peph->pos[sat-1][j]=val*(j<3?1000.0:1E-6);
+                    v=1; /* valid epoch */
+                }
+                if ((base=bfact[j<3?0:1])>0.0&&std>0.0) {
+                    peph->std[sat-1][j]=(float)(pow(base,std)*(j<3?1E-3:1E-12));
+                }
             }
-            for (j=0;j<4;j++) {
-
-                /* read option for predicted value */
-                if (j< 3&&(opt&1)&& pred_o) continue;
-                if (j< 3&&(opt&2)&&!pred_o) continue;
-                if (j==3&&(opt&1)&& pred_c) continue;
-                if (j==3&&(opt&2)&&!pred_c) continue;
-
-                val=str2num(buff, 4+j*14,14);
-                std=str2num(buff,61+j* 3,j<3?2:3);
-
-                if (buff[0]=='P') { /* position */
-                    if (val!=0.0&&fabs(val-999999.999999)>=1E-6) {
-                        peph.pos[sat-1][j]=val*(j<3?1000.0:1E-6);
-                        v=1; /* valid epoch */
-                    }
-                    if ((base=bfact[j<3?0:1])>0.0&&std>0.0) {
-                        peph.std[sat-1][j]=(float)(pow(base,std)*(j<3?1E-3:1E-12));
-                    }
+            else if (v) { /* velocity */
+                if (val!=0.0&&fabs(val-999999.999999)>=1E-6) {
+                    peph->vel[sat-1][j]=val*(j<3?0.1:1E-10);
                 }
-                else if (v) { /* velocity */
-                    if (val!=0.0&&fabs(val-999999.999999)>=1E-6) {
-                        peph.vel[sat-1][j]=val*(j<3?0.1:1E-10);
-                    }
-                    if ((base=bfact[j<3?0:1])>0.0&&std>0.0) {
-                        peph.vst[sat-1][j]=(float)(pow(base,std)*(j<3?1E-7:1E-16));
-                    }
+                if ((base=bfact[j<3?0:1])>0.0&&std>0.0) {
+                    peph->vst[sat-1][j]=(float)(pow(base,std)*(j<3?1E-7:1E-16));
                 }
             }
         }
-        if (v) {
-            if (!addpeph(nav,&peph)) return;
-        }
+    }
+    return v;
+}
+/* read SP3 body -------------------------------------------------------------*/
+static void readsp3b(FILE *fp, char type, int *sats, int ns, double *bfact,
+                     char *tsys, int index, int opt, nav_t *nav)
+{
+    peph_t peph;
+    int stat;
+
+    trace(3,"readsp3b: type=%c ns=%d index=%d opt=%d\n",type,ns,index,opt);
+
+    while ((stat=readsp3e(fp,type,ns,bfact,tsys,index,opt,&peph))>=0) {
+        if (stat&&!(opt&16?addpephs(nav,&peph):addpeph(nav,&peph))) return;
     }
 }
 /* compare precise ephemeris -------------------------------------------------*/
@@ -289,19 +312,143 @@ static void combpeph(nav_t *nav, int opt)
 
     trace(4,"combpeph: ne=%d\n",nav->ne);
 }
+/* compare compact precise ephemeris -----------------------------------------*/
+typedef struct {        /* compact precise ephemeris entry type */
+    gtime_t time;       /* time (GPST) */
+    int index;          /* ephemeris index for multiple files */
+    int i;              /* epoch in storage */
+} pephent_t;
+
+static int cmppephs(const void *p1, const void *p2)
+{
+    pephent_t *q1=(pephent_t *)p1,*q2=(pephent_t *)p2;
+    double tt=timediff(q1->time,q2->time);
+    if (tt<-1E-9) return -1;
+    if (tt> 1E-9) return  1;
+    if (q1->index!=q2->index) return q1->index-q2->index;
+    return q1->i-q2->i;
+}
+/* combine compact precise ephemeris -------------------------------------------
+* same as combpeph() for precise ephemeris in compact storage. the epochs are
+* sorted by an index and the storage is rebuilt in the order.
+*-----------------------------------------------------------------------------*/
+static void combpephs(nav_t *nav, int opt)
+{
+    pephs_t *ps=&nav->pephs;
+    pephent_t *ent;
+    gtime_t *time;
+    double *pos,*p;
+    float *std;
+    int *index,i,j,k,m,n;
+
+    trace(3,"combpephs: ne=%d\n",ps->ne);
+
+    if (!(ent=(pephent_t *)malloc(sizeof(pephent_t)*ps->ne))) {
+        trace(1,"combpephs: malloc error ne=%d\n",ps->ne);
+        return;
+    }
+    for (i=0;i<ps->ne;i++) {
+        ent[i].time=ps->time[i]; ent[i].index=ps->index[i]; ent[i].i=i;
+    }
+    qsort(ent,ps->ne,sizeof(pephent_t),cmppephs);
+
+    /* combine epochs of same time to first of them */
+    for (i=0,j=1,n=1;j<ps->ne&&!(opt&4);j++) {
+
+        if (fabs(timediff(ent[i].time,ent[j].time))<1E-9) {
+
+            for (k=0;k<MAXSAT;k++) {
+                if (!ps->pos[k]||norm(p=ps->pos[k]+ent[j].i*4,4)<=0.0) continue;
+                for (m=0;m<4;m++) ps->pos[k][ent[i].i*4+m]=p[m];
+                for (m=0;m<4;m++) ps->std[k][ent[i].i*4+m]=ps->std[k][ent[j].i*4+m];
+            }
+        }
+        else if (++i<j) ent[i]=ent[j];
+        n=i+1;
+    }
+    if (opt&4) n=ps->ne;
+
+    /* rebuild storage in sorted order */
+    if (!(time=(gtime_t *)malloc(sizeof(gtime_t)*n))||
+        !(index=(int *)malloc(sizeof(int)*n))) {
+        trace(1,"combpephs: malloc error ne=%d\n",n);
+        free(time); free(ent);
+        return;
+    }
+    for (i=0;i<n;i++) {
+        time[i]=ps->time[ent[i].i]; index[i]=ps->index[ent[i].i];
+    }
+    free(ps->time ); ps->time =time;
+    free(ps->index); ps->index=index;
+
+    for (k=0;k<MAXSAT;k++) {
+        if (!ps->pos[k]) continue;
+        if (!(pos=(double *)malloc(sizeof(double)*4*n))||
+            !(std=(float *)malloc(sizeof(float)*4*n))) {
+            trace(1,"combpephs: malloc error ne=%d\n",n);
+            free(pos); free(ent);
+            freepephs(nav);
+            return;
+        }
+        for (i=0;i<n;i++) for (m=0;m<4;m++) {
+            pos[i*4+m]=ps->pos[k][ent[i].i*4+m];
+            std[i*4+m]=ps->std[k][ent[i].i*4+m];
+        }
+        free(ps->pos[k]); ps->pos[k]=pos;
+        free(ps->std[k]); ps->std[k]=std;
+    }
+    ps->ne=ps->nemax=n;
+    free(ent);
+
+    trace(4,"combpephs: ne=%d\n",ps->ne);
+}
+/* precise ephemeris in full or compact storage ------------------------------*/
+static int pephn(const nav_t *nav)
+{
+    return nav->pephs.ne>0?nav->pephs.ne:nav->ne;
+}
+static const void *pephdata(const nav_t *nav)
+{
+    return nav->pephs.ne>0?(const void *)nav->pephs.time:(const void *)nav->peph;
+}
+static gtime_t pepht(const nav_t *nav, int i)
+{
+    return nav->pephs.ne>0?nav->pephs.time[i]:nav->peph[i].time;
+}
+static const double *pephp(const nav_t *nav, int i, int sat)
+{
+    static const double zero[4]={0};
+
+    if (nav->pephs.ne<=0) return nav->peph[i].pos[sat-1];
+    return nav->pephs.pos[sat-1]?nav->pephs.pos[sat-1]+i*4:zero;
+}
+static const float *pephsd(const nav_t *nav, int i, int sat)
+{
+    static const float zero[4]={0};
+
+    if (nav->pephs.ne<=0) return nav->peph[i].std[sat-1];
+    return nav->pephs.std[sat-1]?nav->pephs.std[sat-1]+i*4:zero;
+}
 /* read sp3 precise ephemeris file ---------------------------------------------
 * read sp3 precise ephemeris/clock files and set them to navigation data
 * args   : char   *file       I   sp3-c precise ephemeris file
 *                                 (wind-card * is expanded)
 *          nav_t  *nav        IO  navigation data
 *          int    opt         I   options (1: only observed + 2: only predicted +
-*                                 4: not combined)
+*                                 4: not combined + 8: chebyshev coefficients +
+*                                 16: compact storage)
 * return : none
 * notes  : see ref [1]
 *          precise ephemeris is appended and combined
 *          nav->peph and nav->ne must by properly initialized before calling the
 *          function
 *          only files with extensions of .sp3, .SP3, .eph* and .EPH* are read
+*          with opt&8, interpolation coefficients are fitted by pephcoef()
+*          with opt&16, precise ephemeris is stored to nav->pephs instead of
+*          nav->peph. only positions/clocks and their std of the satellites in
+*          the files are stored (no velocities and covariances). peph2pos()
+*          uses nav->pephs if it contains precise ephemeris. free it by
+*          freepephs().
 *-----------------------------------------------------------------------------*/
 extern void readsp3(const char *file, nav_t *nav, int opt)
 {
@@ -313,6 +460,9 @@ extern void readsp3(const char *file, nav_t *nav, int opt)
 
     trace(3,"readpephs: file=%s\n",file);
 
+    /* coefficients of previous precise ephemeris */
+    if (nav->pephc.peph) freepephc(nav);
+
     for (i=0;i<MAXEXFILE;i++) {
         if (!(efiles[i]=(char *)malloc(1024))) {
             for (i--;i>=0;i--) free(efiles[i]);
@@ -343,7 +493,123 @@ extern void readsp3(const char *file, nav_t *nav, int opt)
     for (i=0;i<MAXEXFILE;i++) free(efiles[i]);
 
     /* combine precise ephemeris */
-    if (nav->ne>0) combpeph(nav,opt);
+    if (opt&16) {
+        if (nav->pephs.ne>0) combpephs(nav,opt);
+    }
+    else if (nav->ne>0) combpeph(nav,opt);
+
+    /* chebyshev coefficients of precise ephemeris */
+    if (opt&8) pephcoef(nav);
+}
+/* chebyshev polynomials ----------------------------------------------------*/
+static void chebpoly(double x, double *T, int n)
+{
+    int i;
+
+    T[0]=1.0; if (n>1) T[1]=x;
+    for (i=2;i<n;i++) T[i]=2.0*x*T[i-1]-T[i-2];
+}
+/* chebyshev series by clenshaw's recurrence ---------------------------------*/
+static double chebval(const double *c, int n, double x)
+{
+    double b1=0.0,b2=0.0,b;
+    int i;
+
+    for (i=n-1;i>=1;i--) {
+        b=c[i]+2.0*x*b1-b2; b2=b1; b1=b;
+    }
+    return c[0]+x*b1-b2;
+}
+/* test precise ephemeris valid for interpolation window ---------------------*/
+static int pephvalid(const nav_t *nav, int w, int sat)
+{
+    int j;
+
+    for (j=0;j<=NMAX;j++) {
+        if (norm(pephp(nav,w+j,sat),3)<=0.0) return 0;
+    }
+    return 1;
+}
+/* fit chebyshev coefficients of precise ephemeris -----------------------------
+* fit chebyshev coefficients of the orbit interpolation of precise ephemeris
+* args   : nav_t  *nav        IO  navigation data
+* return : status (1:ok,0:no precise ephemeris or error)
+* notes  : for each window of NMAX+1 precise ephemerides used by the polynomial
+*          interpolation, coefficients of the polynomial through the positions
+*          in the inertial frame at the window center are fitted for each
+*          satellite. peph2pos() evaluates the series and rotates it to ecef
+*          instead of the interpolation by Neville's algorithm. the result
+*          equals the interpolation within rounding errors.
+*          the coefficients are set to nav->pephc and used while the precise
+*          ephemeris is unchanged. free them by freepephc().
+*-----------------------------------------------------------------------------*/
+extern int pephcoef(nav_t *nav)
+{
+    pephc_t *pc=&nav->pephc;
+    const double *pos;
+    double *V,*q,*c,T[NCOEF],t,sinl,cosl;
+    int j,k,w,sat,n,nc=0,ne=pephn(nav);
+
+    trace(3,"pephcoef: ne=%d\n",ne);
+
+    freepephc(nav);
+
+    if (ne<NMAX+1) return 0;
+
+    n=ne-NMAX;
+
+    for (w=0;w<n;w++) for (sat=1;sat<=MAXSAT;sat++) {
+        if (pephvalid(nav,w,sat)) nc++;
+    }
+    if (!(pc->tc=(gtime_t *)malloc(sizeof(gtime_t)*n))||
+        !(pc->tw=(double *)malloc(sizeof(double)*n))||
+        !(pc->off=(int *)malloc(sizeof(int)*n*MAXSAT))||
+        !(pc->coef=(double *)malloc(sizeof(double)*(nc>0?nc:1)*3*NCOEF))) {
+        trace(1,"pephcoef: malloc error n=%d nc=%d\n",n,nc);
+        freepephc(nav);
+        return 0;
+    }
+    V=mat(NCOEF,NCOEF); q=mat(NCOEF,3);
+
+    for (w=nc=0;w<n;w++) {
+        pc->tw[w]=timediff(pepht(nav,w+NMAX),pepht(nav,w))/2.0;
+        pc->tc[w]=timeadd(pepht(nav,w),pc->tw[w]);
+
+        /* inverse of chebyshev series at precise ephemeris times */
+        for (j=0;j<=NMAX;j++) {
+            t=pc->tw[w]>0.0?timediff(pepht(nav,w+j),pc->tc[w])/pc->tw[w]:0.0;
+            chebpoly(t,T,NCOEF);
+            for (k=0;k<NCOEF;k++) V[j+k*NCOEF]=T[k];
+        }
+        for (sat=1;sat<=MAXSAT;sat++) pc->off[w*MAXSAT+sat-1]=-1;
+
+        if (pc->tw[w]<=0.0||matinv(V,NCOEF)) {
+            trace(2,"pephcoef: fit error %s\n",time_str(pc->tc[w],0));
+            continue;
+        }
+        for (sat=1;sat<=MAXSAT;sat++) {
+            if (!pephvalid(nav,w,sat)) continue;
+
+            /* positions in inertial frame at window center */
+            for (j=0;j<=NMAX;j++) {
+                pos=pephp(nav,w+j,sat);
+                t=timediff(pepht(nav,w+j),pc->tc[w]);
+                sinl=sin(OMGE*t);
+                cosl=cos(OMGE*t);
+                q[j          ]=cosl*pos[0]-sinl*pos[1];
+                q[j+NCOEF    ]=sinl*pos[0]+cosl*pos[1];
+                q[j+NCOEF*2  ]=pos[2];
+            }
+            c=pc->coef+nc*3*NCOEF;
+            matmul("NN",NCOEF,3,NCOEF,V,q,c);
+            pc->off[w*MAXSAT+sat-1]=nc++*3*NCOEF;
+        }
+    }
+    free(V); free(q);
+    pc->peph=pephdata(nav); pc->ne=ne; pc->n=n;
+
+    trace(4,"pephcoef: n=%d nc=%d\n",n,nc);
+    return 1;
 }
 /* read satellite antenna parameters -------------------------------------------
 * read satellite antenna parameters
@@ -431,15 +697,42 @@ static int sys2ix(int sys)
 *       -1 = code not supported
 *        0 = reference code (0 bias)
 *        1-3 = table index for code
+* notes: lookup is table-free so that it needs no initialization and is safe
+*        to call from concurrent processing sessions
 * ----------------------------------------------------------------------------*/
 extern int code2bias_ix(int sys, int code) {
     int sys_ix;
 
     sys_ix=sys2ix(sys);
-    if (sys_ix<MAX_BIAS_SYS)
-        return code_bias_ix[sys_ix][code];
-    else
-        return 0;
+    if (sys_ix>=MAX_BIAS_SYS) return 0;
+
+    switch (sys_ix) {
+        case 0: /* GPS */
+            switch (code) {
+                case CODE_L1W: case CODE_L2W: return 0;
+                case CODE_L1C: case CODE_L2L: return 1;
+                case CODE_L1L: case CODE_L2S: return 2;
+                case CODE_L1X: case CODE_L2X: return 3;
+            }
+            break;
+        case 1: /* GLONASS */
+            switch (code) {
+                case CODE_L1P: case CODE_L2P: return 0;
+                case CODE_L1C: case CODE_L2C: return 1;
+            }
+            break;
+        case 2: /* Galileo */
+            switch (code) {
+                case CODE_L1C: case CODE_L5Q: return 0;
+                case CODE_L1X: case CODE_L5I: return 1;
+                case CODE_L5X: return 2;
+            }
+            break;
+        case 3: /* Beidou */
+            if (code==CODE_L2I||code==CODE_L6I) return 0;
+            break;
+    }
+    return -1;
 }
 /* read DCB parameters from BIA or BSX file ------------------------------------
 *    - supports satellite code biases only
@@ -516,8 +809,6 @@ extern int readdcb(const char *file, nav_t *nav, const sta_t *sta)
 
     trace(3,"readdcb : file=%s\n",file);
 
-    init_bias_ix(); /* init translation table from code to table column */
-
     for (i=0;i<MAXSAT;i++) for (j=0;j<MAX_CODE_BIAS_FREQS;j++) for (k=0;k<MAX_CODE_BIASES;k++) {
         nav->cbias[i][j][k]=0.0;
     }
@@ -552,55 +843,111 @@ static double interppol(const double *x, double *y, int n)
     }
     return y[0];
 }
+/* search precise ephemeris or clock by time ----------------------------------
+* index of last data before time in data sorted by time, limited to 0 to n-2
+* for the interpolation with the next data. the search starts at the index estimated by the mean data interval and
+* gives the same index as binary search. time must be the first member of the
+* data type (peph_t or pclk_t).
+*-----------------------------------------------------------------------------*/
+static gtime_t timeof(const void *data, size_t size, int i)
+{
+    return *(const gtime_t *)((const char *)data+size*i);
+}
+static int srchtime(const void *data, size_t size, int n, gtime_t time)
+{
+    double tt,x;
+    int i=0;
+
+    if ((tt=timediff(timeof(data,size,n-1),timeof(data,size,0)))>0.0) {
+        x=timediff(time,timeof(data,size,0))/tt*(n-1);
+        i=x<=0.0?0:(x>=n-2?n-2:(int)x);
+    }
+    while (i<n-2&&timediff(timeof(data,size,i+1),time)<0.0) i++;
+    while (i>0&&timediff(timeof(data,size,i),time)>=0.0) i--;
+    return i;
+}
+/* satellite position by chebyshev coefficients ------------------------------*/
+static int pephcpos(gtime_t time, int sat, const nav_t *nav, int w, double *rs)
+{
+    const pephc_t *pc=&nav->pephc;
+    const double *c;
+    double tau,x,q[3],sinl,cosl;
+    int i;
+
+    if (pc->off[w*MAXSAT+sat-1]<0) return 0;
+
+    c=pc->coef+pc->off[w*MAXSAT+sat-1];
+    tau=timediff(time,pc->tc[w]);
+    x=tau/pc->tw[w];
+    for (i=0;i<3;i++) q[i]=chebval(c+i*NCOEF,NCOEF,x);
+
+    /* inertial frame at window center to ecef at time */
+    sinl=sin(OMGE*tau);
+    cosl=cos(OMGE*tau);
+    rs[0]= cosl*q[0]+sinl*q[1];
+    rs[1]=-sinl*q[0]+cosl*q[1];
+    rs[2]=q[2];
+    return 1;
+}
 /* satellite position by precise ephemeris -----------------------------------*/
 static int pephpos(gtime_t time, int sat, const nav_t *nav, double *rs,
                    double *dts, double *vare, double *varc)
 {
-    double t[NMAX+1],p[3][NMAX+1],c[2],*pos,std=0.0,s[3],sinl,cosl;
-    int i,j,k,index;
+    const double *pos;
+    double t[NMAX+1],p[3][NMAX+1],c[2],std=0.0,s[3],sinl,cosl;
+    int i,j,index,ne=pephn(nav);
 
     trace(4,"pephpos : time=%s sat=%2d\n",time_str(time,3),sat);
 
     rs[0]=rs[1]=rs[2]=dts[0]=0.0;
 
-    if (nav->ne<NMAX+1||
-        timediff(time,nav->peph[0].time)<-MAXDTE||
-        timediff(time,nav->peph[nav->ne-1].time)>MAXDTE) {
+    if (ne<NMAX+1||
+        timediff(time,pepht(nav,0))<-MAXDTE||
+        timediff(time,pepht(nav,ne-1))>MAXDTE) {
         trace(3,"no prec ephem %s sat=%2d\n",time_str(time,0),sat);
         return 0;
     }
-    /* binary search */
-    for (i=0,j=nav->ne-1;i<j;) {
-        k=(i+j)/2;
-        if (timediff(nav->peph[k].time,time)<0.0) i=k+1; else j=k;
+    if (nav->pephs.ne>0) {
+        index=srchtime(nav->pephs.time,sizeof(gtime_t),ne,time);
+    }
+    else {
+        index=srchtime(nav->peph,sizeof(peph_t),ne,time);
     }
-    index=i<=0?0:i-1;
-
     /* polynomial interpolation for orbit */
     i=index-(NMAX+1)/2;
-    if (i<0) i=0; else if (i+NMAX>=nav->ne) i=nav->ne-NMAX-1;
+    if (i<0) i=0; else if (i+NMAX>=ne) i=ne-NMAX-1;
 
-    for (j=0;j<=NMAX;j++) {
-        t[j]=timediff(nav->peph[i+j].time,time);
-        if (norm(nav->peph[i+j].pos[sat-1],3)<=0.0) {
+    if (nav->pephc.peph==pephdata(nav)&&nav->pephc.ne==ne) {
+        if (!pephcpos(time,sat,nav,i,rs)) {
             trace(3,"prec ephem outage %s sat=%2d\n",time_str(time,0),sat);
             return 0;
         }
+        t[0   ]=timediff(pepht(nav,i     ),time);
+        t[NMAX]=timediff(pepht(nav,i+NMAX),time);
     }
-    for (j=0;j<=NMAX;j++) {
-        pos=nav->peph[i+j].pos[sat-1];
-        /* correction for earth rotation ver.2.4.0 */
-        sinl=sin(OMGE*t[j]);
-        cosl=cos(OMGE*t[j]);
-        p[0][j]=cosl*pos[0]-sinl*pos[1];
-        p[1][j]=sinl*pos[0]+cosl*pos[1];
-        p[2][j]=pos[2];
-    }
-    for (i=0;i<3;i++) {
-        rs[i]=interppol(t,p[i],NMAX+1);
+    else {
+        for (j=0;j<=NMAX;j++) {
+            t[j]=timediff(pepht(nav,i+j),time);
+            if (norm(pephp(nav,i+j,sat),3)<=0.0) {
+                trace(3,"prec ephem outage %s sat=%2d\n",time_str(time,0),sat);
+                return 0;
+            }
+        }
+        for (j=0;j<=NMAX;j++) {
+            pos=pephp(nav,i+j,sat);
+            /* correction for earth rotation ver.2.4.0 */
+            sinl=sin(OMGE*t[j]);
+            cosl=cos(OMGE*t[j]);
+            p[0][j]=cosl*pos[0]-sinl*pos[1];
+            p[1][j]=sinl*pos[0]+cosl*pos[1];
+            p[2][j]=pos[2];
+        }
+        for (i=0;i<3;i++) {
+            rs[i]=interppol(t,p[i],NMAX+1);
+        }
     }
     if (vare) {
-        for (i=0;i<3;i++) s[i]=nav->peph[index].std[sat-1][i];
+        for (i=0;i<3;i++) s[i]=pephsd(nav,index,sat)[i];
         std=norm(s,3);
 
         /* extrapolation error for orbit */
@@ -609,25 +956,25 @@ static int pephpos(gtime_t time, int sat, const nav_t *nav, double *rs,
         *vare=SQR(std);
     }
     /* linear interpolation for clock */
-    t[0]=timediff(time,nav->peph[index  ].time);
-    t[1]=timediff(time,nav->peph[index+1].time);
-    c[0]=nav->peph[index  ].pos[sat-1][3];
-    c[1]=nav->peph[index+1].pos[sat-1][3];
+    t[0]=timediff(time,pepht(nav,index  ));
+    t[1]=timediff(time,pepht(nav,index+1));
+    c[0]=pephp(nav,index  ,sat)[3];
+    c[1]=pephp(nav,index+1,sat)[3];
 
     if (t[0]<=0.0) {
         if ((dts[0]=c[0])!=0.0) {
-            std=nav->peph[index].std[sat-1][3]*CLIGHT-EXTERR_CLK*t[0];
+            std=pephsd(nav,index,sat)[3]*CLIGHT-EXTERR_CLK*t[0];
         }
     }
     else if (t[1]>=0.0) {
         if ((dts[0]=c[1])!=0.0) {
-            std=nav->peph[index+1].std[sat-1][3]*CLIGHT+EXTERR_CLK*t[1];
+            std=pephsd(nav,index+1,sat)[3]*CLIGHT+EXTERR_CLK*t[1];
         }
     }
     else if (c[0]!=0.0&&c[1]!=0.0) {
         dts[0]=(c[1]*t[0]-c[0]*t[1])/(t[0]-t[1]);
         i=t[0]<-t[1]?0:1;
-        std=nav->peph[index+i].std[sat-1][3]+EXTERR_CLK*fabs(t[i]);
+        std=pephsd(nav,index+i,sat)[3]+EXTERR_CLK*fabs(t[i]);
     }
     else {
         dts[0]=0.0;
@@ -640,7 +987,7 @@ static int pephclk(gtime_t time, int sat, const nav_t *nav, double *dts,
                    double *varc)
 {
     double t[2],c[2],std;
-    int i,j,k,index;
+    int i,index;
 
     trace(4,"pephclk : time=%s sat=%2d\n",time_str(time,3),sat);
 
@@ -650,12 +997,7 @@ static int pephclk(gtime_t time, int sat, const nav_t *nav, double *dts,
         trace(3,"no prec clock %s sat=%2d\n",time_str(time,0),sat);
         return 1;
     }
-    /* binary search */
-    for (i=0,j=nav->nc-1;i<j;) {
-        k=(i+j)/2;
-        if (timediff(nav->pclk[k].time,time)<0.0) i=k+1; else j=k;
-    }
-    index=i<=0?0:i-1;
+    index=srchtime(nav->pclk,sizeof(pclk_t),nav->nc,time);
 
     /* linear interpolation for clock */
     t[0]=timediff(time,nav->pclk[index  ].time);
@@ -815,3 +1157,336 @@ extern int peph2pos(gtime_t time, int sat, const nav_t *nav, int opt,
 
     return 1;
 }
+/* read next epoch of precise ephemeris/clock stream file --------------------*/
+static int readpstrmf(pstrmf_t *f)
+{
+    int i,stat;
+
+    if (f->type==0) { /* sp3 */
+        while (!(stat=readsp3e(f->fp,f->ftype,f->ns,f->bfact,f->tsys,f->index,
+                               f->opt,f->peph))) ;
+        return f->stat=stat>0;
+    }
+    /* rinex clock (records of an epoch are read until next epoch) */
+    if (!f->rsat&&!readrnxclkr(f->fp,f->ver,&f->rtime,&f->rsat,f->rdata)) {
+        f->rsat=0;
+        return f->stat=0;
+    }
+    f->pclk->time =f->rtime;
+    f->pclk->index=f->index;
+    for (i=0;i<MAXSAT;i++) {
+        f->pclk->clk[i][0]=0.0;
+        f->pclk->std[i][0]=0.0f;
+    }
+    do {
+        if (fabs(timediff(f->rtime,f->pclk->time))>1E-9) return f->stat=1;
+        f->pclk->clk[f->rsat-1][0]=f->rdata[0];
+        f->pclk->std[f->rsat-1][0]=(float)f->rdata[1];
+    } while (readrnxclkr(f->fp,f->ver,&f->rtime,&f->rsat,f->rdata));
+
+    f->rsat=0;
+    return f->stat=1;
+}
+/* open precise ephemeris/clock stream file ----------------------------------*/
+static int openpstrmf(pstrmf_t *f)
+{
+    gtime_t time;
+    int cstat,sats[MAXSAT]={0};
+    char *ext;
+
+    if ((ext=strrchr(f->file,'.'))&&
+        (strstr(ext,".sp3")||strstr(ext,".SP3")||
+         strstr(ext,".eph")||strstr(ext,".EPH"))) {
+        f->type=0;
+        if (!(f->fp=fopen(f->file,"r"))) {
+            trace(2,"sp3 file open error %s\n",f->file);
+            return 0;
+        }
+        f->ftype=' ';
+        f->ns=readsp3h(f->fp,&time,&f->ftype,sats,f->bfact,f->tsys);
+
+        if (!(f->peph=(peph_t *)malloc(sizeof(peph_t)))) return 0;
+    }
+    else {
+        f->type=1;
+        if ((cstat=rtk_uncompress(f->file,f->tmpfile))<0) {
+            trace(2,"rinex file uncompact error: %s\n",f->file);
+            return 0;
+        }
+        if (!cstat) f->tmpfile[0]='\0';
+
+        if (!(f->fp=fopen(cstat?f->tmpfile:f->file,"r"))) {
+            trace(2,"rinex file open error: %s\n",cstat?f->tmpfile:f->file);
+            return 0;
+        }
+        if (!readrnxclkh(f->fp,&f->ver)) return 0;
+
+        if (!(f->pclk=(pclk_t *)malloc(sizeof(pclk_t)))) return 0;
+    }
+    f->off=ftell(f->fp);
+    readpstrmf(f);
+    return 1;
+}
+/* close precise ephemeris/clock stream file ---------------------------------*/
+static void closepstrmf(pstrmf_t *f)
+{
+    if (f->fp) fclose(f->fp);
+    if (*f->tmpfile) remove(f->tmpfile);
+    free(f->peph);
+    free(f->pclk);
+    f->fp=NULL; f->tmpfile[0]='\0'; f->peph=NULL; f->pclk=NULL; f->stat=0;
+}
+/* time of pending epoch of stream file --------------------------------------*/
+static gtime_t pstrmft(const pstrmf_t *f)
+{
+    return f->type?f->pclk->time:f->peph->time;
+}
+/* window of precise ephemeris/clock -----------------------------------------*/
+static int winn(const nav_t *nav, int type)
+{
+    return type?nav->nc:nav->ne;
+}
+static gtime_t wint(const nav_t *nav, int type, int i)
+{
+    return type?nav->pclk[i].time:nav->peph[i].time;
+}
+/* insert precise ephemeris epoch to window ------------------------------------
+* insert a precise ephemeris epoch in time order. an epoch of same time is
+* combined as combpeph(): values of the higher index file precede.
+*-----------------------------------------------------------------------------*/
+static int inspeph(nav_t *nav, const peph_t *peph)
+{
+    peph_t *nav_peph,*p;
+    double tt;
+    int i,k,m,low;
+
+    for (i=nav->ne;i>0;i--) {
+        if ((tt=timediff(peph->time,nav->peph[i-1].time))>=1E-9) break;
+        if (tt<=-1E-9) continue;
+
+        /* combine epochs of same time */
+        p=nav->peph+i-1;
+        low=peph->index<p->index;
+        for (k=0;k<MAXSAT;k++) {
+            if (low?norm(p->pos[k],4)>0.0:norm(peph->pos[k],4)<=0.0) continue;
+            for (m=0;m<4;m++) p->pos[k][m]=peph->pos[k][m];
+            for (m=0;m<4;m++) p->std[k][m]=peph->std[k][m];
+            for (m=0;m<4;m++) p->vel[k][m]=peph->vel[k][m];
+            for (m=0;m<4;m++) p->vst[k][m]=peph->vst[k][m];
+        }
+        if (low) p->index=peph->index;
+        return 1;
+    }
+    if (nav->ne>=nav->nemax) {
+        nav->nemax+=NPSTRM;
+        if (!(nav_peph=(peph_t *)realloc(nav->peph,sizeof(peph_t)*nav->nemax))) {
+            trace(1,"inspeph malloc error n=%d\n",nav->nemax);
+            free(nav->peph); nav->peph=NULL; nav->ne=nav->nemax=0;
+            return 0;
+        }
+        nav->peph=nav_peph;
+    }
+    memmove(nav->peph+i+1,nav->peph+i,sizeof(peph_t)*(nav->ne-i));
+    nav->peph[i]=*peph;
+    nav->ne++;
+    return 1;
+}
+/* insert precise clock epoch to window ----------------------------------------
+* insert a precise clock epoch in time order. an epoch of same time is combined
+* as combpclk(): values of the higher index file precede.
+*-----------------------------------------------------------------------------*/
+static int inspclk(nav_t *nav, const pclk_t *pclk)
+{
+    pclk_t *nav_pclk,*p;
+    double tt;
+    int i,k,low;
+
+    for (i=nav->nc;i>0;i--) {
+        if ((tt=timediff(pclk->time,nav->pclk[i-1].time))>=1E-9) break;
+        if (tt<=-1E-9) continue;
+
+        /* combine epochs of same time */
+        p=nav->pclk+i-1;
+        low=pclk->index<p->index;
+        for (k=0;k<MAXSAT;k++) {
+            if (low?p->clk[k][0]!=0.0:pclk->clk[k][0]==0.0) continue;
+            p->clk[k][0]=pclk->clk[k][0];
+            p->std[k][0]=pclk->std[k][0];
+        }
+        if (low) p->index=pclk->index;
+        return 1;
+    }
+    if (nav->nc>=nav->ncmax) {
+        nav->ncmax+=NPSTRM;
+        if (!(nav_pclk=(pclk_t *)realloc(nav->pclk,sizeof(pclk_t)*nav->ncmax))) {
+            trace(1,"inspclk malloc error n=%d\n",nav->ncmax);
+            free(nav->pclk); nav->pclk=NULL; nav->nc=nav->ncmax=0;
+            return 0;
+        }
+        nav->pclk=nav_pclk;
+    }
+    memmove(nav->pclk+i+1,nav->pclk+i,sizeof(pclk_t)*(nav->nc-i));
+    nav->pclk[i]=*pclk;
+    nav->nc++;
+    return 1;
+}
+/* drop epochs before window -------------------------------------------------*/
+static int dropwin(nav_t *nav, int type, gtime_t time)
+{
+    int i,n=winn(nav,type);
+
+    for (i=0;i<n&&timediff(wint(nav,type,i),time)<=0.0;i++) ;
+
+    if ((i-=NPSTRM)<=0) return 0;
+
+    if (type) {
+        memmove(nav->pclk,nav->pclk+i,sizeof(pclk_t)*(n-i));
+        nav->nc-=i;
+    }
+    else {
+        memmove(nav->peph,nav->peph+i,sizeof(peph_t)*(n-i));
+        nav->ne-=i;
+    }
+    return 1;
+}
+/* open precise ephemeris/clock stream -----------------------------------------
+* open sp3 precise ephemeris or RINEX clock files and add them to stream
+* args   : pstrm_t *strm      IO  precise ephemeris/clock stream
+*                                 (initialize by {0} before first call)
+*          char   *file       I   sp3 or RINEX clock files
+*                                 (wind-card * is expanded)
+*          int    opt         I   sp3 options (1: only observed + 2: only
+*                                 predicted)
+* return : number of files added to stream
+* notes  : files with extensions of .sp3, .SP3, .eph* and .EPH* are opened as
+*          sp3 and other files are opened as RINEX clock if they are
+*          (compressed files are uncompressed to temporary files)
+*          the function can be called again to add files to stream
+*-----------------------------------------------------------------------------*/
+extern int openpstrm(pstrm_t *strm, const char *file, int opt)
+{
+    pstrmf_t *strm_file,*f;
+    char *efiles[MAXEXFILE];
+    int i,n,nf=0;
+
+    trace(3,"openpstrm: file=%s opt=%d\n",file,opt);
+
+    for (i=0;i<MAXEXFILE;i++) {
+        if (!(efiles[i]=(char *)malloc(1024))) {
+            for (i--;i>=0;i--) free(efiles[i]);
+            return 0;
+        }
+    }
+    /* expand wild card in file path */
+    n=expath(file,efiles,MAXEXFILE);
+
+    for (i=0;i<n;i++) {
+        if (strm->n>=strm->nmax) {
+            if (!(strm_file=(pstrmf_t *)realloc(strm->file,
+                                               sizeof(pstrmf_t)*(strm->nmax+16)))) {
+                trace(1,"openpstrm malloc error n=%d\n",strm->nmax+16);
+                break;
+            }
+            strm->file=strm_file;
+            strm->nmax+=16;
+        }
+        f=strm->file+strm->n;
+        memset(f,0,sizeof(pstrmf_t));
+        strcpy(f->file,efiles[i]);
+        f->opt=opt&3;
+        f->index=strm->nidx;
+
+        if (!openpstrmf(f)) {
+            closepstrmf(f);
+            continue;
+        }
+        trace(3,"openpstrm: type=%d index=%d file=%s\n",f->type,f->index,f->file);
+        strm->nidx++;
+        strm->n++;
+        nf++;
+    }
+    for (i=0;i<MAXEXFILE;i++) free(efiles[i]);
+
+    return nf;
+}
+/* update precise ephemeris/clock stream ---------------------------------------
+* read precise ephemeris/clock of stream files into time window around time
+* args   : pstrm_t *strm      IO  precise ephemeris/clock stream
+*          gtime_t time       I   current processing time (GPST)
+*          nav_t  *nav        IO  navigation data
+* return : status (1:ok,0:memory allocation error)
+* notes  : nav->peph/ne (sp3) and nav->pclk/nc (RINEX clock) are replaced by
+*          a window keeping NMAX+1 epochs before and after time. peph2pos()
+*          around time gives the same results as by readsp3() and readrnxc()
+*          with all epochs of the files. epochs in each file should be in time
+*          order. if time goes back before the window, the files are read again
+*          from the first epochs.
+*          nav->pephs and nav->pephc are not used for stream.
+*-----------------------------------------------------------------------------*/
+extern int updpstrm(pstrm_t *strm, gtime_t time, nav_t *nav)
+{
+    pstrmf_t *f;
+    int i,j,k,n,type;
+
+    trace(4,"updpstrm: time=%s n=%d\n",time_str(time,0),strm->n);
+
+    for (type=0;type<2;type++) {
+        for (i=0;i<strm->n;i++) if (strm->file[i].type==type) break;
+        if (i>=strm->n) continue;
+
+        /* restart stream if time goes back before window */
+        n=winn(nav,type);
+        for (j=0;j<n&&timediff(wint(nav,type,j),time)<=0.0;j++) ;
+        if (strm->drop[type]&&j<NPSTRM) {
+            trace(3,"updpstrm: restart type=%d time=%s\n",type,time_str(time,0));
+            if (type) nav->nc=0; else nav->ne=0;
+            for (i=0;i<strm->n;i++) {
+                f=strm->file+i;
+                if (f->type!=type) continue;
+                f->rsat=0;
+                if (fseek(f->fp,f->off,SEEK_SET)) f->stat=0;
+                else readpstrmf(f);
+            }
+            strm->drop[type]=0;
+        }
+        /* read epochs in time order until NPSTRM epochs after time */
+        for (;;) {
+            for (i=0,k=-1;i<strm->n;i++) {
+                f=strm->file+i;
+                if (f->type!=type||!f->stat) continue;
+                if (k<0||timediff(pstrmft(f),pstrmft(strm->file+k))<0.0) k=i;
+            }
+            if (k<0) break;
+
+            if ((n=winn(nav,type))>0&&
+                timediff(pstrmft(strm->file+k),wint(nav,type,n-1))>=1E-9) {
+                for (j=n;j>0&&timediff(wint(nav,type,j-1),time)>0.0;j--) ;
+                if (n-j>=NPSTRM) break;
+            }
+            if (!(type?inspclk(nav,strm->file[k].pclk):
+                       inspeph(nav,strm->file[k].peph))) return 0;
+
+            readpstrmf(strm->file+k);
+
+            if (winn(nav,type)>=4*NPSTRM) strm->drop[type]|=dropwin(nav,type,time);
+        }
+        strm->drop[type]|=dropwin(nav,type,time);
+    }
+    return 1;
+}
+/* close precise ephemeris/clock stream ----------------------------------------
+* close files of precise ephemeris/clock stream
+* args   : pstrm_t *strm      IO  precise ephemeris/clock stream
+* return : none
+* notes  : the window in navigation data is not freed
+*-----------------------------------------------------------------------------*/
+extern void closepstrm(pstrm_t *strm)
+{
+    int i;
+
+    trace(3,"closepstrm: n=%d\n",strm->n);
+
+    for (i=0;i<strm->n;i++) closepstrmf(strm->file+i);
+    free(strm->file);
+    memset(strm,0,sizeof(pstrm_t));
+}
@@ -1301,6 +1301,7 @@ extern int init_raw(raw_t *raw, int format)
     geph_t geph0={0,-1};
     seph_t seph0={0};
     sbsmsg_t sbsmsg0={0};
+    navidx_t idx0={0};
     int i,j,ret=1;
     
     trace(3,"init_raw: format=%d\n",format);
@@ -1334,6 +1335,8 @@ extern int init_raw(raw_t *raw, int format)
     raw->nav.alm  =NULL;
     raw->nav.geph =NULL;
     raw->nav.seph =NULL;
+    raw->nav.ieph =raw->nav.igeph=raw->nav.iseph=idx0; /* not indexed */
+    raw->nav.nver =0;
     raw->rcv_data =NULL;
     
     if (!(raw->obs.data =(obsd_t *)malloc(sizeof(obsd_t)*MAXOBS))||
@@ -117,6 +117,7 @@
 *                           use integer types in stdint.h
 *                           suppress warnings
 *-----------------------------------------------------------------------------*/
+#include <sys/stat.h>
 #include "rtklib.h"
 
 /* constants/macros ----------------------------------------------------------*/
@@ -129,6 +130,10 @@
 #define MINFREQ_GLO -7                  /* min frequency number GLONASS */
 #define MAXFREQ_GLO 13                  /* max frequency number GLONASS */
 #define NINCOBS     262144              /* incremental number of obs data */
+#define CACHEEXT    ".rtkc"             /* extension of RINEX OBS cache file */
+#define CACHEVER    1                   /* version of RINEX OBS cache format */
+#define MAXRNXTHR   32                  /* max number of RINEX OBS threads */
+#define MINRNXCHK   65536               /* min size of RINEX OBS chunk (bytes) */
 
 static const int navsys[RNX_NUMSYS]={ /* satellite systems */
     SYS_GPS,SYS_GLO,SYS_GAL,SYS_QZS,SYS_SBS,SYS_CMP,SYS_IRN
@@ -157,6 +162,38 @@ typedef struct {                        /* signal index type */
     double shift[MAXOBSTYPE];           /* phase shift (cycle) */
 } sigind_t;
 
+typedef struct {                        /* RINEX OBS cache header type */
+    char id[8];                         /* identifier ("RNXCACH") */
+    int ver;                            /* cache format version */
+    int size[4];                        /* {obsd_t,sta_t,MAXSAT,NFREQ+NEXOBS} */
+    double fsize;                       /* RINEX file size (bytes) */
+    double mtime;                       /* RINEX file modified time */
+    gtime_t ts,te;                      /* observation time start/end */
+    double tint;                        /* observation time interval (s) */
+    char opt[256];                      /* RINEX options */
+    int stat;                           /* status of reading RINEX file */
+    int n;                              /* number of observation data */
+} rnxcache_t;
+
+typedef struct {                        /* RINEX OBS epoch block type */
+    int n;                              /* return value of readrnxobsb() */
+    int flag;                           /* epoch flag */
+} obsblk_t;
+
+typedef struct {                        /* RINEX OBS body chunk type */
+    const char *file;                   /* RINEX OBS file path */
+    const char *opt;                    /* RINEX options */
+    double ver;                         /* RINEX version */
+    int tsys;                           /* time system */
+    char tobs[RNX_NUMSYS][MAXOBSTYPE][4]; /* observation types */
+    long start,end;                     /* chunk start/end offset (bytes) */
+    int stat;                           /* status (1:ok,0:error) */
+    int nb,nbmax,ib;                    /* number/allocated/read of blocks */
+    int nd,ndmax,id;                    /* number/allocated/read of records */
+    obsblk_t *blk;                      /* epoch blocks */
+    obsd_t *data;                       /* observation data records */
+} obschk_t;
+
 /* set string without tail space ---------------------------------------------*/
 static void setstr(char *dst, const char *src, int n)
 {
@@ -1096,31 +1133,239 @@ static int readrnxobsb(FILE *fp, const char *opt, double ver, int *tsys,
     }
     return -1;
 }
+/* add epoch block to RINEX OBS chunk ---------------------------------------*/
+static int addobsblk(obschk_t *chk, int n, int flag, const obsd_t *data)
+{
+    obsblk_t *blk;
+    obsd_t *obs_data;
+    int i,m=n>0?n:1; /* data[0] is kept for n=0 */
+
+    if (chk->nb>=chk->nbmax) {
+        chk->nbmax=chk->nbmax<=0?1024:chk->nbmax*2;
+        if (!(blk=(obsblk_t *)realloc(chk->blk,sizeof(obsblk_t)*chk->nbmax))) {
+            return 0;
+        }
+        chk->blk=blk;
+    }
+    if (chk->nd+m>chk->ndmax) {
+        chk->ndmax=chk->ndmax<=0?NINCOBS/16:chk->ndmax*2;
+        if (!(obs_data=(obsd_t *)realloc(chk->data,sizeof(obsd_t)*chk->ndmax))) {
+            return 0;
+        }
+        chk->data=obs_data;
+    }
+    chk->blk[chk->nb].n=n;
+    chk->blk[chk->nb++].flag=flag;
+    for (i=0;i<m;i++) chk->data[chk->nd++]=data[i];
+    return 1;
+}
+/* read RINEX OBS chunk (thread) -----------------------------------------------
+* parse epoch blocks of a RINEX OBS chunk [start,end) with own file pointer.
+* the chunk is rejected by stat=0 if it contains new site or header info
+* records (epoch flag 3 or 4) which change the read state for following
+* epochs.
+*-----------------------------------------------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI obsthread(void *arg)
+#else
+static void *obsthread(void *arg)
+#endif
+{
+    obschk_t *chk=(obschk_t *)arg;
+    FILE *fp;
+    obsd_t *data;
+    int n,flag=0;
+
+    if (!(fp=fopen(chk->file,"r"))) return 0;
+
+    if (!(data=(obsd_t *)calloc(MAXOBS,sizeof(obsd_t)))) {
+        fclose(fp);
+        return 0;
+    }
+    chk->stat=!fseek(fp,chk->start,SEEK_SET);
+
+    while (chk->stat&&ftell(fp)<chk->end) {
+        if ((n=readrnxobsb(fp,chk->opt,chk->ver,&chk->tsys,chk->tobs,&flag,
+                           data,NULL))<0) break;
+
+        /* epoch at end of chunk belongs to next chunk */
+        if (ftell(fp)>chk->end) break;
+
+        if (flag==3||flag==4||!addobsblk(chk,n,flag,data)) chk->stat=0;
+    }
+    free(data);
+    fclose(fp);
+    return 0;
+}
+/* read RINEX OBS body by threads ----------------------------------------------
+* split RINEX 3 OBS body into chunks at epoch lines ('>') and parse them in
+* parallel.
+* args   : char   *file     I   RINEX OBS file path
+*          long   off       I   offset of OBS body (bytes)
+*          int    nthr      I   number of threads
+*          obschk_t *chk    IO  RINEX OBS chunks (chk[0] is set by caller)
+* return : number of parsed chunks (0: read body sequentially)
+*-----------------------------------------------------------------------------*/
+static int readobschk(const char *file, long off, int nthr, obschk_t *chk)
+{
+    FILE *fp;
+    rtklib_thread_t thread[MAXRNXTHR];
+    char buff[MAXRNXLEN];
+    long size,pos;
+    int i,n,stat=1,run[MAXRNXTHR]={0};
+
+    if (!(fp=fopen(file,"r"))) return 0;
+
+    if (fseek(fp,0,SEEK_END)||(size=ftell(fp))<=off) {
+        fclose(fp);
+        return 0;
+    }
+    if (nthr>MAXRNXTHR) nthr=MAXRNXTHR;
+    if ((n=(int)((size-off)/MINRNXCHK))>nthr) n=nthr;
+    if (n<2) {
+        fclose(fp);
+        return 0;
+    }
+    /* search epoch lines for chunk boundaries */
+    chk[0].start=off;
+    for (i=1;i<n;i++) {
+        chk[i]=chk[0];
+        chk[i].start=size;
+        pos=off+(long)((double)(size-off)*i/n);
+        if (pos<chk[i-1].start) pos=chk[i-1].start;
+        if (fseek(fp,pos,SEEK_SET)||!fgets(buff,MAXRNXLEN,fp)) continue;
+        for (pos=ftell(fp);fgets(buff,MAXRNXLEN,fp);pos=ftell(fp)) {
+            if (buff[0]=='>') {
+                chk[i].start=pos;
+                break;
+            }
+        }
+    }
+    fclose(fp);
+
+    for (i=0;i<n;i++) chk[i].end=i<n-1?chk[i+1].start:size;
+
+    trace(3,"readobschk: file=%s size=%ld nchk=%d\n",file,size,n);
+
+    /* parse chunks by threads */
+    for (i=1;i<n;i++) {
+#ifdef WIN32
+        run[i]=(thread[i]=CreateThread(NULL,0,obsthread,chk+i,0,NULL))!=NULL;
+#else
+        run[i]=!pthread_create(thread+i,NULL,obsthread,chk+i);
+#endif
+        if (!run[i]) obsthread(chk+i);
+    }
+    obsthread(chk);
+
+    for (i=1;i<n;i++) {
+        if (!run[i]) continue;
+#ifdef WIN32
+        WaitForSingleObject(thread[i],INFINITE);
+        CloseHandle(thread[i]);
+#else
+        pthread_join(thread[i],NULL);
+#endif
+    }
+    for (i=0;i<n;i++) stat&=chk[i].stat;
+
+    if (!stat) {
+        trace(2,"rinex obs chunk rejected: file=%s\n",file);
+        for (i=0;i<n;i++) {
+            free(chk[i].blk);
+            free(chk[i].data);
+        }
+        return 0;
+    }
+    return n;
+}
+/* read RINEX observation data body from parsed chunks -------------------------
+* restore the results of readrnxobsb() in order. for the blocks without data,
+* only data[0] fields written by readrnxobsb() are restored.
+*-----------------------------------------------------------------------------*/
+static int readobsblk(obschk_t *chk, int nchk, int *ichk, int *flag,
+                      obsd_t *data)
+{
+    obschk_t *p;
+    const obsd_t *d;
+    int i,n;
+
+    for (;*ichk<nchk;(*ichk)++) {
+        p=chk+*ichk;
+        if (p->ib<p->nb) break;
+        free(p->blk ); p->blk =NULL;
+        free(p->data); p->data=NULL;
+    }
+    if (*ichk>=nchk) return -1;
+
+    n=p->blk[p->ib].n;
+    *flag=p->blk[p->ib++].flag;
+    d=p->data+p->id;
+    p->id+=n>0?n:1;
+
+    for (i=0;i<n;i++) data[i]=d[i];
+
+    if (n<=0) {
+        if (*flag==5) {
+            data[0].eventime=d[0].eventime;
+        }
+        else if (*flag<=2||*flag==6) {
+            data[0].time=d[0].time;
+            data[0].sat=d[0].sat;
+        }
+    }
+    return n;
+}
+/* read RINEX observation data body from file or parsed chunks ---------------*/
+static int readobsb(FILE *fp, const char *opt, double ver, int *tsys,
+                    char tobs[][MAXOBSTYPE][4], int *flag, obsd_t *data,
+                    sta_t *sta, obschk_t *chk, int nchk, int *ichk)
+{
+    if (nchk>0) return readobsblk(chk,nchk,ichk,flag,data);
+
+    return readrnxobsb(fp,opt,ver,tsys,tobs,flag,data,sta);
+}
 /* read RINEX observation data -----------------------------------------------*/
-static int readrnxobs(FILE *fp, gtime_t ts, gtime_t te, double tint,
-                      const char *opt, int rcv, double ver, int *tsys,
-                      char tobs[][MAXOBSTYPE][4], obs_t *obs, sta_t *sta)
+static int readrnxobs(FILE *fp, const char *file, gtime_t ts, gtime_t te,
+                      double tint, const char *opt, int rcv, double ver,
+                      int *tsys, char tobs[][MAXOBSTYPE][4], obs_t *obs,
+                      sta_t *sta)
 {
     gtime_t eventime={0},time0={0},time1={0};
     obsd_t *data;
+    obschk_t *chk=NULL;
     uint8_t slips[MAXSAT][NFREQ+NEXOBS]={{0}};
-    int i,n,n1=0,flag=0,stat=0;
+    int i,n,n1=0,flag=0,stat=0,nthr=0,nchk=0,ichk=0;
     double dtime1=0;
+    const char *p;
 
     trace(4,"readrnxobs: rcv=%d ver=%.2f tsys=%d\n",rcv,ver,*tsys);
 
     if (!obs||rcv>MAXRCV) return 0;
 
-    if (!(data=(obsd_t *)malloc(sizeof(obsd_t)*MAXOBS))) return 0;
+    if (!(data=(obsd_t *)calloc(MAXOBS,sizeof(obsd_t)))) return 0;
+
+    /* parse RINEX 3 OBS body by threads */
+    if ((p=strstr(opt,"-THREAD="))) sscanf(p+8,"%d",&nthr);
 
+    if (file&&ver>2.99&&nthr>1&&
+        (chk=(obschk_t *)calloc(MAXRNXTHR,sizeof(obschk_t)))) {
+        chk[0].file=file;
+        chk[0].opt=opt;
+        chk[0].ver=ver;
+        chk[0].tsys=*tsys;
+        memcpy(chk[0].tobs,tobs,sizeof(chk[0].tobs));
+        nchk=readobschk(file,ftell(fp),nthr,chk);
+    }
     /* read RINEX observation data body */
-    while ((n=readrnxobsb(fp,opt,ver,tsys,tobs,&flag,data,sta))>=0&&stat>=0) {
+    while ((n=readobsb(fp,opt,ver,tsys,tobs,&flag,data,sta,chk,nchk,&ichk))>=0&&
+           stat>=0) {
 
         if (flag == 5) {
             eventime = data[0].eventime;
-            n = readrnxobsb(fp,opt,ver,tsys,tobs,&flag,data,sta);
+            n = readobsb(fp,opt,ver,tsys,tobs,&flag,data,sta,chk,nchk,&ichk);
             if (fabs(timediff(data[0].time,time1)-dtime1)>=DTTOL)
-                n = readrnxobsb(fp,opt,ver,tsys,tobs,&flag,data,sta);
+                n = readobsb(fp,opt,ver,tsys,tobs,&flag,data,sta,chk,nchk,&ichk);
         }
 
         if (eventime.time==0 || obs->n-n1<=0 || timediff(eventime,time1)>=0) {
@@ -1159,6 +1404,11 @@ static int readrnxobs(FILE *fp, gtime_t ts, gtime_t te, double tint,
     }
     trace(4,"readrnxobs: nobs=%d stat=%d\n",obs->n,stat);
 
+    for (i=ichk;i<nchk;i++) {
+        free(chk[i].blk);
+        free(chk[i].data);
+    }
+    free(chk);
     free(data);
 
     return stat;
@@ -1519,14 +1769,38 @@ static int readrnxnav(FILE *fp, const char *opt, double ver, int sys,
     }
     return nav->n>0||nav->ng>0||nav->ns>0;
 }
+/* read RINEX clock record ---------------------------------------------------*/
+static int readrnxclkb(FILE *fp, int mask, int off, gtime_t *time, int *sat,
+                       double *data)
+{
+    int i,j;
+    char buff[MAXRNXLEN],satid[8]="";
+
+    while (fgets(buff,sizeof(buff),fp)) {
+
+        if (str2time(buff,8+off,26,time)) {
+            trace(2,"rinex clk invalid epoch: %34.34s\n",buff);
+            continue;
+        }
+        memcpy(satid,buff+3,4);
+
+        /* only read AS (satellite clock) record */
+        if (strncmp(buff,"AS",2)||!(*sat=satid2no(satid))) continue;
+
+        if (!(satsys(*sat,NULL)&mask)) continue;
+
+        for (i=0,j=40+off;i<2;i++,j+=20) data[i]=str2num(buff,j,19);
+        return 1;
+    }
+    return 0;
+}
 /* read RINEX clock ----------------------------------------------------------*/
 static int readrnxclk(FILE *fp, const char *opt, double ver, int index, nav_t *nav)
 {
     pclk_t *nav_pclk;
     gtime_t time;
     double data[2];
-    int i,j,sat,mask,off;
-    char buff[MAXRNXLEN],satid[8]="";
+    int i,sat,mask,off;
 
     trace(3,"readrnxclk: index=%d\n", index);
 
@@ -1536,20 +1810,7 @@ static int readrnxclk(FILE *fp, const char *opt, double ver, int index, nav_t *n
     mask=set_sysmask(opt);
     off=ver>=3.04?5:0; /* format change for ver>=3.04 */
 
-    while (fgets(buff,sizeof(buff),fp)) {
-
-        if (str2time(buff,8+off,26,&time)) {
-            trace(2,"rinex clk invalid epoch: %34.34s\n",buff);
-            continue;
-        }
-        memcpy(satid,buff+3,4);
-
-        /* only read AS (satellite clock) record */
-        if (strncmp(buff,"AS",2)||!(sat=satid2no(satid))) continue;
-
-        if (!(satsys(sat,NULL)&mask)) continue;
-
-        for (i=0,j=40+off;i<2;i++,j+=20) data[i]=str2num(buff,j,19);
+    while (readrnxclkb(fp,mask,off,&time,&sat,data)) {
 
         if (nav->nc>=nav->ncmax) {
             nav->ncmax+=1024;
@@ -1575,9 +1836,9 @@ static int readrnxclk(FILE *fp, const char *opt, double ver, int index, nav_t *n
     return nav->nc>0;
 }
 /* read RINEX file -----------------------------------------------------------*/
-static int readrnxfp(FILE *fp, gtime_t ts, gtime_t te, double tint,
-                     const char *opt, int flag, int index, char *type,
-                     obs_t *obs, nav_t *nav, sta_t *sta)
+static int readrnxfp(FILE *fp, const char *file, gtime_t ts, gtime_t te,
+                     double tint, const char *opt, int flag, int index,
+                     char *type, obs_t *obs, nav_t *nav, sta_t *sta)
 {
     double ver;
     int sys,tsys=TSYS_GPS;
@@ -1593,8 +1854,8 @@ static int readrnxfp(FILE *fp, gtime_t ts, gtime_t te, double tint,
 
     /* read RINEX file body */
     switch (*type) {
-        case 'O': return readrnxobs(fp,ts,te,tint,opt,index,ver,&tsys,tobs,obs,
-                                    sta);
+        case 'O': return readrnxobs(fp,file,ts,te,tint,opt,index,ver,&tsys,tobs,
+                                    obs,sta);
         case 'N': return readrnxnav(fp,opt,ver,sys    ,nav);
         case 'G': return readrnxnav(fp,opt,ver,SYS_GLO,nav);
         case 'H': return readrnxnav(fp,opt,ver,SYS_SBS,nav);
@@ -1605,36 +1866,186 @@ static int readrnxfp(FILE *fp, gtime_t ts, gtime_t te, double tint,
     trace(2,"unsupported rinex type ver=%.2f type=%c\n",ver,*type);
     return 0;
 }
+/* RINEX OBS cache key -------------------------------------------------------*/
+static int cachekey(const char *file, gtime_t ts, gtime_t te, double tint,
+                    const char *opt, rnxcache_t *key)
+{
+    struct stat st;
+
+    memset(key,0,sizeof(rnxcache_t));
+
+    if (stat(file,&st)) return 0;
+
+    strcpy(key->id,"RNXCACH");
+    key->ver=CACHEVER;
+    key->size[0]=(int)sizeof(obsd_t);
+    key->size[1]=(int)sizeof(sta_t);
+    key->size[2]=MAXSAT;
+    key->size[3]=NFREQ+NEXOBS;
+    key->fsize=(double)st.st_size;
+    key->mtime=(double)st.st_mtime;
+    key->ts=ts;
+    key->te=te;
+    key->tint=tint;
+    strncpy(key->opt,opt,sizeof(key->opt)-1);
+    return 1;
+}
+/* read RINEX OBS cache --------------------------------------------------------
+* read observation data, station parameters and GLONASS FCNs of a RINEX OBS
+* file from the cache file written by writecache(). the cache is valid if
+* the RINEX file, the read options and the record layout are the same.
+*-----------------------------------------------------------------------------*/
+static int readcache(const char *file, rnxcache_t *key, int rcv, obs_t *obs,
+                     nav_t *nav, sta_t *sta)
+{
+    FILE *fp;
+    rnxcache_t head;
+    obsd_t *obs_data;
+    sta_t sta0;
+    int i,fcn[32];
+    char path[1040];
+
+    sprintf(path,"%.1023s%s",file,CACHEEXT);
+
+    if (!(fp=fopen(path,"rb"))) return 0;
+
+    if (fread(&head,sizeof(rnxcache_t),1,fp)!=1) {
+        fclose(fp);
+        return 0;
+    }
+    key->stat=head.stat;
+    key->n=head.n;
+
+    if (memcmp(&head,key,sizeof(rnxcache_t))||head.n<0||
+        fread(&sta0,sizeof(sta_t),1,fp)!=1||fread(fcn,sizeof(fcn),1,fp)!=1) {
+        trace(3,"rinex cache invalid: %s\n",path);
+        fclose(fp);
+        return 0;
+    }
+    if (obs->nmax<obs->n+head.n) {
+        if (!(obs_data=(obsd_t *)realloc(obs->data,sizeof(obsd_t)*(obs->n+head.n)))) {
+            trace(1,"readcache: malloc error n=%d\n",obs->n+head.n);
+            fclose(fp);
+            return 0;
+        }
+        obs->data=obs_data;
+        obs->nmax=obs->n+head.n;
+    }
+    if (fread(obs->data+obs->n,sizeof(obsd_t),head.n,fp)!=(size_t)head.n) {
+        trace(2,"rinex cache read error: %s\n",path);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+
+    for (i=0;i<head.n;i++) obs->data[obs->n+i].rcv=(uint8_t)rcv;
+    obs->n+=head.n;
+
+    if (sta) *sta=sta0;
+    if (nav) {
+        for (i=0;i<32;i++) if (fcn[i]) nav->glo_fcn[i]=fcn[i];
+    }
+    trace(3,"readcache: file=%s n=%d\n",path,head.n);
+    return 1;
+}
+/* write RINEX OBS cache -----------------------------------------------------*/
+static void writecache(const char *file, rnxcache_t *key, int stat,
+                       const obsd_t *data, int n, const sta_t *sta,
+                       const int *fcn)
+{
+    FILE *fp;
+    char path[1040],tmpfile[1080];
+    int ok;
+
+    sprintf(path,"%.1023s%s",file,CACHEEXT);
+    sprintf(tmpfile,"%s.%p",path,(const void *)data); /* unique in process */
+
+    key->stat=stat;
+    key->n=n;
+
+    if (!(fp=fopen(tmpfile,"wb"))) {
+        trace(2,"rinex cache open error: %s\n",tmpfile);
+        return;
+    }
+    ok=fwrite(key,sizeof(rnxcache_t),1,fp)==1&&
+       fwrite(sta,sizeof(sta_t),1,fp)==1&&
+       fwrite(fcn,sizeof(int),32,fp)==32&&
+       fwrite(data,sizeof(obsd_t),n,fp)==(size_t)n;
+    if (fclose(fp)) ok=0;
+
+    /* replace cache file */
+    if (!ok||(rename(tmpfile,path)&&(remove(path)||rename(tmpfile,path)))) {
+        trace(2,"rinex cache write error: %s\n",path);
+        remove(tmpfile);
+        return;
+    }
+    trace(3,"writecache: file=%s n=%d\n",path,n);
+}
 /* uncompress and read RINEX file --------------------------------------------*/
 static int readrnxfile(const char *file, gtime_t ts, gtime_t te, double tint,
                        const char *opt, int flag, int index, char *type,
                        obs_t *obs, nav_t *nav, sta_t *sta)
 {
     FILE *fp;
-    int cstat,stat;
+    rnxcache_t key;
+    sta_t sta0,*stap=sta;
+    int i,cstat,stat,cache,n0=0,fcn[32],fcn0[32];
     char tmpfile[1024];
 
     trace(3,"readrnxfile: file=%s flag=%d index=%d\n",file,flag,index);
 
     if (sta) init_sta(sta);
 
+    /* reuse RINEX OBS cache */
+    cache=!flag&&obs&&strstr(opt,"-CACHE")&&
+          cachekey(file,ts,te,tint,opt,&key);
+
+    if (cache&&readcache(file,&key,index,obs,nav,sta)) {
+        *type='O';
+        return key.stat;
+    }
+    if (cache) {
+        n0=obs->n;
+        if (!sta) {
+            init_sta(&sta0);
+            stap=&sta0;
+        }
+        if (nav) { /* GLONASS FCNs in RINEX OBS header */
+            for (i=0;i<32;i++) {
+                fcn0[i]=nav->glo_fcn[i];
+                nav->glo_fcn[i]=0;
+            }
+        }
+    }
     /* uncompress file */
     if ((cstat=rtk_uncompress(file,tmpfile))<0) {
         trace(2,"rinex file uncompact error: %s\n",file);
-        return 0;
+        stat=0;
     }
-    if (!(fp=fopen(cstat?tmpfile:file,"r"))) {
+    else if (!(fp=fopen(cstat?tmpfile:file,"r"))) {
         trace(2,"rinex file open error: %s\n",cstat?tmpfile:file);
-        return 0;
+        stat=0;
     }
-    /* read RINEX file */
-    stat=readrnxfp(fp,ts,te,tint,opt,flag,index,type,obs,nav,sta);
-
-    fclose(fp);
+    else {
+        /* read RINEX file */
+        stat=readrnxfp(fp,cstat?tmpfile:file,ts,te,tint,opt,flag,index,type,
+                       obs,nav,stap);
 
+        fclose(fp);
+    }
     /* delete temporary file */
-    if (cstat) remove(tmpfile);
+    if (cstat>0) remove(tmpfile);
 
+    if (cache&&nav) {
+        for (i=0;i<32;i++) {
+            fcn[i]=nav->glo_fcn[i];
+            if (!fcn[i]) nav->glo_fcn[i]=fcn0[i];
+        }
+    }
+    /* write RINEX OBS cache */
+    if (cache&&nav&&*type=='O'&&stat>=0) {
+        writecache(file,&key,stat,obs->data+n0,obs->n-n0,stap,fcn);
+    }
     return stat;
 }
 /* read RINEX OBS and NAV files ------------------------------------------------
@@ -1670,6 +2081,12 @@ static int readrnxfile(const char *file, gtime_t ts, gtime_t te, double tint,
 *            -SYS=sys[,sys...]: select navigation systems
 *                               (sys=G:GPS,R:GLO,E:GAL,J:QZS,C:BDS,I:IRN,S:SBS)
 *
+*            -THREAD=n: parse RINEX 3 OBS file by n threads
+*
+*            -CACHE: reuse binary cache of RINEX OBS file (file.rtkc) written
+*                    at the first read. the cache is valid for the same file
+*                    size, modified time, ts, te, tint and options.
+*
 *-----------------------------------------------------------------------------*/
 extern int readrnxt(const char *file, int rcv, gtime_t ts, gtime_t te,
                     double tint, const char *opt, obs_t *obs, nav_t *nav,
@@ -1682,7 +2099,7 @@ extern int readrnxt(const char *file, int rcv, gtime_t ts, gtime_t te,
     trace(3,"readrnxt: file=%s rcv=%d\n",file,rcv);
 
     if (!*file) {
-        return readrnxfp(stdin,ts,te,tint,opt,0,1,&type,obs,nav,sta);
+        return readrnxfp(stdin,NULL,ts,te,tint,opt,0,1,&type,obs,nav,sta);
     }
     for (i=0;i<MAXEXFILE;i++) {
         if (!(files[i]=(char *)malloc(1024))) {
@@ -1798,6 +2215,45 @@ extern int readrnxc(const char *file, nav_t *nav)
 
     return nav->nc;
 }
+/* read RINEX clock header -----------------------------------------------------
+* read RINEX clock file header to read the records one by one
+* args   : FILE   *fp    I      file pointer
+*          double *ver   O      RINEX version
+* return : status (1:ok,0:no RINEX clock file)
+* notes  : the file pointer is set to the first record of the body
+*-----------------------------------------------------------------------------*/
+extern int readrnxclkh(FILE *fp, double *ver)
+{
+    double v;
+    int i,sys,tsys;
+    char buff[MAXRNXLEN],type,tobs[RNX_NUMSYS][MAXOBSTYPE][4]={{""}};
+
+    trace(3,"readrnxclkh:\n");
+
+    /* check file type before reading header */
+    for (i=0;i<MAXPOSHEAD&&fgets(buff,MAXRNXLEN,fp);i++) {
+        if (strlen(buff)<=60||!strstr(buff+60,"RINEX VERSION / TYPE")) continue;
+        v=str2num(buff,0,9);
+        if (*(buff+(v<3.04?20:21))!='C') return 0;
+        rewind(fp);
+        return readrnxh(fp,ver,&type,&sys,&tsys,tobs,NULL,NULL,1)&&type=='C';
+    }
+    return 0;
+}
+/* read RINEX clock record -----------------------------------------------------
+* read next satellite clock (AS) record of RINEX clock file
+* args   : FILE   *fp    I      file pointer
+*          double ver    I      RINEX version (readrnxclkh())
+*          gtime_t *time O      record time
+*          int    *sat   O      satellite number
+*          double *data  O      satellite clock bias and std {clk,std} (s)
+* return : status (1:ok,0:end of file)
+*-----------------------------------------------------------------------------*/
+extern int readrnxclkr(FILE *fp, double ver, gtime_t *time, int *sat,
+                       double *data)
+{
+    return readrnxclkb(fp,SYS_ALL,ver>=3.04?5:0,time,sat,data);
+}
 /* initialize RINEX control ----------------------------------------------------
 * initialize RINEX control struct and reallocate memory for observation and
 * ephemeris buffer in RINEX control struct
@@ -1811,6 +2267,7 @@ extern int init_rnxctr(rnxctr_t *rnx)
     eph_t  eph0={0,-1,-1};
     geph_t geph0={0,-1};
     seph_t seph0={0};
+    navidx_t idx0={0};
     int i,j;
 
     trace(3,"init_rnxctr:\n");
@@ -1819,6 +2276,8 @@ extern int init_rnxctr(rnxctr_t *rnx)
     rnx->nav.eph =NULL;
     rnx->nav.geph=NULL;
     rnx->nav.seph=NULL;
+    rnx->nav.ieph=rnx->nav.igeph=rnx->nav.iseph=idx0; /* not indexed */
+    rnx->nav.nver=0;
 
     if (!(rnx->obs.data=(obsd_t *)malloc(sizeof(obsd_t)*MAXOBS   ))||
         !(rnx->nav.eph =(eph_t  *)malloc(sizeof(eph_t )*MAXSAT*2 ))||
@@ -70,6 +70,7 @@ extern int init_rtcm(rtcm_t *rtcm)
     eph_t  eph0 ={0,-1,-1};
     geph_t geph0={0,-1};
     ssr_t ssr0={{{0}}};
+    navidx_t idx0={0};
     int i,j;
     
     trace(3,"init_rtcm:\n");
@@ -104,6 +105,8 @@ extern int init_rtcm(rtcm_t *rtcm)
     rtcm->obs.data=NULL;
     rtcm->nav.eph =NULL;
     rtcm->nav.geph=NULL;
+    rtcm->nav.ieph=rtcm->nav.igeph=rtcm->nav.iseph=idx0; /* not indexed */
+    rtcm->nav.nver=0;
     
     /* reallocate memory for observation and ephemeris buffer */
     if (!(rtcm->obs.data=(obsd_t *)malloc(sizeof(obsd_t)*MAXOBS))||
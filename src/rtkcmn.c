@@ -147,6 +147,7 @@
 #include <stdarg.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #ifndef WIN32
 #include <dirent.h>
 #include <time.h>
@@ -1020,6 +1021,134 @@ extern double *eye(int n)
     if ((p=zeros(n,n))) for (i=0;i<n;i++) p[i+i*n]=1.0;
     return p;
 }
+/* initialize workspace -------------------------------------------------------
+* initialize workspace (scratch memory arena) for matrices
+* args   : wsp_t  *ws       IO  workspace
+*          int    size      I   initial size of workspace buffer (doubles)
+* return : none
+* notes  : matrices allocated by wspmat(),wspimat() or wspzeros() are valid
+*          until the workspace is released to a mark taken before them.
+*          if the buffer is exhausted, the request is served by an overflow
+*          block and the buffer is enlarged to the peak usage when the
+*          workspace is fully released. so the steady-state processing
+*          performs no heap allocation.
+*-----------------------------------------------------------------------------*/
+extern void wspinit(wsp_t *ws, int size)
+{
+    wsp_t ws0={0};
+
+    *ws=ws0;
+    if (size>0) {
+        ws->buff=mat(size,1);
+        ws->size=size;
+    }
+}
+/* free workspace --------------------------------------------------------------
+* free workspace
+* args   : wsp_t  *ws       IO  workspace
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void wspfree(wsp_t *ws)
+{
+    wsprelease(ws,0);
+    free(ws->buff); free(ws->blk); free(ws->off);
+    ws->buff=NULL; ws->blk=NULL; ws->off=NULL;
+    ws->size=ws->used=ws->peak=ws->nb=ws->nbmax=0;
+}
+/* allocate memory in workspace ----------------------------------------------*/
+static double *wspalloc(wsp_t *ws, int n)
+{
+    double *p,**blk;
+    int *off,nbmax;
+
+    if (n<=0) return NULL;
+    if (ws->used+n<=ws->size) {
+        p=ws->buff+ws->used;
+    }
+    else { /* overflow block */
+        if (ws->nb>=ws->nbmax) {
+            nbmax=ws->nbmax<=0?16:ws->nbmax*2;
+            if (!(blk=(double **)realloc(ws->blk,sizeof(double *)*nbmax))) {
+                fatalerr("workspace memory allocation error: nb=%d\n",nbmax);
+            }
+            ws->blk=blk;
+            if (!(off=(int *)realloc(ws->off,sizeof(int)*nbmax))) {
+                fatalerr("workspace memory allocation error: nb=%d\n",nbmax);
+            }
+            ws->off=off; ws->nbmax=nbmax;
+        }
+        p=mat(n,1);
+        ws->blk[ws->nb]=p;
+        ws->off[ws->nb++]=ws->used;
+    }
+    ws->used+=n;
+    if (ws->used>ws->peak) ws->peak=ws->used;
+    return p;
+}
+/* new matrix in workspace -----------------------------------------------------
+* allocate matrix in workspace
+* args   : wsp_t  *ws       IO  workspace
+*          int    n,m       I   number of rows and columns of matrix
+* return : matrix pointer (if n<=0 or m<=0, return NULL)
+*-----------------------------------------------------------------------------*/
+extern double *wspmat(wsp_t *ws, int n, int m)
+{
+    if (n<=0||m<=0) return NULL;
+    return wspalloc(ws,n*m);
+}
+/* new integer matrix in workspace ---------------------------------------------
+* allocate integer matrix in workspace
+* args   : wsp_t  *ws       IO  workspace
+*          int    n,m       I   number of rows and columns of matrix
+* return : matrix pointer (if n<=0 or m<=0, return NULL)
+*-----------------------------------------------------------------------------*/
+extern int *wspimat(wsp_t *ws, int n, int m)
+{
+    if (n<=0||m<=0) return NULL;
+    return (int *)wspalloc(ws,(int)((sizeof(int)*n*m+sizeof(double)-1)/
+                                    sizeof(double)));
+}
+/* zero matrix in workspace ----------------------------------------------------
+* allocate zero matrix in workspace
+* args   : wsp_t  *ws       IO  workspace
+*          int    n,m       I   number of rows and columns of matrix
+* return : matrix pointer (if n<=0 or m<=0, return NULL)
+*-----------------------------------------------------------------------------*/
+extern double *wspzeros(wsp_t *ws, int n, int m)
+{
+    double *p;
+
+    if ((p=wspmat(ws,n,m))) memset(p,0,sizeof(double)*n*m);
+    return p;
+}
+/* mark workspace --------------------------------------------------------------
+* get current mark of workspace to release matrices allocated after it
+* args   : wsp_t  *ws       I   workspace
+* return : mark of workspace
+*-----------------------------------------------------------------------------*/
+extern int wspmark(const wsp_t *ws)
+{
+    return ws->used;
+}
+/* release workspace -----------------------------------------------------------
+* release matrices allocated in workspace after the mark
+* args   : wsp_t  *ws       IO  workspace
+*          int    mark      I   mark of workspace by wspmark()
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void wsprelease(wsp_t *ws, int mark)
+{
+    while (ws->nb>0&&ws->off[ws->nb-1]>=mark) free(ws->blk[--ws->nb]);
+    ws->used=mark;
+
+    if (mark<=0&&ws->peak>ws->size) { /* enlarge buffer to peak usage */
+        trace(3,"wsprelease: enlarge workspace size=%d->%d\n",ws->size,
+              ws->peak);
+        free(ws->buff);
+        ws->buff=mat(ws->peak,1);
+        ws->size=ws->peak;
+    }
+}
 
 /* dot product -----------------------------------------------------------------
  * inner product of vectors of size 2
@@ -1145,6 +1274,17 @@ extern void matmulm(const char *tr, int n, int k, int m,
     dgemm_((char *)tr,(char *)tr+1,&n,&k,&m,&alpha,(double *)A,&lda,(double *)B,
            &ldb,&beta,C,&n);
 }
+#define NWORK_INV(n) ((n)*16)   /* size of work buffer for matinv_() */
+
+/* inverse of matrix with work buffers ---------------------------------------*/
+static int matinv_(double *A, int n, int *ipiv, double *work)
+{
+    int info,lwork=NWORK_INV(n);
+
+    dgetrf_(&n,&n,A,&n,ipiv,&info);
+    if (!info) dgetri_(&n,A,&n,ipiv,work,&lwork,&info);
+    return info;
+}
 /* inverse of matrix -----------------------------------------------------------
 * inverse of matrix (A=A^-1)
 * args   : double *A        IO  matrix (n x n)
@@ -1153,15 +1293,28 @@ extern void matmulm(const char *tr, int n, int k, int m,
 *-----------------------------------------------------------------------------*/
 extern int matinv(double *A, int n)
 {
-    double *work;
-    int info,lwork=n*16,*ipiv=imat(n,1);
+    double *work=mat(NWORK_INV(n),1);
+    int info,*ipiv=imat(n,1);
 
-    work=mat(lwork,1);
-    dgetrf_(&n,&n,A,&n,ipiv,&info);
-    if (!info) dgetri_(&n,A,&n,ipiv,work,&lwork,&info);
+    info=matinv_(A,n,ipiv,work);
     free(ipiv); free(work);
     return info;
 }
+/* inverse of matrix with workspace -------------------------------------------
+* inverse of matrix (A=A^-1) with work buffers allocated in workspace
+* args   : double *A        IO  matrix (n x n)
+*          int    n         I   size of matrix A
+*          wsp_t  *ws       IO  workspace
+* return : status (0:ok,0>:error)
+*-----------------------------------------------------------------------------*/
+extern int matinvw(double *A, int n, wsp_t *ws)
+{
+    int info,mark=wspmark(ws);
+
+    info=matinv_(A,n,wspimat(ws,n,1),wspmat(ws,NWORK_INV(n),1));
+    wsprelease(ws,mark);
+    return info;
+}
 /* solve linear equation -------------------------------------------------------
 * solve linear equation (X=A\Y or X=A'\Y)
 * args   : char   *tr       I   transpose flag ("N":normal,"T":transpose)
@@ -1189,149 +1342,219 @@ extern int solve(const char *tr, const double *A, const double *Y, int n,
 
 #else /* without LAPACK/BLAS or MKL */
 
-/* multiply matrix -----------------------------------------------------------*/
-extern void matmul(const char *tr, int n, int k, int m,
-                   const double *A, const double *B, double *C)
+/* vector type for matrix kernels (gcc/clang vector extension) ---------------*/
+#if defined(__GNUC__)&&!defined(NOSIMD)
+#define SIMD_VEC
+typedef double v4d_t __attribute__((vector_size(32)));
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#if defined(__x86_64__)||defined(__i386__)
+#define SIMD_AVX2 /* avx2 kernel selected at run time */
+#endif
+#else
+#define ALWAYS_INLINE
+#endif
+
+#ifdef SIMD_VEC
+/* load/store vector -----------------------------------------------------------
+* unaligned load/store. the vectors only add/subtract products element-wise
+* in the same order as the scalar code, so the results are bit-identical.
+*-----------------------------------------------------------------------------*/
+static ALWAYS_INLINE void vload(v4d_t *v, const double *p)
 {
-    int f=(tr[0]!='N')*2+(tr[1]!='N');
+    memcpy(v,p,sizeof(*v));
+}
+static ALWAYS_INLINE void vstore(double *p, const v4d_t *v, int op)
+{
+    v4d_t c;
 
+    if (op) {
+        vload(&c,p);
+        if (op>0) c+=*v; else c-=*v;
+    }
+    else c=*v;
+    memcpy(p,&c,sizeof(c));
+}
+#endif
+/* store element of matrix (op: 0:C=d,1:C+=d,-1:C-=d) ------------------------*/
+static ALWAYS_INLINE void sstore(double *p, double d, int op)
+{
+    if      (op>0) *p+=d;
+    else if (op<0) *p-=d;
+    else           *p =d;
+}
+/* multiply matrix kernel ------------------------------------------------------
+* C=A*B, C+=A*B or C-=A*B (op=0,1,-1) with transpose flags f (bit1:A,bit0:B)
+* notes  : each element is accumulated as d=sum(A(i,x)*B(x,j)) in the order of
+*          x, then stored to C. for normal A, 4 rows x 2 columns of C are
+*          computed at once with vectors, for transposed A 4 rows with
+*          independent accumulators.
+*-----------------------------------------------------------------------------*/
+static ALWAYS_INLINE void mmkern(int f, int n, int k, int m, const double *A,
+                                 const double *B, double *C, int op)
+{
+    const int ai=f&2?m:1,ax=f&2?1:n,bx=f&1?k:1,bj=f&1?1:m;
+    const double *Ai,*B0,*B1;
+    double d,d0,d1,d2,d3;
+    int i,j=0,x;
+
+    if (!(f&2)) { /* A normal */
+#ifdef SIMD_VEC
+        for (;j+2<=k;j+=2) {
+            B0=B+j*bj; B1=B+(j+1)*bj;
+            for (i=0;i+4<=n;i+=4) {
+                v4d_t a,c0={0},c1={0};
+                for (x=0;x<m;x++) {
+                    v4d_t b0={B0[x*bx],B0[x*bx],B0[x*bx],B0[x*bx]};
+                    v4d_t b1={B1[x*bx],B1[x*bx],B1[x*bx],B1[x*bx]};
+                    vload(&a,A+i+x*n);
+                    c0+=a*b0;
+                    c1+=a*b1;
+                }
+                vstore(C+i+j*n,&c0,op);
+                vstore(C+i+(j+1)*n,&c1,op);
+            }
+            for (;i<n;i++) {
+                for (x=0,d0=d1=0.0;x<m;x++) {
+                    d0+=A[i+x*n]*B0[x*bx];
+                    d1+=A[i+x*n]*B1[x*bx];
+                }
+                sstore(C+i+j*n,d0,op);
+                sstore(C+i+(j+1)*n,d1,op);
+            }
+        }
+#endif
+        for (;j<k;j++) {
+            B0=B+j*bj;
+            i=0;
+#ifdef SIMD_VEC
+            for (;i+4<=n;i+=4) {
+                v4d_t a,c0={0};
+                for (x=0;x<m;x++) {
+                    v4d_t b0={B0[x*bx],B0[x*bx],B0[x*bx],B0[x*bx]};
+                    vload(&a,A+i+x*n);
+                    c0+=a*b0;
+                }
+                vstore(C+i+j*n,&c0,op);
+            }
+#endif
+            for (;i<n;i++) {
+                for (x=0,d=0.0;x<m;x++) d+=A[i+x*n]*B0[x*bx];
+                sstore(C+i+j*n,d,op);
+            }
+        }
+        return;
+    }
+    for (j=0;j<k;j++) { /* A transposed */
+        B0=B+j*bj;
+        for (i=0;i+4<=n;i+=4) {
+            Ai=A+i*ai;
+            for (x=0,d0=d1=d2=d3=0.0;x<m;x++) {
+                d0+=Ai[x     ]*B0[x*bx];
+                d1+=Ai[x+  ai]*B0[x*bx];
+                d2+=Ai[x+2*ai]*B0[x*bx];
+                d3+=Ai[x+3*ai]*B0[x*bx];
+            }
+            sstore(C+i  +j*n,d0,op);
+            sstore(C+i+1+j*n,d1,op);
+            sstore(C+i+2+j*n,d2,op);
+            sstore(C+i+3+j*n,d3,op);
+        }
+        for (;i<n;i++) {
+            for (x=0,d=0.0;x<m;x++) d+=A[i*ai+x*ax]*B0[x*bx];
+            sstore(C+i+j*n,d,op);
+        }
+    }
+}
+/* multiply matrix kernel with constant transpose flags ----------------------*/
+static ALWAYS_INLINE void mmkernf(int f, int n, int k, int m, const double *A,
+                                  const double *B, double *C, int op)
+{
     switch (f) {
-        case 0: /* NN */
-          for (int j=0;j<k;j++) {
-              for (int i=0;i<n;i++) {
-                  double d=0.0;
-                  for (int x=0;x<m;x++) d+=A[i+x*n]*B[x+j*m];
-                  C[i+j*n]=d;
-              }
-          }
-          break;
-        case 1: /* NT */
-          for (int j=0;j<k;j++) {
-              for (int i=0;i<n;i++) {
-                  double d=0.0;
-                  for (int x=0;x<m;x++) d+=A[i+x*n]*B[j+x*k];
-                  C[i+j*n]=d;
-              }
-          }
-          break;
-        case 2: /* TN */
-          for (int j=0;j<k;j++) {
-              for (int i=0;i<n;i++) {
-                  double d=0.0;
-                  for (int x=0;x<m;x++) d+=A[x+i*m]*B[x+j*m];
-                  C[i+j*n]=d;
-              }
-          }
-          break;
-        case 3: /* TT */
-          for (int j=0;j<k;j++) {
-              for (int i=0;i<n;i++) {
-                  double d=0.0;
-                  for (int x=0;x<m;x++) d+=A[x+i*m]*B[j+x*k];
-                  C[i+j*n]=d;
-              }
-          }
-          break;
+        case 0 : mmkern(0,n,k,m,A,B,C,op); break;
+        case 1 : mmkern(1,n,k,m,A,B,C,op); break;
+        case 2 : mmkern(2,n,k,m,A,B,C,op); break;
+        default: mmkern(3,n,k,m,A,B,C,op); break;
     }
 }
-extern void matmulp(const char *tr, int n, int k, int m,
-                    const double *A, const double *B, double *C)
+/* generic multiply matrix kernel --------------------------------------------*/
+static void mmgen(int f, int n, int k, int m, const double *A, const double *B,
+                  double *C, int op)
+{
+    mmkernf(f,n,k,m,A,B,C,op);
+}
+#ifdef SIMD_AVX2
+/* avx2 multiply matrix kernel (without fma to keep results identical) -------*/
+__attribute__((target("avx2")))
+static void mmavx2(int f, int n, int k, int m, const double *A,
+                   const double *B, double *C, int op)
+{
+    mmkernf(f,n,k,m,A,B,C,op);
+}
+#endif
+/* multiply matrix (C=A*B,C+=A*B,C-=A*B) -------------------------------------*/
+static void matmul_(const char *tr, int n, int k, int m, const double *A,
+                    const double *B, double *C, int op)
 {
     int f=(tr[0]!='N')*2+(tr[1]!='N');
 
-    switch (f) {
-        case 0: /* NN */
-          for (int j=0;j<k;j++) {
-              for (int i=0;i<n;i++) {
-                  double d=0.0;
-                  for (int x=0;x<m;x++) d+=A[i+x*n]*B[x+j*m];
-                  C[i+j*n]+=d;
-              }
-          }
-          break;
-        case 1: /* NT */
-          for (int j=0;j<k;j++) {
-              for (int i=0;i<n;i++) {
-                  double d=0.0;
-                  for (int x=0;x<m;x++) d+=A[i+x*n]*B[j+x*k];
-                  C[i+j*n]+=d;
-              }
-          }
-          break;
-        case 2: /* TN */
-          for (int j=0;j<k;j++) {
-              for (int i=0;i<n;i++) {
-                  double d=0.0;
-                  for (int x=0;x<m;x++) d+=A[x+i*m]*B[x+j*m];
-                  C[i+j*n]+=d;
-              }
-          }
-          break;
-        case 3: /* TT */
-          for (int j=0;j<k;j++) {
-              for (int i=0;i<n;i++) {
-                  double d=0.0;
-                  for (int x=0;x<m;x++) d+=A[x+i*m]*B[j+x*k];
-                  C[i+j*n]+=d;
-              }
-          }
-          break;
+    /* unrolled kernels for small fixed-size matrices */
+    if (n==3&&m==3) {
+        if      (k==1) {mmkernf(f,3,1,3,A,B,C,op); return;}
+        else if (k==3) {mmkernf(f,3,3,3,A,B,C,op); return;}
+    }
+    else if (n==6&&m==6) {
+        if      (k==1) {mmkernf(f,6,1,6,A,B,C,op); return;}
+        else if (k==6) {mmkernf(f,6,6,6,A,B,C,op); return;}
+    }
+#ifdef SIMD_AVX2
+    if (__builtin_cpu_supports("avx2")) { /* select kernel by cpu features */
+        mmavx2(f,n,k,m,A,B,C,op);
+        return;
     }
+#endif
+    mmgen(f,n,k,m,A,B,C,op);
+}
+/* multiply matrix -----------------------------------------------------------*/
+extern void matmul(const char *tr, int n, int k, int m,
+                   const double *A, const double *B, double *C)
+{
+    matmul_(tr,n,k,m,A,B,C,0);
+}
+extern void matmulp(const char *tr, int n, int k, int m,
+                    const double *A, const double *B, double *C)
+{
+    matmul_(tr,n,k,m,A,B,C,1);
 }
 extern void matmulm(const char *tr, int n, int k, int m,
                     const double *A, const double *B, double *C)
 {
-    int f=(tr[0]!='N')*2+(tr[1]!='N');
+    matmul_(tr,n,k,m,A,B,C,-1);
+}
+/* y-=a*x --------------------------------------------------------------------*/
+static void axpym(int n, double a, const double *x, double *y)
+{
+    int i=0;
 
-    switch (f) {
-        case 0: /* NN */
-          for (int j=0;j<k;j++) {
-              for (int i=0;i<n;i++) {
-                  double d=0.0;
-                  for (int x=0;x<m;x++) d+=A[i+x*n]*B[x+j*m];
-                  C[i+j*n]-=d;
-              }
-          }
-          break;
-        case 1: /* NT */
-          for (int j=0;j<k;j++) {
-              for (int i=0;i<n;i++) {
-                  double d=0.0;
-                  for (int x=0;x<m;x++) d+=A[i+x*n]*B[j+x*k];
-                  C[i+j*n]-=d;
-              }
-          }
-          break;
-        case 2: /* TN */
-          for (int j=0;j<k;j++) {
-              for (int i=0;i<n;i++) {
-                  double d=0.0;
-                  for (int x=0;x<m;x++) d+=A[x+i*m]*B[x+j*m];
-                  C[i+j*n]-=d;
-              }
-          }
-          break;
-        case 3: /* TT */
-          for (int j=0;j<k;j++) {
-              for (int i=0;i<n;i++) {
-                  double d=0.0;
-                  for (int x=0;x<m;x++) d+=A[x+i*m]*B[j+x*k];
-                  C[i+j*n]-=d;
-              }
-          }
-          break;
+#ifdef SIMD_VEC
+    v4d_t va={a,a,a,a},vx;
+    for (;i+4<=n;i+=4) {
+        vload(&vx,x+i);
+        vx*=va;
+        vstore(y+i,&vx,-1);
     }
+#endif
+    for (;i<n;i++) y[i]-=a*x[i];
 }
 /* LU decomposition ----------------------------------------------------------*/
-static int ludcmp(double *A, int n, int *indx, double *d)
+static int ludcmp(double *A, int n, int *indx, double *d, double *vv)
 {
-    double big,s,tmp,*vv=mat(n,1);
+    double big,s,tmp;
     int i,imax=0,j,k;
 
     *d=1.0;
     for (i=0;i<n;i++) {
         big=0.0; for (j=0;j<n;j++) if ((tmp=fabs(A[i+j*n]))>big) big=tmp;
-        if (big>0.0) vv[i]=1.0/big; else {free(vv); return -1;}
+        if (big>0.0) vv[i]=1.0/big; else return -1;
     }
     for (j=0;j<n;j++) {
         for (i=0;i<j;i++) {
@@ -1349,12 +1572,49 @@ static int ludcmp(double *A, int n, int *indx, double *d)
             *d=-(*d); vv[imax]=vv[j];
         }
         indx[j]=imax;
-        if (A[j+j*n]==0.0) {free(vv); return -1;}
+        if (A[j+j*n]==0.0) return -1;
         if (j!=n-1) {
             tmp=1.0/A[j+j*n]; for (i=j+1;i<n;i++) A[i+j*n]*=tmp;
         }
     }
-    free(vv);
+    return 0;
+}
+/* LU decomposition by columns -------------------------------------------------
+* crout LU decomposition with partial pivoting. column j is updated by
+* A(k+1:n,j)-=A(k+1:n,k)*A(k,j) for k<j on contiguous columns, which applies
+* the same operations in the same order as the row-wise form.
+*-----------------------------------------------------------------------------*/
+static int ludcmpc(double *A, int n, int *indx, double *vv)
+{
+    double big,tmp,*Aj;
+    int i,imax=0,j,k;
+
+    for (i=0;i<n;i++) vv[i]=0.0;
+    for (j=0;j<n;j++) for (i=0;i<n;i++) {
+        if ((tmp=fabs(A[i+j*n]))>vv[i]) vv[i]=tmp;
+    }
+    for (i=0;i<n;i++) {
+        if (vv[i]>0.0) vv[i]=1.0/vv[i]; else return -1;
+    }
+    for (j=0;j<n;j++) {
+        Aj=A+j*n;
+        for (k=0;k<j;k++) axpym(n-k-1,Aj[k],A+k+1+k*n,Aj+k+1);
+        big=0.0;
+        for (i=j;i<n;i++) {
+            if ((tmp=vv[i]*fabs(Aj[i]))>=big) {big=tmp; imax=i;}
+        }
+        if (j!=imax) {
+            for (k=0;k<n;k++) {
+                tmp=A[imax+k*n]; A[imax+k*n]=A[j+k*n]; A[j+k*n]=tmp;
+            }
+            vv[imax]=vv[j];
+        }
+        indx[j]=imax;
+        if (Aj[j]==0.0) return -1;
+        if (j!=n-1) {
+            tmp=1.0/Aj[j]; for (i=j+1;i<n;i++) Aj[i]*=tmp;
+        }
+    }
     return 0;
 }
 /* LU back-substitution ------------------------------------------------------*/
@@ -1372,22 +1632,74 @@ static void lubksb(const double *A, int n, const int *indx, double *b)
         s=b[i]; for (j=i+1;j<n;j++) s-=A[i+j*n]*b[j]; b[i]=s/A[i+i*n];
     }
 }
-/* inverse of matrix ---------------------------------------------------------*/
-extern int matinv(double *A, int n)
+/* LU back-substitution for all columns ---------------------------------------
+* solve A*X=P*I for all columns at once. X is stored transposed (Y(c,i)=X(i,c))
+* so each substitution step is an operation on a contiguous row of X.
+*-----------------------------------------------------------------------------*/
+static void lubksbm(const double *A, int n, const int *indx, double *Y)
 {
-    double d,*B;
-    int i,j,*indx;
+    double tmp;
+    int i,j,c;
 
-    indx=imat(n,1); B=mat(n,n); matcpy(B,A,n,n);
-    if (ludcmp(B,n,indx,&d)) {free(indx); free(B); return -1;}
-    for (j=0;j<n;j++) {
-        for (i=0;i<n;i++) A[i+j*n]=0.0;
-        A[j+j*n]=1.0;
-        lubksb(B,n,indx,A+j*n);
+    for (i=0;i<n*n;i++) Y[i]=0.0;
+    for (c=0;c<n;c++) Y[c+c*n]=1.0;
+    for (i=0;i<n;i++) {
+        if (indx[i]==i) continue;
+        for (c=0;c<n;c++) {
+            tmp=Y[c+i*n]; Y[c+i*n]=Y[c+indx[i]*n]; Y[c+indx[i]*n]=tmp;
+        }
+    }
+    for (i=0;i<n;i++) {
+        for (j=0;j<i;j++) axpym(n,A[i+j*n],Y+j*n,Y+i*n);
+    }
+    for (i=n-1;i>=0;i--) {
+        for (j=i+1;j<n;j++) axpym(n,A[i+j*n],Y+j*n,Y+i*n);
+        for (c=0;c<n;c++) Y[c+i*n]/=A[i+i*n];
     }
-    free(indx); free(B);
+}
+#define NMIN_BLK     8                 /* min size for column-wise LU */
+#define NWORK_INV(n) (2*(n)*(n)+(n))   /* size of work buffer for matinv_() */
+
+/* inverse of matrix with work buffers ---------------------------------------*/
+static int matinv_(double *A, int n, int *indx, double *work)
+{
+    double d,*B=work,*vv=work+n*n,*Y=work+n*n+n;
+    int i,j;
+
+    matcpy(B,A,n,n);
+    if (n<NMIN_BLK) { /* small matrix */
+        if (ludcmp(B,n,indx,&d,vv)) return -1;
+        for (j=0;j<n;j++) {
+            for (i=0;i<n;i++) A[i+j*n]=0.0;
+            A[j+j*n]=1.0;
+            lubksb(B,n,indx,A+j*n);
+        }
+        return 0;
+    }
+    if (ludcmpc(B,n,indx,vv)) return -1;
+    lubksbm(B,n,indx,Y);
+    for (j=0;j<n;j++) for (i=0;i<n;i++) A[i+j*n]=Y[j+i*n];
     return 0;
 }
+/* inverse of matrix ---------------------------------------------------------*/
+extern int matinv(double *A, int n)
+{
+    double *work=mat(NWORK_INV(n),1);
+    int info,*indx=imat(n,1);
+
+    info=matinv_(A,n,indx,work);
+    free(indx); free(work);
+    return info;
+}
+/* inverse of matrix with workspace -----------------------------------------*/
+extern int matinvw(double *A, int n, wsp_t *ws)
+{
+    int info,mark=wspmark(ws);
+
+    info=matinv_(A,n,wspimat(ws,n,1),wspmat(ws,NWORK_INV(n),1));
+    wsprelease(ws,mark);
+    return info;
+}
 /* solve linear equation -----------------------------------------------------*/
 extern int solve(const char *tr, const double *A, const double *Y, int n,
                  int m, double *X)
@@ -1432,49 +1744,175 @@ extern int lsq(const double *A, const double *y, int n, int m, double *x,
 /* kalman filter ---------------------------------------------------------------
 * kalman filter state update as follows:
 *
-*   K=P*H*(H'*P*H+R)^-1, xp=x+K*v, Pp=(I-K*H')*P
+*   K=P*H*(H'*P*H+R)^-1, xp=x+K*v, Pp=(I-K*H')*P*(I-K*H')'+K*R*K'
 *
-* args   : double *x        I   states vector (n x 1)
-*          double *P        I   covariance matrix of states (n x n)
+* args   : double *x        IO  states vector (n x 1)
+*          double *P        IO  covariance matrix of states (n x n)
 *          double *H        I   transpose of design matrix (n x m)
 *          double *v        I   innovation (measurement - model) (m x 1)
 *          double *R        I   covariance matrix of measurement error (m x m)
 *          int    n,m       I   number of states and measurements
-*          double *xp       O   states vector after update (n x 1)
-*          double *Pp       O   covariance matrix of states after update (n x n)
 * return : status (0:ok,<0:error)
 * notes  : matrix stored by column-major order (fortran convention)
 *          if state x[i]==0.0, not updates state x[i]/P[i+i*n]
+*          non-zero elements of H are indexed per measurement to form F=P*H
+*          and Q=H'*P*H+R. the Joseph form is evaluated as Pp=P-K*F'-D*K' with
+*          D=F-K*Q, which equals P-K*F'-F*K'+K*Q*K', only for the lower
+*          triangle and mirrored, so P is kept symmetric
+*          if Q cannot be inverted, x and P are not changed
 *-----------------------------------------------------------------------------*/
-static int filter_(const double *x, const double *P, const double *H,
-                   const double *v, const double *R, int n, int m,
-                   double *xp, double *Pp)
+static int filter_(double *x, double *P, const double *H, const double *v,
+                   const double *R, int n, int m, wsp_t *ws)
+{
+    double *F=wspmat(ws,n,m),*Q=wspmat(ws,m,m),*K=wspmat(ws,n,m);
+    double *D=wspmat(ws,n,m),*Qs=wspmat(ws,m,m),*work=wspmat(ws,NWORK_INV(m),1);
+    double *Fj,*Kj,*Dj,h,d;
+    int i,j,k,l,info,*ipiv=wspimat(ws,m,1),*ih=wspimat(ws,n,m);
+    int *nh=wspimat(ws,m+1,1);
+
+    /* index list of non-zero elements of H for each measurement */
+    for (j=l=0;j<m;j++) {
+        nh[j]=l;
+        for (i=0;i<n;i++) if (H[i+j*n]!=0.0) ih[l++]=i;
+    }
+    nh[m]=l;
+
+    /* F=P*H */
+    for (j=0;j<m;j++) {
+        Fj=F+j*n;
+        for (i=0;i<n;i++) Fj[i]=0.0;
+        for (l=nh[j];l<nh[j+1];l++) {
+            k=ih[l]; h=H[k+j*n];
+            for (i=0;i<n;i++) Fj[i]+=P[i+k*n]*h;
+        }
+    }
+    /* Q=H'*P*H+R */
+    for (j=0;j<m;j++) for (i=0;i<=j;i++) {
+        for (l=nh[i],d=R[i+j*m];l<nh[i+1];l++) d+=H[ih[l]+i*n]*F[ih[l]+j*n];
+        Q[i+j*m]=Q[j+i*m]=d;
+    }
+    matcpy(Qs,Q,m,m);
+    if ((info=matinv_(Q,m,ipiv,work))) return info;
+
+    matmul("NN",n,m,m,F,Q,K);   /* K=P*H*Q^-1 */
+    matmulp("NN",n,1,m,K,v,x);  /* xp=x+K*v */
+    matcpy(D,F,n,m);
+    matmulm("NN",n,m,m,K,Qs,D); /* D=F-K*Q */
+
+    /* Pp=P-K*F'-D*K' with D=F-K*Q (lower triangle) */
+    for (l=0;l<m;l++) {
+        Kj=K+l*n; Fj=F+l*n; Dj=D+l*n;
+        for (j=0;j<n;j++) {
+            h=Fj[j]; d=Kj[j];
+            for (i=j;i<n;i++) P[i+j*n]-=Kj[i]*h+Dj[i]*d;
+        }
+    }
+    for (j=0;j<n;j++) for (i=j+1;i<n;i++) P[j+i*n]=P[i+j*n];
+    return 0;
+}
+extern int filter(double *x, double *P, const double *H, const double *v,
+                  const double *R, int n, int m)
 {
-    double *F=mat(n,m),*Q=mat(m,m),*K=mat(n,m),*I=eye(n);
+    wsp_t ws={0};
     int info;
 
-    matcpy(Q,R,m,m);
-    matcpy(xp,x,n,1);
-    matmul("NN",n,m,n,P,H,F);       /* Q=H'*P*H+R */
-    matmulp("TN",m,m,n,H,F,Q);
-    if (!(info=matinv(Q,m))) {
-        matmul("NN",n,m,m,F,Q,K);   /* K=P*H*Q^-1 */
-        matmulp("NN",n,1,m,K,v,xp);  /* xp=x+K*v */
-        matmulm("NT",n,n,m,K,H,I);  /* Pp=(I-K*H')*P */
-        matmul("NN",n,n,n,I,P,Pp);
-    }
-    free(F); free(Q); free(K); free(I);
+    info=filterw(x,P,H,v,R,n,m,&ws);
+    wspfree(&ws);
     return info;
 }
-extern int filter(double *x, double *P, const double *H, const double *v,
-                  const double *R, int n, int m)
+/* cholesky decomposition of profile matrix -----------------------------------
+* A=L*L' exploiting the profile (leading zeros of each row) of A, so a block
+* diagonal A is factorized block by block. s[i] is the first non-zero column
+* of row i of both A and L. L should be zero-initialized.
+*-----------------------------------------------------------------------------*/
+static int cholprof(const double *A, int n, int *s, double *L)
 {
-    double *x_,*xp_,*P_,*Pp_,*H_;
-    int i,j,k,info,*ix;
+    double d;
+    int i,j,k;
+
+    for (i=0;i<n;i++) {
+        for (s[i]=0;s[i]<i&&A[i+s[i]*n]==0.0;s[i]++) ;
+        for (j=s[i];j<=i;j++) {
+            d=A[i+j*n];
+            for (k=s[i]>s[j]?s[i]:s[j];k<j;k++) d-=L[i+k*n]*L[j+k*n];
+            if (j<i) L[i+j*n]=d/L[j+j*n];
+            else if (d>0.0) L[i+i*n]=sqrt(d);
+            else return -1;
+        }
+    }
+    return 0;
+}
+/* sequential kalman filter ----------------------------------------------------
+* the measurements are decorrelated by the cholesky factor of R (R=L*L',
+* H~=H*L'^-1, v~=L^-1*v) and applied one at a time by rank-1 updates:
+*
+*   f=P*h, q=h'*f+1, xp=x+f*(v~-h'*(xp-x))/q, Pp=P-f*f'/q
+*
+* without inversion of the innovation covariance. the result equals to the
+* batch update for linearized measurements.
+*-----------------------------------------------------------------------------*/
+static int filterseq_(double *x, double *P, const double *H, const double *v,
+                      const double *R, int n, int m, wsp_t *ws)
+{
+    double *L=wspzeros(ws,m,m),*G=wspmat(ws,n,m),*w=wspmat(ws,m,1);
+    double *dx=wspzeros(ws,n,1),*f=wspmat(ws,n,1),*g,q,y,c;
+    int i,j,k,l,nz,*s=wspimat(ws,m,1),*ih=wspimat(ws,n,1);
+
+    if (cholprof(R,m,s,L)) {
+        trace(2,"filterseq: measurement covariance not positive definite\n");
+        return -1;
+    }
+    /* decorrelate measurements: G=H*L'^-1, w=L^-1*v */
+    for (j=0;j<m;j++) {
+        g=G+j*n;
+        for (i=0;i<n;i++) g[i]=H[i+j*n];
+        w[j]=v[j];
+        for (k=s[j];k<j;k++) {
+            if ((c=L[j+k*m])==0.0) continue;
+            for (i=0;i<n;i++) g[i]-=c*G[i+k*n];
+            w[j]-=c*w[k];
+        }
+        for (i=0;i<n;i++) g[i]/=L[j+j*m];
+        w[j]/=L[j+j*m];
+    }
+    /* scalar measurement updates */
+    for (j=0;j<m;j++) {
+        g=G+j*n;
+        for (i=nz=0;i<n;i++) if (g[i]!=0.0) ih[nz++]=i;
+        for (i=0;i<n;i++) f[i]=0.0;
+        for (l=0;l<nz;l++) {
+            k=ih[l];
+            for (i=0;i<n;i++) f[i]+=P[i+k*n]*g[k];
+        }
+        for (l=0,q=1.0,y=w[j];l<nz;l++) {
+            q+=g[ih[l]]*f[ih[l]];
+            y-=g[ih[l]]*dx[ih[l]];
+        }
+        if (q<=0.0) return -1;
+
+        /* normalized innovation for measurement test */
+        trace(5,"filterseq: j=%3d inno=%10.4f sig=%8.4f ninno=%8.3f\n",j,y,
+              sqrt(q),y/sqrt(q));
+
+        for (i=0;i<n;i++) dx[i]+=f[i]*y/q;
+        for (k=0,c=1.0/q;k<n;k++) {
+            if (f[k]==0.0) continue;
+            for (i=0;i<n;i++) P[i+k*n]-=f[i]*f[k]*c;
+        }
+    }
+    for (i=0;i<n;i++) x[i]+=dx[i];
+    return 0;
+}
+/* kalman filter on compressed states ----------------------------------------*/
+static int filtcmp(double *x, double *P, const double *H, const double *v,
+                   const double *R, int n, int m, int seq, wsp_t *ws)
+{
+    double *x_,*P_,*H_;
+    int i,j,k,info,*ix,mark=wspmark(ws);
 
     /* create list of non-zero states */
-    ix=imat(n,1); for (i=k=0;i<n;i++) if (x[i]!=0.0&&P[i+i*n]>0.0) ix[k++]=i;
-    x_=mat(k,1); xp_=mat(k,1); P_=mat(k,k); Pp_=mat(k,k); H_=mat(k,m);
+    ix=wspimat(ws,n,1); for (i=k=0;i<n;i++) if (x[i]!=0.0&&P[i+i*n]>0.0) ix[k++]=i;
+    x_=wspmat(ws,k,1); P_=wspmat(ws,k,k); H_=wspmat(ws,k,m);
     /* compress array by removing zero elements to save computation time */
     for (i=0;i<k;i++) {
         x_[i]=x[ix[i]];
@@ -1482,15 +1920,66 @@ extern int filter(double *x, double *P, const double *H, const double *v,
         for (j=0;j<m;j++) H_[i+j*k]=H[ix[i]+j*n];
     }
     /* do kalman filter state update on compressed arrays */
-    info=filter_(x_,P_,H_,v,R,k,m,xp_,Pp_);
-    /* copy values from compressed arrays back to full arrays */
-    for (i=0;i<k;i++) {
-        x[ix[i]]=xp_[i];
-        for (j=0;j<k;j++) P[ix[i]+ix[j]*n]=Pp_[i+j*k];
+    if (seq) info=filterseq_(x_,P_,H_,v,R,k,m,ws);
+    else     info=filter_   (x_,P_,H_,v,R,k,m,ws);
+
+    if (!info) {
+        /* copy values from compressed arrays back to full arrays */
+        for (i=0;i<k;i++) {
+            x[ix[i]]=x_[i];
+            for (j=0;j<k;j++) P[ix[i]+ix[j]*n]=P_[i+j*k];
+        }
     }
-    free(ix); free(x_); free(xp_); free(P_); free(Pp_); free(H_);
+    wsprelease(ws,mark);
     return info;
 }
+/* kalman filter with workspace ------------------------------------------------
+* kalman filter state update same as filter() but the temporary matrices are
+* allocated in the workspace
+* args   : double *x,*P,*H,*v,*R,n,m  IO  same as filter()
+*          wsp_t  *ws       IO  workspace
+* return : status (0:ok,<0:error)
+*-----------------------------------------------------------------------------*/
+extern int filterw(double *x, double *P, const double *H, const double *v,
+                   const double *R, int n, int m, wsp_t *ws)
+{
+    return filtcmp(x,P,H,v,R,n,m,0,ws);
+}
+/* kalman filter on compact states --------------------------------------------
+* kalman filter state update same as filterw() or filterseq() but without
+* compression of the states. all the states should be active (x!=0, P(i,i)>0)
+* args   : double *x,*P,*H,*v,*R,n,m  IO  same as filter()
+*          int    seq       I   sequential update (0:off,1:on)
+*          wsp_t  *ws       IO  workspace
+* return : status (0:ok,<0:error)
+*-----------------------------------------------------------------------------*/
+extern int filterc(double *x, double *P, const double *H, const double *v,
+                   const double *R, int n, int m, int seq, wsp_t *ws)
+{
+    int info,mark=wspmark(ws);
+
+    if (seq) info=filterseq_(x,P,H,v,R,n,m,ws);
+    else     info=filter_   (x,P,H,v,R,n,m,ws);
+
+    wsprelease(ws,mark);
+    return info;
+}
+/* sequential kalman filter ----------------------------------------------------
+* kalman filter state update by sequential processing of measurements. the
+* measurements are decorrelated by cholesky factor of R and applied one by one
+* as rank-1 updates, so no inversion of the innovation covariance is needed
+* args   : double *x,*P,*H,*v,*R,n,m  IO  same as filter()
+*          wsp_t  *ws       IO  workspace
+* return : status (0:ok,<0:error)
+* notes  : R should be positive definite. a block diagonal R (e.g. double-
+*          differenced measurements grouped by system and frequency) is
+*          factorized block by block
+*-----------------------------------------------------------------------------*/
+extern int filterseq(double *x, double *P, const double *H, const double *v,
+                     const double *R, int n, int m, wsp_t *ws)
+{
+    return filtcmp(x,P,H,v,R,n,m,1,ws);
+}
 /* smoother --------------------------------------------------------------------
 * combine forward and backward filters by fixed-interval smoother as follows:
 *
@@ -1548,6 +2037,74 @@ extern void matprint(const double A[], int n, int m, int p, int q)
 {
     matfprint(A,n,m,p,q,stdout);
 }
+/* decimal string to number ---------------------------------------------------
+* convert decimal string to number by integer mantissa and power of 10. the
+* result is exact (same as strtod()) if mantissa <= 2^53 and |exponent| <= 22.
+* args   : char   *s        I   string
+*          int    n         I   max width
+*          int    dexp      I   accept 'd' or 'D' as exponent letter (0:no,1:yes)
+*          double *value    O   converted number
+* return : end of number in string (NULL: not converted, use strtod())
+*-----------------------------------------------------------------------------*/
+static const char *str2dec(const char *s, int n, int dexp, double *value)
+{
+    static const double pow10[]={
+        1E0,1E1,1E2,1E3,1E4,1E5,1E6,1E7,1E8,1E9,1E10,1E11,1E12,1E13,1E14,1E15,
+        1E16,1E17,1E18,1E19,1E20,1E21,1E22
+    };
+    uint64_t mant=0;
+    int i=0,j,sgn=0,esgn=0,nd=0,ns=0,dot=0,exp=0,e=0;
+    char c;
+
+    while (i<n&&(s[i]==' '||('\t'<=s[i]&&s[i]<='\r'))) i++;
+
+    if (i>=n||!s[i]) { /* blank */
+        *value=0.0;
+        return s;
+    }
+    if (s[i]=='+'||s[i]=='-') sgn=s[i++]=='-';
+
+    for (;i<n;i++) {
+        c=s[i];
+        if ('0'<=c&&c<='9') {
+            if (mant||c!='0') {
+                if (++ns>19) return NULL; /* overflow of mantissa */
+                mant=mant*10+(uint64_t)(c-'0');
+            }
+            if (dot) exp--;
+            nd++;
+        }
+        else if (c=='.'&&!dot) dot=1;
+        else break;
+    }
+    if (nd<=0) return NULL; /* no digit, inf or nan */
+
+    if (i<n&&(s[i]=='x'||s[i]=='X')) return NULL; /* hexadecimal */
+
+    /* exponent */
+    if (i<n&&(s[i]=='e'||s[i]=='E'||(dexp&&(s[i]=='d'||s[i]=='D')))) {
+        j=i+1;
+        if (j<n&&(s[j]=='+'||s[j]=='-')) esgn=s[j++]=='-';
+        if (j<n&&'0'<=s[j]&&s[j]<='9') {
+            for (;j<n&&'0'<=s[j]&&s[j]<='9';j++) {
+                if (e<10000) e=e*10+(s[j]-'0');
+            }
+            exp+=esgn?-e:e;
+            i=j;
+        }
+    }
+    if (!mant) {
+        *value=sgn?-0.0:0.0;
+    }
+    else if (mant>((uint64_t)1<<53)||exp<-22||exp>22) {
+        return NULL;
+    }
+    else {
+        *value=exp<0?(double)mant/pow10[-exp]:(double)mant*pow10[exp];
+        if (sgn) *value=-*value;
+    }
+    return s+i;
+}
 /* string to number ------------------------------------------------------------
 * convert substring in string to number
 * args   : char   *s        I   string ("... nnn.nnn ...")
@@ -1556,12 +2113,14 @@ extern void matprint(const double A[], int n, int m, int p, int q)
 *-----------------------------------------------------------------------------*/
 extern double str2num(const char *s, int i, int n)
 {
+    double value;
     char str[256],*p=str;
 
     if (i<0||(int)sizeof(str)-1<n) return 0.0;
-    /* Special case i==0, skipping the strlen check.
-     * Note: Could usefully use strnlen(s,i) here */
-    if (i>0&&(int)strlen(s)<i) return 0.0;
+    /* Special case i==0, skipping the length check */
+    if (i>0&&memchr(s,'\0',i)) return 0.0;
+
+    if (str2dec(s+i,n,1,&value)) return value;
 
     for (s+=i;--n>=0;s++) {
         char c=*s;
@@ -1571,6 +2130,21 @@ extern double str2num(const char *s, int i, int n)
     *p='\0';
     return strtod(str,NULL);
 }
+/* string to double ------------------------------------------------------------
+* convert string to number, same as strtod() but faster for decimal numbers
+* args   : char   *s        I   string
+*          char   **end     O   end of number in string (NULL: no output)
+* return : converted number
+*-----------------------------------------------------------------------------*/
+extern double str2dbl(const char *s, char **end)
+{
+    const char *p;
+    double value;
+
+    if (!(p=str2dec(s,INT_MAX,0,&value))) return strtod(s,end);
+    if (end) *end=(char *)p;
+    return value;
+}
 /* string to time --------------------------------------------------------------
 * convert substring in string to gtime_t struct
 * args   : char   *s        I   string ("... yyyy mm dd hh mm ss ...")
@@ -1990,10 +2564,11 @@ extern void time2str(gtime_t t, char *s, int n)
 *          int    n         I   number of decimals
 * return : time string
 * notes  : not reentrant, do not use multiple in a function
+*          the string buffer is allocated per thread
 *-----------------------------------------------------------------------------*/
 extern char *time_str(gtime_t t, int n)
 {
-    static char buff[64];
+    static rtklib_tls char buff[64];
     time2str(t,buff,n);
     return buff;
 }
@@ -2058,14 +2633,181 @@ extern uint32_t tickget(void)
 extern void sleepms(int ms)
 {
 #ifdef WIN32
-    if (ms<5) Sleep(1); else Sleep(ms);
+    if (ms<5) Sleep(1); else Sleep(ms);
+#else
+    struct timespec ts;
+    if (ms<=0) return;
+    ts.tv_sec=(time_t)(ms/1000);
+    ts.tv_nsec=(long)(ms%1000*1000000);
+    nanosleep(&ts,NULL);
+#endif
+}
+#define MINEXECITEM 4                   /* min number of items per range */
+
+/* execute items of range ----------------------------------------------------*/
+static void execrng(execpool_t *pool, int k)
+{
+    int i,i0=pool->n*k/pool->nrng,i1=pool->n*(k+1)/pool->nrng;
+
+    for (i=i0;i<i1;i++) pool->func(pool->arg,i);
+}
+/* execute ranges of tasks (worker thread) -----------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI execthread(void *arg)
+#else
+static void *execthread(void *arg)
+#endif
+{
+    execpool_t *pool=(execpool_t *)arg;
+    uint32_t seq;
+    int k;
+
+    rtklib_lock(&pool->lock);
+    seq=pool->seq;
+
+    while (!pool->stop) {
+        if (pool->seq==seq) {
+            rtklib_condwait(&pool->start,&pool->lock);
+            continue;
+        }
+        seq=pool->seq;
+
+        while (pool->next<pool->nrng) {
+            k=pool->next++;
+            rtklib_unlock(&pool->lock);
+            execrng(pool,k);
+            rtklib_lock(&pool->lock);
+            if (++pool->ndone==pool->nrng-1) rtklib_condbroadcast(&pool->done);
+        }
+    }
+    rtklib_unlock(&pool->lock);
+    return 0;
+}
+/* new thread pool -------------------------------------------------------------
+* create thread pool for parexec()
+* args   : int    nthr      I   number of threads including caller (0,1: none)
+* return : thread pool (NULL: no thread or error)
+* notes  : the worker threads wait for tasks of parexec() until the pool is
+*          freed by freeexecpool(). one pool should be used by one caller
+*          thread at a time, e.g. owned by a processing context (rtk_t).
+*-----------------------------------------------------------------------------*/
+extern execpool_t *newexecpool(int nthr)
+{
+    execpool_t *pool;
+    int i;
+
+    trace(3,"newexecpool: nthr=%d\n",nthr);
+
+    if (nthr>MAXEXECTHR) nthr=MAXEXECTHR;
+    if (nthr<2) return NULL;
+
+    if (!(pool=(execpool_t *)calloc(1,sizeof(execpool_t)))) {
+        trace(1,"newexecpool: malloc error\n");
+        return NULL;
+    }
+    rtklib_initlock(&pool->lock);
+    rtklib_initcond(&pool->start);
+    rtklib_initcond(&pool->done);
+
+    for (i=0;i<nthr-1;i++) {
+#ifdef WIN32
+        if (!(pool->thread[i]=CreateThread(NULL,0,execthread,pool,0,NULL))) break;
+#else
+        if (pthread_create(pool->thread+i,NULL,execthread,pool)) break;
+#endif
+    }
+    pool->nthr=i;
+    if (pool->nthr<nthr-1) {
+        trace(2,"newexecpool: thread create error nthr=%d\n",pool->nthr+1);
+    }
+    if (pool->nthr<=0) {
+        freeexecpool(pool);
+        return NULL;
+    }
+    return pool;
+}
+/* free thread pool ------------------------------------------------------------
+* stop worker threads and free thread pool created by newexecpool()
+* args   : execpool_t *pool IO  thread pool (NULL: none)
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void freeexecpool(execpool_t *pool)
+{
+    int i;
+
+    if (!pool) return;
+
+    trace(3,"freeexecpool: nthr=%d\n",pool->nthr);
+
+    rtklib_lock(&pool->lock);
+    pool->stop=1;
+    rtklib_condbroadcast(&pool->start);
+    rtklib_unlock(&pool->lock);
+
+    for (i=0;i<pool->nthr;i++) {
+#ifdef WIN32
+        WaitForSingleObject(pool->thread[i],INFINITE);
+        CloseHandle(pool->thread[i]);
 #else
-    struct timespec ts;
-    if (ms<=0) return;
-    ts.tv_sec=(time_t)(ms/1000);
-    ts.tv_nsec=(long)(ms%1000*1000000);
-    nanosleep(&ts,NULL);
+        pthread_join(pool->thread[i],NULL);
 #endif
+    }
+    rtklib_destroycond(&pool->start);
+    rtklib_destroycond(&pool->done);
+    rtklib_destroylock(&pool->lock);
+    free(pool);
+}
+/* execute function for items in parallel --------------------------------------
+* execute func(arg,i) for i=0,...,n-1 by worker threads of thread pool
+* args   : execpool_t *pool IO  thread pool (NULL: no thread)
+*          int    n         I   number of items
+*          void   (*func)(void *, int) I function for item i
+*          void   *arg      I   argument of function
+* return : none
+* notes  : the items are split into contiguous ranges, one per thread, only if
+*          every range gets MINEXECITEM items or more. the caller thread
+*          executes the first range and then takes the ranges not yet taken
+*          by the worker threads, so the call does not wait for the wake-up
+*          of idle workers.
+*          func(arg,i) should write only outputs owned by item i, then the
+*          results do not depend on the number of threads.
+*-----------------------------------------------------------------------------*/
+extern void parexec(execpool_t *pool, int n, void (*func)(void *, int),
+                    void *arg)
+{
+    int i,k,nrng=pool?pool->nthr+1:0;
+
+    if (nrng>n/MINEXECITEM) nrng=n/MINEXECITEM;
+
+    if (nrng<2) {
+        for (i=0;i<n;i++) func(arg,i);
+        return;
+    }
+    rtklib_lock(&pool->lock);
+    pool->func=func;
+    pool->arg=arg;
+    pool->n=n;
+    pool->nrng=nrng;
+    pool->next=1;
+    pool->ndone=0;
+    pool->seq++;
+    rtklib_condbroadcast(&pool->start);
+    rtklib_unlock(&pool->lock);
+
+    execrng(pool,0);
+
+    rtklib_lock(&pool->lock);
+    while (pool->next<pool->nrng) {
+        k=pool->next++;
+        rtklib_unlock(&pool->lock);
+        execrng(pool,k);
+        rtklib_lock(&pool->lock);
+        pool->ndone++;
+    }
+    while (pool->ndone<pool->nrng-1) {
+        rtklib_condwait(&pool->done,&pool->lock);
+    }
+    rtklib_unlock(&pool->lock);
 }
 /* convert degree to deg-min-sec -----------------------------------------------
 * convert degree to degree-minute-second
@@ -2381,13 +3123,13 @@ static void nut_iau1980(double t, const double *f, double *dpsi, double *deps)
 *                               (NULL: no output)
 * return : none
 * note   : see ref [3] chap 5
-*          not thread-safe
+*          the cache of the last result is kept per thread
 *-----------------------------------------------------------------------------*/
 extern void eci2ecef(gtime_t tutc, const double *erpv, double *U, double *gmst)
 {
     const double ep2000[]={2000,1,1,12,0,0};
-    static gtime_t tutc_;
-    static double U_[9],gmst_;
+    static rtklib_tls gtime_t tutc_;
+    static rtklib_tls double U_[9],gmst_;
     gtime_t tgps;
     double eps,ze,th,z,t,t2,t3,dpsi,deps,gast,f[5];
     double R1[9],R2[9],R3[9],R[9],W[9],N[9],P[9],NP[9];
@@ -2977,7 +3719,8 @@ static void uniqseph(nav_t *nav)
     trace(4,"uniqseph: ns=%d\n",nav->ns);
 }
 /* unique ephemerides ----------------------------------------------------------
-* unique ephemerides in navigation data and update carrier wave length
+* unique ephemerides in navigation data and update carrier wave length.
+* the ephemerides are indexed by indexnav() after unique.
 * args   : nav_t *nav    IO     navigation data
 * return : number of epochs
 *-----------------------------------------------------------------------------*/
@@ -2989,6 +3732,152 @@ extern void uniqnav(nav_t *nav)
     uniqeph (nav);
     uniqgeph(nav);
     uniqseph(nav);
+
+    /* index ephemeris by satellite and toe */
+    indexnav(nav);
+}
+/* compare ephemeris index entries -------------------------------------------*/
+typedef struct {        /* ephemeris index entry type */
+    int sat;            /* satellite number */
+    int i;              /* ephemeris index */
+    gtime_t toe;        /* toe */
+} idxent_t;
+
+static int cmpidx(const void *p1, const void *p2)
+{
+    idxent_t *q1=(idxent_t *)p1,*q2=(idxent_t *)p2;
+    if (q1->sat!=q2->sat) return q1->sat-q2->sat;
+    if (q1->toe.time!=q2->toe.time) return q1->toe.time<q2->toe.time?-1:1;
+    if (q1->toe.sec !=q2->toe.sec ) return q1->toe.sec <q2->toe.sec ?-1:1;
+    return q1->i-q2->i;
+}
+/* build ephemeris index -----------------------------------------------------*/
+static int setidx(navidx_t *ix, const void *eph, idxent_t *ent, int n)
+{
+    int *idx,i,j;
+    gtime_t *toe;
+
+    if (n>ix->nmax) {
+        if (!(idx=(int *)realloc(ix->idx,sizeof(int)*n))) return 0;
+        ix->idx=idx;
+        if (!(toe=(gtime_t *)realloc(ix->toe,sizeof(gtime_t)*n))) return 0;
+        ix->toe=toe;
+        ix->nmax=n;
+    }
+    qsort(ent,n,sizeof(idxent_t),cmpidx);
+
+    for (i=0;i<=MAXSAT;i++) ix->off[i]=0;
+    for (i=j=0;i<n;i++) {
+        if (ent[i].sat<1||ent[i].sat>MAXSAT) continue;
+        ix->idx[j]=ent[i].i;
+        ix->toe[j++]=ent[i].toe;
+        ix->off[ent[i].sat]++;
+    }
+    for (i=1;i<=MAXSAT;i++) ix->off[i]+=ix->off[i-1];
+    ix->eph=eph;
+    ix->n=n;
+    return 1;
+}
+/* index ephemerides -----------------------------------------------------------
+* index broadcast ephemerides in navigation data by satellite and toe for
+* the ephemeris selection in satellite position computation
+* args   : nav_t *nav    IO     navigation data
+* return : none
+* notes  : the index is valid as long as the ephemeris arrays, numbers and
+*          the update count nav->nver are not changed. functions replacing
+*          ephemerides in place increment nav->nver, which invalidates the
+*          index until indexnav() is called again. without a valid index, the
+*          ephemeris selection falls back to the linear search.
+*-----------------------------------------------------------------------------*/
+extern void indexnav(nav_t *nav)
+{
+    idxent_t *ent;
+    int i,n=nav->n;
+
+    if (nav->ng>n) n=nav->ng;
+    if (nav->ns>n) n=nav->ns;
+
+    trace(3,"indexnav: neph=%d ngeph=%d nseph=%d\n",nav->n,nav->ng,nav->ns);
+
+    nav->ieph.eph=nav->igeph.eph=nav->iseph.eph=NULL;
+    nav->ieph.ver=nav->igeph.ver=nav->iseph.ver=nav->nver;
+
+    if (n<=0) return;
+
+    if (!(ent=(idxent_t *)malloc(sizeof(idxent_t)*n))) {
+        trace(1,"indexnav: malloc error n=%d\n",n);
+        return;
+    }
+    for (i=0;i<nav->n;i++) {
+        ent[i].sat=nav->eph[i].sat; ent[i].i=i; ent[i].toe=nav->eph[i].toe;
+    }
+    if (!setidx(&nav->ieph,nav->eph,ent,nav->n)) {
+        trace(1,"indexnav: malloc error n=%d\n",nav->n);
+    }
+    for (i=0;i<nav->ng;i++) {
+        ent[i].sat=nav->geph[i].sat; ent[i].i=i; ent[i].toe=nav->geph[i].toe;
+    }
+    if (!setidx(&nav->igeph,nav->geph,ent,nav->ng)) {
+        trace(1,"indexnav: malloc error ng=%d\n",nav->ng);
+    }
+    for (i=0;i<nav->ns;i++) {
+        ent[i].sat=nav->seph[i].sat; ent[i].i=i; ent[i].toe=nav->seph[i].t0;
+    }
+    if (!setidx(&nav->iseph,nav->seph,ent,nav->ns)) {
+        trace(1,"indexnav: malloc error ns=%d\n",nav->ns);
+    }
+    free(ent);
+}
+/* free ephemeris index -----------------------------------------------------*/
+static void freeidx(navidx_t *ix)
+{
+    free(ix->idx); ix->idx=NULL;
+    free(ix->toe); ix->toe=NULL;
+    ix->eph=NULL; ix->n=ix->nmax=0;
+}
+/* free ephemeris index --------------------------------------------------------
+* free ephemeris index in navigation data
+* args   : nav_t *nav    IO     navigation data
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void freenavidx(nav_t *nav)
+{
+    freeidx(&nav->ieph);
+    freeidx(&nav->igeph);
+    freeidx(&nav->iseph);
+}
+/* free chebyshev coefficients of precise ephemeris ----------------------------
+* free coefficients of precise ephemeris fitted by pephcoef()
+* args   : nav_t *nav    IO     navigation data
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void freepephc(nav_t *nav)
+{
+    pephc_t pc0={0};
+
+    free(nav->pephc.tc);
+    free(nav->pephc.tw);
+    free(nav->pephc.off);
+    free(nav->pephc.coef);
+    nav->pephc=pc0;
+}
+/* free compact precise ephemeris ----------------------------------------------
+* free precise ephemeris stored in nav->pephs by readsp3()
+* args   : nav_t *nav    IO     navigation data
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void freepephs(nav_t *nav)
+{
+    pephs_t ps0={0};
+    int i;
+
+    for (i=0;i<MAXSAT;i++) {
+        free(nav->pephs.pos[i]);
+        free(nav->pephs.std[i]);
+    }
+    free(nav->pephs.time);
+    free(nav->pephs.index);
+    nav->pephs=ps0;
 }
 /* compare observation data -------------------------------------------------*/
 static int cmpobs(const void *p1, const void *p2)
@@ -3064,6 +3953,8 @@ extern int readnav(const char *file, nav_t *nav)
 
     if (!(fp=fopen(file,"r"))) return 0;
 
+    nav->nver++; /* invalidate ephemeris index */
+
     while (fgets(buff,sizeof(buff),fp)) {
         if (!strncmp(buff,"IONUTC",6)) {
             for (i=0;i<8;i++) nav->ion_gps[i]=0.0;
@@ -3191,7 +4082,12 @@ extern void freenav(nav_t *nav, int opt)
     if (opt&0x01) {free(nav->eph ); nav->eph =NULL; nav->n =nav->nmax =0;}
     if (opt&0x02) {free(nav->geph); nav->geph=NULL; nav->ng=nav->ngmax=0;}
     if (opt&0x04) {free(nav->seph); nav->seph=NULL; nav->ns=nav->nsmax=0;}
+    if (opt&0x01) freeidx(&nav->ieph );
+    if (opt&0x02) freeidx(&nav->igeph);
+    if (opt&0x04) freeidx(&nav->iseph);
     if (opt&0x08) {free(nav->peph); nav->peph=NULL; nav->ne=nav->nemax=0;}
+    if (opt&0x08) freepephc(nav);
+    if (opt&0x08) freepephs(nav);
     if (opt&0x10) {free(nav->pclk); nav->pclk=NULL; nav->nc=nav->ncmax=0;}
     if (opt&0x20) {free(nav->alm ); nav->alm =NULL; nav->na=nav->namax=0;}
     if (opt&0x40) {free(nav->tec ); nav->tec =NULL; nav->nt=nav->ntmax=0;}
@@ -3560,26 +4456,15 @@ extern void dops(int ns, const double *azel, double elmin, double *dop)
         dop[3]=SQRT(Q[10]);                 /* VDOP */
     }
 }
-/* ionosphere model ------------------------------------------------------------
-* compute ionospheric delay by broadcast ionosphere model (klobuchar model)
-* args   : gtime_t t        I   time (gpst)
-*          double *ion      I   iono model parameters {a0,a1,a2,a3,b0,b1,b2,b3}
-*          double *pos      I   receiver position {lat,lon,h} (rad,m)
-*          double *azel     I   azimuth/elevation angle {az,el} (rad)
-* return : ionospheric delay (L1) (m)
-*-----------------------------------------------------------------------------*/
-extern double ionmodel(gtime_t t, const double *ion, const double *pos,
-                       const double *azel)
+static const double ion_default[]={ /* 2004/1/1 */
+    0.1118E-07,-0.7451E-08,-0.5961E-07, 0.1192E-06,
+    0.1167E+06,-0.2294E+06,-0.1311E+06, 0.1049E+07
+};
+/* klobuchar model for time of week (s) --------------------------------------*/
+static double klobuchar(double tow, const double *ion, const double *pos,
+                        const double *azel)
 {
-    const double ion_default[]={ /* 2004/1/1 */
-        0.1118E-07,-0.7451E-08,-0.5961E-07, 0.1192E-06,
-        0.1167E+06,-0.2294E+06,-0.1311E+06, 0.1049E+07
-    };
     double tt,f,psi,phi,lam,amp,per,x;
-    int week;
-
-    if (pos[2]<-1E3||azel[1]<=0) return 0.0;
-    if (norm(ion,8)<=0.0) ion=ion_default;
 
     /* earth centered angle (semi-circle) */
     psi=0.0137/(azel[1]/PI+0.11)-0.022;
@@ -3594,7 +4479,7 @@ extern double ionmodel(gtime_t t, const double *ion, const double *pos,
     phi+=0.064*cos((lam-1.617)*PI);
 
     /* local time (s) */
-    tt=43200.0*lam+time2gpst(t,&week);
+    tt=43200.0*lam+tow;
     tt-=floor(tt/86400.0)*86400.0; /* 0<=tt<86400 */
 
     /* slant factor */
@@ -3609,6 +4494,53 @@ extern double ionmodel(gtime_t t, const double *ion, const double *pos,
 
     return CLIGHT*f*(fabs(x)<1.57?5E-9+amp*(1.0+x*x*(-0.5+x*x/24.0)):5E-9);
 }
+/* ionosphere model ------------------------------------------------------------
+* compute ionospheric delay by broadcast ionosphere model (klobuchar model)
+* args   : gtime_t t        I   time (gpst)
+*          double *ion      I   iono model parameters {a0,a1,a2,a3,b0,b1,b2,b3}
+*          double *pos      I   receiver position {lat,lon,h} (rad,m)
+*          double *azel     I   azimuth/elevation angle {az,el} (rad)
+* return : ionospheric delay (L1) (m)
+*-----------------------------------------------------------------------------*/
+extern double ionmodel(gtime_t t, const double *ion, const double *pos,
+                       const double *azel)
+{
+    int week;
+
+    if (pos[2]<-1E3||azel[1]<=0) return 0.0;
+    if (norm(ion,8)<=0.0) ion=ion_default;
+
+    return klobuchar(time2gpst(t,&week),ion,pos,azel);
+}
+/* ionosphere model for satellites ---------------------------------------------
+* compute ionospheric delays of satellites by broadcast ionosphere model
+* args   : gtime_t t        I   time (gpst)
+*          double *ion      I   iono model parameters {a0,a1,a2,a3,b0,b1,b2,b3}
+*          double *pos      I   receiver position {lat,lon,h} (rad,m)
+*          double *azel     I   azimuth/elevation angles {az,el,...} (rad)
+*          int    n         I   number of satellites
+*          double *dion     O   ionospheric delays (L1) (m) {dion1,...}
+* return : none
+* notes  : same as ionmodel() for each satellite with station terms computed
+*          once
+*-----------------------------------------------------------------------------*/
+extern void ionmodels(gtime_t t, const double *ion, const double *pos,
+                      const double *azel, int n, double *dion)
+{
+    double tow;
+    int i,week;
+
+    if (pos[2]<-1E3) {
+        for (i=0;i<n;i++) dion[i]=0.0;
+        return;
+    }
+    if (norm(ion,8)<=0.0) ion=ion_default;
+    tow=time2gpst(t,&week);
+
+    for (i=0;i<n;i++) {
+        dion[i]=azel[1+i*2]<=0?0.0:klobuchar(tow,ion,pos,azel+i*2);
+    }
+}
 /* ionosphere mapping function -------------------------------------------------
 * compute ionospheric delay mapping function by single layer model
 * args   : double *pos      I   receiver position {lat,lon,h} (rad,m)
@@ -3620,6 +4552,23 @@ extern double ionmapf(const double *pos, const double *azel)
     if (pos[2]>=HION) return 1.0;
     return 1.0/cos(asin((RE_WGS84+pos[2])/(RE_WGS84+HION)*sin(PI/2.0-azel[1])));
 }
+/* ionosphere mapping function for satellites ----------------------------------
+* compute ionospheric delay mapping functions of satellites
+* args   : double *pos      I   receiver position {lat,lon,h} (rad,m)
+*          double *azel     I   azimuth/elevation angles {az,el,...} (rad)
+*          int    n         I   number of satellites
+*          double *mapf     O   ionospheric mapping functions {mapf1,...}
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void ionmapfs(const double *pos, const double *azel, int n, double *mapf)
+{
+    double r=(RE_WGS84+pos[2])/(RE_WGS84+HION);
+    int i;
+
+    for (i=0;i<n;i++) {
+        mapf[i]=pos[2]>=HION?1.0:1.0/cos(asin(r*sin(PI/2.0-azel[1+i*2])));
+    }
+}
 /* ionospheric pierce point position -------------------------------------------
 * compute ionospheric pierce point (ipp) position and slant factor
 * args   : double *pos      I   receiver position {lat,lon,h} (rad,m)
@@ -3663,6 +4612,23 @@ extern int seliflc(int optnf,int sys)
     /* use L1/L5 for Galileo if L5 is enabled */
     return((optnf==2||sys!=SYS_GAL)?1:2);
 }
+/* zenith hydrostatic/wet delays by saastamoinen model -----------------------*/
+static void tropzd(const double *pos, double humi, double *zd)
+{
+    const double temp0=15.0; /* temperature at sea level */
+    double hgt,pres,temp,e;
+
+    /* standard atmosphere */
+    hgt=pos[2]<0.0?0.0:pos[2];
+
+    pres=1013.25*pow(1.0-2.2557E-5*hgt,5.2568);
+    temp=temp0-6.5E-3*hgt+273.16;
+    e=6.108*humi*exp((17.15*temp-4684.0)/(temp-38.45));
+
+    /* saastamoinen model */
+    zd[0]=0.0022768*pres/(1.0-0.00266*cos(2.0*pos[0])-0.00028*hgt/1E3);
+    zd[1]=0.002277*(1255.0/temp+0.05)*e;
+}
 /* troposphere model -----------------------------------------------------------
 * compute tropospheric delay by standard atmosphere and saastamoinen model
 * args   : gtime_t time     I   time
@@ -3674,23 +4640,47 @@ extern int seliflc(int optnf,int sys)
 extern double tropmodel(gtime_t time, const double *pos, const double *azel,
                         double humi)
 {
-    const double temp0=15.0; /* temperature at sea level */
-    double hgt,pres,temp,e,z,trph,trpw;
+    double zd[2],cosz;
 
     if (pos[2]<-100.0||1E4<pos[2]||azel[1]<=0) return 0.0;
 
-    /* standard atmosphere */
-    hgt=pos[2]<0.0?0.0:pos[2];
+    tropzd(pos,humi,zd);
+    cosz=cos(PI/2.0-azel[1]);
+    return zd[0]/cosz+zd[1]/cosz;
+}
+/* troposphere model for satellites --------------------------------------------
+* compute tropospheric delays of satellites by standard atmosphere and
+* saastamoinen model
+* args   : gtime_t time     I   time
+*          double *pos      I   receiver position {lat,lon,h} (rad,m)
+*          double *azel     I   azimuth/elevation angles {az,el,...} (rad)
+*          int    n         I   number of satellites
+*          double humi      I   relative humidity
+*          double *trp      O   tropospheric delays (m) {trp1,...}
+* return : none
+* notes  : same as tropmodel() for each satellite with the standard atmosphere
+*          computed once
+*-----------------------------------------------------------------------------*/
+extern void tropmodels(gtime_t time, const double *pos, const double *azel,
+                       int n, double humi, double *trp)
+{
+    double zd[2],cosz;
+    int i;
 
-    pres=1013.25*pow(1.0-2.2557E-5*hgt,5.2568);
-    temp=temp0-6.5E-3*hgt+273.16;
-    e=6.108*humi*exp((17.15*temp-4684.0)/(temp-38.45));
+    if (pos[2]<-100.0||1E4<pos[2]) {
+        for (i=0;i<n;i++) trp[i]=0.0;
+        return;
+    }
+    tropzd(pos,humi,zd);
 
-    /* saastamoinen model */
-    z=PI/2.0-azel[1];
-    trph=0.0022768*pres/(1.0-0.00266*cos(2.0*pos[0])-0.00028*hgt/1E3)/cos(z);
-    trpw=0.002277*(1255.0/temp+0.05)*e/cos(z);
-    return trph+trpw;
+    for (i=0;i<n;i++) {
+        if (azel[1+i*2]<=0) {
+            trp[i]=0.0;
+            continue;
+        }
+        cosz=cos(PI/2.0-azel[1+i*2]);
+        trp[i]=zd[0]/cosz+zd[1]/cosz;
+    }
 }
 #ifndef IERS_MODEL
 
@@ -3700,13 +4690,12 @@ static double interpc(const double coef[], double lat)
     if (i<1) return coef[0]; else if (i>4) return coef[4];
     return coef[i-1]*(1.0-lat/15.0+i)+coef[i]*(lat/15.0-i);
 }
-static double mapf(double el, double a, double b, double c)
+static double mapf(double sinel, double a, double b, double c)
 {
-    double sinel=sin(el);
     return (1.0+a/(1.0+b/(1.0+c)))/(sinel+(a/(sinel+b/(sinel+c))));
 }
-static double nmf(gtime_t time, const double pos[], const double azel[],
-                  double *mapfw)
+/* nmf coefficients at station -----------------------------------------------*/
+static void nmfcoef(gtime_t time, const double pos[], double *ah, double *aw)
 {
     /* ref [5] table 3 */
     /* hydro-ave-a,b,c, hydro-amp-a,b,c, wet-a,b,c at latitude 15,30,45,60,75 */
@@ -3723,15 +4712,9 @@ static double nmf(gtime_t time, const double pos[], const double azel[],
         { 1.4275268E-3, 1.5138625E-3, 1.4572752E-3, 1.5007428E-3, 1.7599082E-3},
         { 4.3472961E-2, 4.6729510E-2, 4.3908931E-2, 4.4626982E-2, 5.4736038E-2}
     };
-    const double aht[]={ 2.53E-5, 5.49E-3, 1.14E-3}; /* height correction */
-
-    double y,cosy,ah[3],aw[3],dm,el=azel[1],lat=pos[0]*R2D,hgt=pos[2];
+    double y,cosy,lat=pos[0]*R2D;
     int i;
 
-    if (el<=0.0) {
-        if (mapfw) *mapfw=0.0;
-        return 0.0;
-    }
     /* year from doy 28, added half a year for southern latitudes */
     y=(time2doy(time)-28.0)/365.25+(lat<0.0?0.5:0.0);
 
@@ -3742,12 +4725,32 @@ static double nmf(gtime_t time, const double pos[], const double azel[],
         ah[i]=interpc(coef[i  ],lat)-interpc(coef[i+3],lat)*cosy;
         aw[i]=interpc(coef[i+6],lat);
     }
+}
+/* nmf for sin(el) with nmf coefficients -------------------------------------*/
+static double nmfel(double sinel, double hgt, const double *ah,
+                    const double *aw, double *mapfw)
+{
+    const double aht[]={ 2.53E-5, 5.49E-3, 1.14E-3}; /* height correction */
+    double dm;
+
     /* ellipsoidal height is used instead of height above sea level */
-    dm=(1.0/sin(el)-mapf(el,aht[0],aht[1],aht[2]))*hgt/1E3;
+    dm=(1.0/sinel-mapf(sinel,aht[0],aht[1],aht[2]))*hgt/1E3;
+
+    if (mapfw) *mapfw=mapf(sinel,aw[0],aw[1],aw[2]);
 
-    if (mapfw) *mapfw=mapf(el,aw[0],aw[1],aw[2]);
+    return mapf(sinel,ah[0],ah[1],ah[2])+dm;
+}
+static double nmf(gtime_t time, const double pos[], const double azel[],
+                  double *mapfw)
+{
+    double ah[3],aw[3];
 
-    return mapf(el,ah[0],ah[1],ah[2])+dm;
+    if (azel[1]<=0.0) {
+        if (mapfw) *mapfw=0.0;
+        return 0.0;
+    }
+    nmfcoef(time,pos,ah,aw);
+    return nmfel(sin(azel[1]),pos[2],ah,aw,mapfw);
 }
 #endif /* !IERS_MODEL */
 
@@ -3793,6 +4796,64 @@ extern double tropmapf(gtime_t time, const double pos[], const double azel[],
     return nmf(time,pos,azel,mapfw); /* NMF */
 #endif
 }
+/* troposphere mapping function for satellites ---------------------------------
+* compute tropospheric mapping functions of satellites by NMF
+* args   : gtime_t t        I   time
+*          double *pos      I   receiver position {lat,lon,h} (rad,m)
+*          double *azel     I   azimuth/elevation angles {az,el,...} (rad)
+*          int    n         I   number of satellites
+*          double *mapfh    O   dry mapping functions {mapfh1,...}
+*          double *mapfw    IO  wet mapping functions {mapfw1,...}
+*                               (NULL: not output)
+* return : none
+* notes  : same as tropmapf() for each satellite with station terms (nmf
+*          coefficients interpolated by latitude and doy) computed once
+*-----------------------------------------------------------------------------*/
+extern void tropmapfs(gtime_t time, const double pos[], const double azel[],
+                      int n, double *mapfh, double *mapfw)
+{
+#ifdef IERS_MODEL
+    const double ep[]={2000,1,1,12,0,0};
+    double mjd,lat,lon,hgt,zd,gmfw;
+#else
+    double ah[3],aw[3];
+#endif
+    int i;
+
+    trace(4,"tropmapfs: pos=%10.6f %11.6f %6.1f n=%d\n",pos[0]*R2D,pos[1]*R2D,
+          pos[2],n);
+
+    if (pos[2]<-1000.0||pos[2]>20000.0) {
+        for (i=0;i<n;i++) {
+            mapfh[i]=0.0;
+            if (mapfw) mapfw[i]=0.0;
+        }
+        return;
+    }
+#ifdef IERS_MODEL
+    mjd=51544.5+(timediff(time,epoch2time(ep)))/86400.0;
+    lat=pos[0];
+    lon=pos[1];
+    hgt=pos[2]-geoidh(pos); /* height in m (mean sea level) */
+
+    for (i=0;i<n;i++) {
+        zd=PI/2.0-azel[1+i*2];
+        gmf_(&mjd,&lat,&lon,&hgt,&zd,mapfh+i,&gmfw);
+        if (mapfw) mapfw[i]=gmfw;
+    }
+#else
+    nmfcoef(time,pos,ah,aw);
+
+    for (i=0;i<n;i++) {
+        if (azel[1+i*2]<=0.0) {
+            mapfh[i]=0.0;
+            if (mapfw) mapfw[i]=0.0;
+            continue;
+        }
+        mapfh[i]=nmfel(sin(azel[1+i*2]),pos[2],ah,aw,mapfw?mapfw+i:NULL);
+    }
+#endif
+}
 /* interpolate antenna phase center variation --------------------------------*/
 static double interpvar(double ang, const double *var)
 {
@@ -3894,6 +4955,114 @@ static void sunmoonpos_eci(gtime_t tut, double *rsun, double *rmoon)
         trace(5,"rmoon=%.3f %.3f %.3f\n",rmoon[0],rmoon[1],rmoon[2]);
     }
 }
+#define NSMC        4                   /* number of cached sun/moon positions */
+
+typedef struct {        /* sun and moon position cache type */
+    gtime_t tutc;       /* time (utc) */
+    double erpv[3];     /* erp values {xp,yp,ut1_utc} (rad,rad,s) */
+    double rsun[3];     /* sun position in ecef (m) */
+    double rmoon[3];    /* moon position in ecef (m) */
+    double gmst;        /* gmst (rad) */
+} smc_t;
+
+static rtklib_tls double smc_tint=0.0;  /* interpolation interval (s) (0:off) */
+static rtklib_tls int smc_n=0,smc_i=0;  /* number of entries, next entry */
+static rtklib_tls smc_t smc[NSMC];      /* cached positions */
+
+/* set sun and moon position interpolation -------------------------------------
+* set interval to interpolate sun and moon positions of the calling thread
+* args   : double tint      I   interval of interpolation nodes (s) (0:off)
+* return : none
+* notes  : with tint>0, sunmoonpos() interpolates the positions between the
+*          nodes at multiples of tint. the positions at the nodes are rotated
+*          by gmst to a quasi-inertial frame, linearly interpolated there and
+*          rotated back by gmst of the time. the relative errors are about
+*          2E-11 (sun) and 3E-9 (moon) for tint=60s and grow with tint^2.
+*          with tint=0, the positions are computed at the time and only reused
+*          for identical time and erp values.
+*-----------------------------------------------------------------------------*/
+extern void setsunmoonint(double tint)
+{
+    smc_tint=tint<0.0?0.0:tint;
+}
+/* sun and moon position with cache ------------------------------------------*/
+static const smc_t *sunmoonpos_c(gtime_t tutc, const double *erpv)
+{
+    gtime_t tut;
+    double rs[3],rm[3],U[9];
+    smc_t *p;
+    int i;
+
+    for (i=0;i<smc_n;i++) {
+        p=smc+i;
+        if (timediff(tutc,p->tutc)==0.0&&p->erpv[0]==erpv[0]&&
+            p->erpv[1]==erpv[1]&&p->erpv[2]==erpv[2]) return p;
+    }
+    p=smc+smc_i;
+    smc_i=(smc_i+1)%NSMC;
+    if (smc_n<NSMC) smc_n++;
+
+    tut=timeadd(tutc,erpv[2]); /* utc -> ut1 */
+
+    /* sun and moon position in eci */
+    sunmoonpos_eci(tut,rs,rm);
+
+    /* eci to ecef transformation matrix */
+    eci2ecef(tutc,erpv,U,&p->gmst);
+
+    /* sun and moon position in ecef */
+    matmul("NN",3,1,3,U,rs,p->rsun );
+    matmul("NN",3,1,3,U,rm,p->rmoon);
+    p->tutc=tutc;
+    for (i=0;i<3;i++) p->erpv[i]=erpv[i];
+    return p;
+}
+/* interpolate sun and moon position -----------------------------------------*/
+static void sunmoonpos_i(gtime_t tutc, const double *erpv, double *rsun,
+                         double *rmoon, double *gmst)
+{
+    smc_t p[2];
+    gtime_t t[2];
+    double tt,a,g,c,s,q[2][6],r[6];
+    int i,j;
+
+    /* interpolation nodes */
+    tt=floor(((double)tutc.time+tutc.sec)/smc_tint);
+    for (i=0;i<2;i++) {
+        a=(tt+i)*smc_tint;
+        t[i].time=(time_t)floor(a);
+        t[i].sec=a-floor(a);
+        p[i]=*sunmoonpos_c(t[i],erpv); /* copy as entry may be replaced */
+    }
+    a=timediff(tutc,t[0])/smc_tint;
+
+    /* positions in quasi-inertial frame rotated by gmst */
+    for (i=0;i<2;i++) {
+        c=cos(p[i].gmst); s=sin(p[i].gmst);
+        q[i][0]=c*p[i].rsun [0]-s*p[i].rsun [1];
+        q[i][1]=s*p[i].rsun [0]+c*p[i].rsun [1];
+        q[i][2]=p[i].rsun[2];
+        q[i][3]=c*p[i].rmoon[0]-s*p[i].rmoon[1];
+        q[i][4]=s*p[i].rmoon[0]+c*p[i].rmoon[1];
+        q[i][5]=p[i].rmoon[2];
+    }
+    for (j=0;j<6;j++) r[j]=q[0][j]*(1.0-a)+q[1][j]*a;
+
+    /* rotate back to ecef */
+    g=utc2gmst(tutc,erpv[2]);
+    c=cos(g); s=sin(g);
+    if (rsun) {
+        rsun [0]= c*r[0]+s*r[1];
+        rsun [1]=-s*r[0]+c*r[1];
+        rsun [2]=r[2];
+    }
+    if (rmoon) {
+        rmoon[0]= c*r[3]+s*r[4];
+        rmoon[1]=-s*r[3]+c*r[4];
+        rmoon[2]=r[5];
+    }
+    if (gmst) *gmst=g;
+}
 /* sun and moon position -------------------------------------------------------
 * get sun and moon position in ecef
 * args   : gtime_t tut      I   time in ut1
@@ -3902,27 +5071,28 @@ static void sunmoonpos_eci(gtime_t tut, double *rsun, double *rmoon)
 *          double *rmoon    IO  moon position in ecef (m) (NULL: not output)
 *          double *gmst     O   gmst (rad)
 * return : none
+* notes  : the positions are cached per thread and interpolated if enabled by
+*          setsunmoonint()
 *-----------------------------------------------------------------------------*/
 extern void sunmoonpos(gtime_t tutc, const double *erpv, double *rsun,
                        double *rmoon, double *gmst)
 {
-    gtime_t tut;
-    double rs[3],rm[3],U[9],gmst_;
+    const smc_t *p;
+    int i;
 
     trace(4,"sunmoonpos: tutc=%s\n",time_str(tutc,3));
 
-    tut=timeadd(tutc,erpv[2]); /* utc -> ut1 */
-
-    /* sun and moon position in eci */
-    sunmoonpos_eci(tut,rsun?rs:NULL,rmoon?rm:NULL);
-
-    /* eci to ecef transformation matrix */
-    eci2ecef(tutc,erpv,U,&gmst_);
+    if (smc_tint>0.0) {
+        sunmoonpos_i(tutc,erpv,rsun,rmoon,gmst);
+        return;
+    }
+    p=sunmoonpos_c(tutc,erpv);
 
-    /* sun and moon position in ecef */
-    if (rsun ) matmul("NN",3,1,3,U,rs,rsun );
-    if (rmoon) matmul("NN",3,1,3,U,rm,rmoon);
-    if (gmst ) *gmst=gmst_;
+    for (i=0;i<3;i++) {
+        if (rsun ) rsun [i]=p->rsun [i];
+        if (rmoon) rmoon[i]=p->rmoon[i];
+    }
+    if (gmst) *gmst=p->gmst;
 }
 /* uncompress file -------------------------------------------------------------
 * uncompress (uncompress/unzip/uncompact hatanaka-compression/tar) file
@@ -270,8 +270,10 @@ extern "C" {
 #define MAXSOLMSG   8191                /* max length of solution message */
 #define MAXRAWLEN   16384               /* max length of receiver raw message */
 #define MAXERRMSG   4096                /* max length of error/warning message */
+#define MAXINVALIDTM 100                /* max number of invalid time marks */
 #define MAXANT      64                  /* max length of station name/antenna type */
 #define MAXSOLBUF   256                 /* max number of solution buffer */
+#define MAXEXECTHR  16                  /* max number of threads of parexec() */
 #define MAXOBSBUF   128                 /* max number of observation data buffer */
 #define MAXNRPOS    16                  /* max number of reference positions */
 #define MAXLEAPS    64                  /* max number of leap seconds table */
@@ -537,17 +539,34 @@ extern "C" {
 #define rtklib_thread_t    HANDLE
 #define rtklib_lock_t      CRITICAL_SECTION
 #define rtklib_initlock(f) InitializeCriticalSection(f)
+#define rtklib_destroylock(f) DeleteCriticalSection(f)
 #define rtklib_lock(f)     EnterCriticalSection(f)
 #define rtklib_unlock(f)   LeaveCriticalSection(f)
+#define rtklib_cond_t      CONDITION_VARIABLE
+#define rtklib_initcond(c) InitializeConditionVariable(c)
+#define rtklib_destroycond(c) ((void)(c))
+#define rtklib_condwait(c,f) SleepConditionVariableCS(c,f,INFINITE)
+#define rtklib_condbroadcast(c) WakeAllConditionVariable(c)
 #define RTKLIB_FILEPATHSEP '\\'
 #else
 #define rtklib_thread_t    pthread_t
 #define rtklib_lock_t      pthread_mutex_t
 #define rtklib_initlock(f) pthread_mutex_init(f,NULL)
+#define rtklib_destroylock(f) pthread_mutex_destroy(f)
 #define rtklib_lock(f)     pthread_mutex_lock(f)
 #define rtklib_unlock(f)   pthread_mutex_unlock(f)
+#define rtklib_cond_t      pthread_cond_t
+#define rtklib_initcond(c) pthread_cond_init(c,NULL)
+#define rtklib_destroycond(c) pthread_cond_destroy(c)
+#define rtklib_condwait(c,f) pthread_cond_wait(c,f)
+#define rtklib_condbroadcast(c) pthread_cond_broadcast(c)
 #define RTKLIB_FILEPATHSEP '/'
 #endif
+#ifdef _MSC_VER
+#define rtklib_tls         __declspec(thread)
+#else
+#define rtklib_tls         __thread
+#endif
 
 /* type definitions ----------------------------------------------------------*/
 
@@ -622,6 +641,18 @@ typedef struct {        /* almanac type */
     double f0,f1;       /* SV clock parameters (af0,af1) */
 } alm_t;
 
+typedef struct {        /* derived constants of broadcast ephemeris type */
+    int sat;            /* satellite number (0:not set) */
+    double A,e,deln,toes,OMGd; /* orbit parameters the constants derived from */
+    int sys,geo;        /* satellite system, beidou geo satellite flag */
+    double mu,omge;     /* gravitational constant, earth angular velocity */
+    double n;           /* corrected mean motion (rad/s) */
+    double sqe;         /* sqrt(1-e^2) */
+    double OMGdo;       /* OMGd-omge (rad/s) */
+    double omgt;        /* omge*toes (rad) */
+    double rel;         /* 2*sqrt(mu*A)*e for relativity correction */
+} ephc_t;
+
 typedef struct {        /* GPS/QZS/GAL broadcast ephemeris type */
     int sat;            /* satellite number */
     int iode,iodc;      /* IODE,IODC */
@@ -646,6 +677,7 @@ typedef struct {        /* GPS/QZS/GAL broadcast ephemeris type */
                         /* CMP:tgd[0]=TGD_B1I ,tgd[1]=TGD_B2I/B2b,tgd[2]=TGD_B1Cp */
                         /*     tgd[3]=TGD_B2ap,tgd[4]=ISC_B1Cd   ,tgd[5]=ISC_B2ad */
     double Adot,ndot;   /* Adot,ndot for CNAV */
+    ephc_t c;           /* derived constants (set by ephconst()) */
 } eph_t;
 
 typedef struct {        /* GLONASS broadcast ephemeris type */
@@ -680,6 +712,52 @@ typedef struct {        /* precise clock type */
     float  std[MAXSAT][1]; /* satellite clock std (s) */
 } pclk_t;
 
+typedef struct {        /* compact precise ephemeris type */
+    int ne,nemax;       /* number of epochs/allocated */
+    gtime_t *time;      /* epoch times (GPST) */
+    int *index;         /* ephemeris index for multiple files */
+    double *pos[MAXSAT]; /* satellite position/clock {ne*4} (m|s) (NULL:no data) */
+    float  *std[MAXSAT]; /* satellite position/clock std {ne*4} (m|s) */
+} pephs_t;
+
+typedef struct {        /* precise ephemeris interpolation coefficients type */
+    const void *peph;   /* precise ephemeris fitted (peph or pephs.time) (NULL: none) */
+    int ne;             /* number of precise ephemeris fitted */
+    int n;              /* number of interpolation windows */
+    gtime_t *tc;        /* center time of windows */
+    double *tw;         /* half width of windows (s) */
+    int *off;           /* coefficient offsets {window*MAXSAT+sat-1} (-1:outage) */
+    double *coef;       /* chebyshev coefficients of orbit (m) */
+} pephc_t;
+
+typedef struct {        /* precise ephemeris/clock stream file type */
+    FILE *fp;           /* file pointer */
+    char file[1024];    /* file path */
+    char tmpfile[1024]; /* uncompressed temporary file ("": none) */
+    int type;           /* file type (0:sp3,1:rinex clock) */
+    int index;          /* ephemeris/clock index for multiple files */
+    int opt;            /* sp3 read options (see readsp3()) */
+    long off;           /* file offset of body */
+    char ftype;         /* sp3 file type ('P','V') */
+    int ns;             /* sp3 number of satellites */
+    double bfact[2];    /* sp3 base of position/clock std */
+    char tsys[4];       /* sp3 time system */
+    double ver;         /* rinex clock version */
+    int rsat;           /* rinex clock read-ahead record sat (0:none) */
+    gtime_t rtime;      /* rinex clock read-ahead record time */
+    double rdata[2];    /* rinex clock read-ahead record {clk,std} (s) */
+    int stat;           /* pending epoch status (0:end of file,1:pending) */
+    peph_t *peph;       /* pending precise ephemeris epoch */
+    pclk_t *pclk;       /* pending precise clock epoch */
+} pstrmf_t;
+
+typedef struct {        /* precise ephemeris/clock stream type */
+    int n,nmax;         /* number of files/allocated */
+    int nidx;           /* next file index */
+    int drop[2];        /* dropped epochs {peph,pclk} (0:none,1:dropped) */
+    pstrmf_t *file;     /* stream files */
+} pstrm_t;
+
 typedef struct {        /* SBAS ephemeris type */
     int sat;            /* satellite number */
     gtime_t t0;         /* reference epoch time (GPST) */
@@ -818,6 +896,15 @@ typedef struct {        /* SSR correction type */
     uint8_t update;     /* update flag (0:no update,1:update) */
 } ssr_t;
 
+typedef struct {        /* ephemeris index type */
+    const void *eph;    /* indexed ephemeris array (NULL: no index) */
+    int n,nmax;         /* number of indexed ephemerides/allocated */
+    int *idx;           /* ephemeris indices sorted by satellite and toe */
+    gtime_t *toe;       /* toe (t0 for sbas) of indexed ephemerides */
+    int off[MAXSAT+1];  /* start of satellite entries in idx (sat-1) */
+    uint32_t ver;       /* update count of navigation data when indexed */
+} navidx_t;
+
 typedef struct {        /* navigation data type */
     int n,nmax;         /* number of broadcast ephemeris */
     int ng,ngmax;       /* number of glonass ephemeris */
@@ -854,6 +941,12 @@ typedef struct {        /* navigation data type */
     sbsion_t sbsion[MAXBAND+1]; /* SBAS ionosphere corrections */
     dgps_t dgps[MAXSAT]; /* DGPS corrections */
     ssr_t ssr[MAXSAT];  /* SSR corrections */
+    navidx_t ieph;      /* index of GPS/QZS/GAL/BDS/IRN ephemeris */
+    navidx_t igeph;     /* index of GLONASS ephemeris */
+    navidx_t iseph;     /* index of SBAS ephemeris */
+    uint32_t nver;      /* update count of eph/geph/seph (for index) */
+    pephs_t pephs;      /* compact precise ephemeris */
+    pephc_t pephc;      /* precise ephemeris interpolation coefficients */
 } nav_t;
 
 typedef struct {        /* station parameter type */
@@ -1056,6 +1149,14 @@ typedef struct {        /* processing options type */
     double odisp[2][6*11]; /* ocean tide loading parameters {rov,base} */
     int  freqopt;       /* disable L2-AR */
     char pppopt[256];   /* ppp option */
+    int  seqfilter;     /* sequential measurement update of filter (0:off,1:on) */
+    int  arwarm;        /* reuse lambda reduction of previous epoch (0:off,1:on)
+                           (fixed ambiguities rounded, see lambdaw()) */
+    double sattol;      /* transmission time tolerance to reuse sat states (s) */
+    int  pephcheb;      /* chebyshev coefficients for precise ephemeris (0:off,1:on) */
+    int  pephstrm;      /* stream precise ephemeris/clock in time window (0:off,1:on) */
+    int  nthread;       /* number of threads for satellite models (0,1:off) */
+    double sunmoonint;  /* interval to interpolate sun/moon positions (s) (0:off) */
 } prcopt_t;
 
 typedef struct {        /* solution options type */
@@ -1172,6 +1273,39 @@ typedef struct {        /* ambiguity control type */
     char flags[MAXSAT]; /* fix flags */
 } ambc_t;
 
+typedef struct {        /* workspace (scratch memory) type */
+    double *buff;       /* workspace buffer */
+    int size;           /* size of workspace buffer (doubles) */
+    int used;           /* used size of workspace (doubles) */
+    int peak;           /* peak used size of workspace (doubles) */
+    int nb,nbmax;       /* number of overflow blocks/allocated */
+    double **blk;       /* overflow blocks */
+    int *off;           /* offsets of overflow blocks (doubles) */
+} wsp_t;
+
+typedef struct {        /* thread pool of parexec() type */
+    int nthr;           /* number of worker threads */
+    rtklib_thread_t thread[MAXEXECTHR]; /* worker threads */
+    rtklib_lock_t lock; /* lock for task */
+    rtklib_cond_t start; /* condition of task start or stop */
+    rtklib_cond_t done; /* condition of task done */
+    uint32_t seq;       /* task sequence number */
+    int stop;           /* stop request */
+    void (*func)(void *, int); /* function for item */
+    void *arg;          /* argument of function */
+    int n;              /* number of items of task */
+    int nrng;           /* number of item ranges of task */
+    int next;           /* next item range to execute */
+    int ndone;          /* number of executed ranges except first */
+} execpool_t;
+
+typedef struct {        /* lambda search statistics type */
+    int nloop;          /* number of search loops */
+    int nnode;          /* number of nodes visited inside search radius */
+    int ncand;          /* number of integer candidates found */
+    int nperm;          /* number of permutations in reduction */
+} lambstat_t;
+
 typedef struct {        /* RTK control/result type */
     sol_t  sol;         /* RTK solution */
     double rb[6];       /* base position/velocity (ecef) (m|m/s) */
@@ -1190,8 +1324,51 @@ typedef struct {        /* RTK control/result type */
     prcopt_t opt;       /* processing options */
     int initial_mode;   /* initial positioning mode */
     int epoch;          /* epoch number */
+    wsp_t ws;           /* workspace for epoch processing */
+    obsd_t *obsb;       /* previous base obs for time-interpolation */
+    int nb;             /* number of previous base obs */
+    int nlamb;          /* number of lambda searches in current epoch */
+    lambstat_t lstat;   /* lambda search statistics in current epoch */
+    int namb,nambmax;   /* number of ambiguities of last reduction/allocated */
+    int *ixamb;         /* state index pairs of last reduction */
+    double *Zamb;       /* lambda reduction matrix of last reduction */
+    int nxs;            /* number of active states in filter (x/P keep nx) */
+    int *ixs;           /* state indexes of active states */
+    int *jxs;           /* active state slots of states (-1:inactive) */
+    execpool_t *pool;   /* thread pool for satellite models (NULL:off) */
 } rtk_t;
 
+typedef struct {        /* post-processing context type */
+    const nav_t *prod;  /* shared precise eph/clock (NULL: read in session) */
+    const pcvs_t *pcvp; /* shared satellite antenna parameters (NULL: read) */
+    void *prodc[5];     /* precise products acquired from cache */
+    pstrm_t pstrm;      /* precise ephemeris/clock stream (pos2-pephstrm) */
+    pcvs_t pcvss;       /* satellite antenna parameters */
+    pcvs_t pcvsr;       /* receiver antenna parameters */
+    obs_t obss;         /* observation data */
+    nav_t navs;         /* navigation data */
+    sbs_t sbss;         /* sbas messages */
+    sta_t stas[MAXRCV]; /* station information */
+    int nepoch;         /* number of observation epochs */
+    int nitm;           /* number of invalid time marks */
+    int iitm;           /* current invalid time mark index */
+    int aborts;         /* abort status */
+    sol_t *solf;        /* forward solutions */
+    sol_t *solb;        /* backward solutions */
+    double *rbf;        /* forward base positions */
+    double *rbb;        /* backward base positions */
+    int isolf;          /* current forward solutions index */
+    int isolb;          /* current backward solutions index */
+    char proc_rov [64]; /* rover for current processing */
+    char proc_base[64]; /* base station for current processing */
+    char rtcm_file[1024]; /* rtcm data file */
+    char rtcm_path[1024]; /* rtcm data path */
+    gtime_t invalidtm[MAXINVALIDTM]; /* invalid time marks */
+    rtcm_t rtcm;        /* rtcm control struct */
+    FILE *fp_rtcm;      /* rtcm data file pointer */
+    rtklib_lock_t lock; /* lock for progress and abort status */
+} postctx_t;
+
 typedef struct {        /* receiver raw data control type */
     gtime_t time;       /* message time */
     gtime_t tobs[MAXSAT][NFREQ+NEXOBS]; /* observation data time */
@@ -1298,6 +1475,7 @@ typedef struct {        /* RTK server type */
     rtcm_t rtcm[3];     /* RTCM control {rov,base,corr} */
     gtime_t ftime[3];   /* download time {rov,base,corr} */
     char files[3][MAXSTRPATH]; /* download paths {rov,base,corr} */
+    pstrm_t pstrm[3];   /* download precise ephemeris/clock streams {rov,base,corr} */
     obs_t obs[3][MAXOBSBUF]; /* observation data {rov,base,corr} */
     nav_t nav;          /* navigation data */
     sbsmsg_t sbsmsg[MAXSBSMSG]; /* SBAS message buffer */
@@ -1376,6 +1554,13 @@ EXPORT double *mat  (int n, int m);
 EXPORT int    *imat (int n, int m);
 EXPORT double *zeros(int n, int m);
 EXPORT double *eye  (int n);
+EXPORT void    wspinit (wsp_t *ws, int size);
+EXPORT void    wspfree (wsp_t *ws);
+EXPORT double *wspmat  (wsp_t *ws, int n, int m);
+EXPORT int    *wspimat (wsp_t *ws, int n, int m);
+EXPORT double *wspzeros(wsp_t *ws, int n, int m);
+EXPORT int     wspmark (const wsp_t *ws);
+EXPORT void    wsprelease(wsp_t *ws, int mark);
 EXPORT double dot2(const double *a, const double *b);
 EXPORT double dot3(const double *a, const double *b);
 EXPORT double dot (const double *a, const double *b, int n);
@@ -1390,12 +1575,19 @@ EXPORT void matmulp(const char *tr, int n, int k, int m,
 EXPORT void matmulm(const char *tr, int n, int k, int m,
                     const double *A, const double *B, double *C);
 EXPORT int  matinv(double *A, int n);
+EXPORT int  matinvw(double *A, int n, wsp_t *ws);
 EXPORT int  solve (const char *tr, const double *A, const double *Y, int n,
                    int m, double *X);
 EXPORT int  lsq   (const double *A, const double *y, int n, int m, double *x,
                    double *Q);
 EXPORT int  filter(double *x, double *P, const double *H, const double *v,
                    const double *R, int n, int m);
+EXPORT int  filterw(double *x, double *P, const double *H, const double *v,
+                    const double *R, int n, int m, wsp_t *ws);
+EXPORT int  filterseq(double *x, double *P, const double *H, const double *v,
+                      const double *R, int n, int m, wsp_t *ws);
+EXPORT int  filterc(double *x, double *P, const double *H, const double *v,
+                    const double *R, int n, int m, int seq, wsp_t *ws);
 EXPORT int  smoother(const double *xf, const double *Qf, const double *xb,
                      const double *Qb, int n, double *xs, double *Qs);
 EXPORT void matprint (const double *A, int n, int m, int p, int q);
@@ -1405,6 +1597,7 @@ EXPORT void add_fatal(fatalfunc_t *func);
 
 /* time and string functions -------------------------------------------------*/
 EXPORT double  str2num(const char *s, int i, int n);
+EXPORT double  str2dbl(const char *s, char **end);
 EXPORT int     str2time(const char *s, int i, int n, gtime_t *t);
 EXPORT void    time2str(gtime_t t, char *str, int n);
 EXPORT gtime_t epoch2time(const double *ep);
@@ -1434,6 +1627,10 @@ EXPORT int read_leaps(const char *file);
 EXPORT int adjgpsweek(int week);
 EXPORT uint32_t tickget(void);
 EXPORT void sleepms(int ms);
+EXPORT execpool_t *newexecpool(int nthr);
+EXPORT void freeexecpool(execpool_t *pool);
+EXPORT void parexec(execpool_t *pool, int n, void (*func)(void *, int),
+                    void *arg);
 
 EXPORT int reppath(const char *path, char *rpath, gtime_t time, const char *rov,
                    const char *base);
@@ -1456,6 +1653,10 @@ EXPORT double dms2deg(const double *dms);
 EXPORT void readpos(const char *file, const char *rcv, double *pos);
 EXPORT int  sortobs(obs_t *obs);
 EXPORT void uniqnav(nav_t *nav);
+EXPORT void indexnav(nav_t *nav);
+EXPORT void freenavidx(nav_t *nav);
+EXPORT void freepephc(nav_t *nav);
+EXPORT void freepephs(nav_t *nav);
 EXPORT int  screent(gtime_t time, gtime_t ts, gtime_t te, double tint);
 EXPORT int  readnav(const char *file, nav_t *nav);
 EXPORT int  savenav(const char *file, const nav_t *nav);
@@ -1534,6 +1735,13 @@ EXPORT double tropmodel(gtime_t time, const double *pos, const double *azel,
                         double humi);
 EXPORT double tropmapf(gtime_t time, const double *pos, const double *azel,
                        double *mapfw);
+EXPORT void ionmodels(gtime_t t, const double *ion, const double *pos,
+                      const double *azel, int n, double *dion);
+EXPORT void ionmapfs(const double *pos, const double *azel, int n, double *mapf);
+EXPORT void tropmodels(gtime_t time, const double *pos, const double *azel,
+                       int n, double humi, double *trp);
+EXPORT void tropmapfs(gtime_t time, const double *pos, const double *azel,
+                      int n, double *mapfh, double *mapfw);
 EXPORT int iontec(gtime_t time, const nav_t *nav, const double *pos,
                   const double *azel, int opt, double *delay, double *var);
 EXPORT void readtec(const char *file, nav_t *nav, int opt);
@@ -1554,6 +1762,7 @@ EXPORT void antmodel_s(const pcv_t *pcv, double nadir, double *dant);
 /* earth tide models ---------------------------------------------------------*/
 EXPORT void sunmoonpos(gtime_t tutc, const double *erpv, double *rsun,
                        double *rmoon, double *gmst);
+EXPORT void setsunmoonint(double tint);
 EXPORT void tidedisp(gtime_t tutc, const double *rr, int opt, const erp_t *erp,
                      const double *odisp, double *dr);
 
@@ -1574,6 +1783,9 @@ EXPORT int readrnxt(const char *file, int rcv, gtime_t ts, gtime_t te,
                     double tint, const char *opt, obs_t *obs, nav_t *nav,
                     sta_t *sta);
 EXPORT int readrnxc(const char *file, nav_t *nav);
+EXPORT int readrnxclkh(FILE *fp, double *ver);
+EXPORT int readrnxclkr(FILE *fp, double ver, gtime_t *time, int *sat,
+                       double *data);
 EXPORT int outrnxobsh(FILE *fp, const rnxopt_t *opt, const nav_t *nav);
 EXPORT int outrnxobsb(FILE *fp, const rnxopt_t *opt, const obsd_t *obs, int n,
                       int epflag);
@@ -1598,6 +1810,7 @@ EXPORT int  input_rnxctr(rnxctr_t *rnx, FILE *fp);
 EXPORT double eph2clk (gtime_t time, const eph_t  *eph);
 EXPORT double geph2clk(gtime_t time, const geph_t *geph);
 EXPORT double seph2clk(gtime_t time, const seph_t *seph);
+EXPORT void ephconst(eph_t *eph);
 EXPORT void eph2pos (gtime_t time, const eph_t  *eph,  double *rs, double *dts,
                      double *var);
 EXPORT void geph2pos(gtime_t time, const geph_t *geph, double *rs, double *dts,
@@ -1613,9 +1826,14 @@ EXPORT int  satpos(gtime_t time, gtime_t teph, int sat, int ephopt,
                    int *svh);
 EXPORT void satposs(gtime_t time, const obsd_t *obs, int n, const nav_t *nav,
                     int sateph, double *rs, double *dts, double *var, int *svh);
+EXPORT void setsatcache(int ena, double tol);
 EXPORT void setseleph(int sys, int sel);
 EXPORT int  getseleph(int sys);
 EXPORT void readsp3(const char *file, nav_t *nav, int opt);
+EXPORT int  pephcoef(nav_t *nav);
+EXPORT int  openpstrm(pstrm_t *strm, const char *file, int opt);
+EXPORT int  updpstrm(pstrm_t *strm, gtime_t time, nav_t *nav);
+EXPORT void closepstrm(pstrm_t *strm);
 EXPORT int  readsap(const char *file, gtime_t time, nav_t *nav);
 EXPORT int  readdcb(const char *file, nav_t *nav, const sta_t *sta);
 EXPORT int code2bias_ix(const int sys,const int code);
@@ -1797,6 +2015,8 @@ EXPORT void strsetproxy(const char *addr);
 /* integer ambiguity resolution ----------------------------------------------*/
 EXPORT int lambda(int n, int m, const double *a, const double *Q, double *F,
                   double *s);
+EXPORT int lambdaw(int n, int m, const double *a, const double *Q, double *F,
+                   double *s, double *Z, wsp_t *ws, lambstat_t *stat);
 EXPORT int lambda_reduction(int n, const double *Q, double *Z);
 EXPORT int lambda_search(int n, int m, const double *a, const double *Q,
                          double *F, double *s);
@@ -1827,6 +2047,14 @@ EXPORT int postpos(gtime_t ts, gtime_t te, double ti, double tu,
                    const prcopt_t *popt, const solopt_t *sopt,
                    const filopt_t *fopt, char **infile, int n, char *outfile,
                    const char *rov, const char *base);
+EXPORT void postctxinit(postctx_t *ctx, const nav_t *prod, const pcvs_t *pcvp);
+EXPORT void postctxfree(postctx_t *ctx);
+EXPORT int  postposc(postctx_t *ctx, gtime_t ts, gtime_t te, double ti,
+                     double tu, const prcopt_t *popt, const solopt_t *sopt,
+                     const filopt_t *fopt, char **infile, int n, char *outfile,
+                     const char *rov, const char *base);
+EXPORT void setprodcache(int nmax);
+EXPORT void freeprodcache(void);
 
 /* stream server functions ---------------------------------------------------*/
 EXPORT void strsvrinit (strsvr_t *svr, int nout);
@@ -159,6 +159,16 @@ static gtime_t time_stat={0};    /* rtk status file time */
 *          bias     : h/w bias coefficient (m/MHz) float
 *          biasf    : h/w bias coefficient (m/MHz) fixed
 *
+*   $AMB,week,tow,stat,nb,ratio,nsrch,nloop,nnode,ncand
+*          week/tow : gps week no/time of week (s)
+*          stat     : solution status
+*          nb       : number of double-differenced ambiguities (last search)
+*          ratio    : ambiguity ratio test value
+*          nsrch    : number of lambda searches in the epoch
+*          nloop    : total search loop count in the epoch
+*          nnode    : total nodes visited inside search radius in the epoch
+*          ncand    : total integer candidates found in the epoch
+*
 *   $SAT,week,tow,sat,frq,az,el,resp,resc,vsat,snr,fix,slip,lock,outc,slipc,rejc,icbias,bias,bias_var,lambda
 *          week/tow : gps week no/time of week (s)
 *          sat/frq  : satellite id/frequency (1:L1,2:L2,...)
@@ -299,6 +309,12 @@ extern int rtkoutstat(rtk_t *rtk, char *buff)
                        rtk->sol.stat,i+1,rtk->x[j],xa[0]);
         }
     }
+    /* ambiguity search statistics */
+    if (est&&rtk->opt.modear!=ARMODE_OFF) {
+        p+=sprintf(p,"$AMB,%d,%.3f,%d,%d,%.1f,%d,%d,%d,%d\n",week,tow,
+                   rtk->sol.stat,rtk->nb_ar,rtk->sol.ratio,rtk->nlamb,
+                   rtk->lstat.nloop,rtk->lstat.nnode,rtk->lstat.ncand);
+    }
     return (int)(p-buff);
 }
 /* swap solution status file -------------------------------------------------*/
@@ -484,8 +500,8 @@ static int selsat(const obsd_t *obs, double *azel, int nu, int nr,
 /* temporal update of position/velocity/acceleration -------------------------*/
 static void udpos(rtk_t *rtk, double tt)
 {
-    double *F,*P,*FP,*x,*xp,pos[3],Q[9]={0},Qv[9],var=0.0;
-    int i,j,*ix,nx;
+    double F[81]={0},xp[9],p[9],q[9],*P,pos[3],Q[9]={0},Qv[9],var=0.0;
+    int i,j,*ix,nx,mark;
 
     trace(3,"udpos   : tt=%.3f\n",tt);
 
@@ -524,40 +540,38 @@ static void udpos(rtk_t *rtk, double tt)
         return;
     }
     /* generate valid state index */
-    ix=imat(rtk->nx,1);
+    mark=wspmark(&rtk->ws);
+    ix=wspimat(&rtk->ws,rtk->nx,1);
     for (i=nx=0;i<rtk->nx;i++) {
          /*    TODO:  The b34 code causes issues so use b33 code for now */
         if (i<9||(rtk->x[i]!=0.0&&rtk->P[i+i*rtk->nx]>0.0)) ix[nx++]=i;
     }
     /* state transition of position/velocity/acceleration */
-    F=eye(nx); P=mat(nx,nx); FP=mat(nx,nx); x=mat(nx,1); xp=mat(nx,1);
-
+    for (i=0;i<9;i++) {
+        F[i+i*9]=1.0;
+    }
     for (i=0;i<6;i++) {
-        F[i+(i+3)*nx]=tt;
+        F[i+(i+3)*9]=tt;
     }
     /* include accel terms if filter is converged */
     if (var<rtk->opt.thresar[1]) {
         for (i=0;i<3;i++) {
-            F[i+(i+6)*nx]=(tt>=0?1:-1)*SQR(tt)/2.0;
+            F[i+(i+6)*9]=(tt>=0?1:-1)*SQR(tt)/2.0;
         }
     }
     else trace(3,"pos var too high for accel term: %.4f\n", var);
-    for (i=0;i<nx;i++) {
-        x[i]=rtk->x[ix[i]];
-        for (j=0;j<nx;j++) {
-            P[i+j*nx]=rtk->P[ix[i]+ix[j]*rtk->nx];
-        }
-    }
-    /* x=F*x, P=F*P*F' */
-    matmul("NN",nx,1,nx,F,x,xp);
-    matmul("NN",nx,nx,nx,F,P,FP);
-    matmul("NT",nx,nx,nx,FP,F,P);
-    
-    for (i=0;i<nx;i++) {
-        rtk->x[ix[i]]=xp[i];
-        for (j=0;j<nx;j++) {
-            rtk->P[ix[i]+ix[j]*rtk->nx]=P[i+j*nx];
-        }
+    /* x=F*x, P=F*P*F' (F is identity except pos/vel/acc block) */
+    matmul("NN",9,1,9,F,rtk->x,xp);
+    matcpy(rtk->x,xp,9,1);
+    for (j=0;j<nx;j++) { /* rows of pos/vel/acc: P=F*P */
+        P=rtk->P+ix[j]*rtk->nx;
+        matcpy(p,P,9,1);
+        matmul("NN",9,1,9,F,p,P);
+    }
+    for (i=0;i<nx;i++) { /* columns of pos/vel/acc: P=P*F' */
+        for (j=0;j<9;j++) p[j]=rtk->P[ix[i]+j*rtk->nx];
+        matmul("NT",1,9,9,p,F,q);
+        for (j=0;j<9;j++) rtk->P[ix[i]+j*rtk->nx]=q[j];
     }
     /* process noise added to only acceleration  P=P+Q */
     Q[0]=Q[4]=SQR(rtk->opt.prn[3])*fabs(tt);
@@ -567,7 +581,7 @@ static void udpos(rtk_t *rtk, double tt)
     for (i=0;i<3;i++) for (j=0;j<3;j++) {
         rtk->P[i+6+(j+6)*rtk->nx]+=Qv[i+j*3];
     }
-    free(ix); free(F); free(P); free(FP); free(x); free(xp);
+    wsprelease(&rtk->ws,mark);
 }
 /* temporal update of ionospheric parameters ---------------------------------*/
 static void udion(rtk_t *rtk, double tt, double bl, const int *sat, int ns)
@@ -783,7 +797,7 @@ static void udbias(rtk_t *rtk, double tt, const obsd_t *obs, const int *sat,
                    const int *iu, const int *ir, int ns, const nav_t *nav)
 {
     double cp,pr,cp1,cp2,pr1,pr2,*bias,offset,freqi,freq1,freq2,C1,C2;
-    int i,j,k,slip,rejc,reset,nf=NF(&rtk->opt),f2;
+    int i,j,k,slip,rejc,reset,nf=NF(&rtk->opt),f2,mark;
 
     trace(3,"udbias  : tt=%.3f ns=%d\n",tt,ns);
 
@@ -847,7 +861,8 @@ static void udbias(rtk_t *rtk, double tt, const obsd_t *obs, const int *sat,
             /* retain icbiases for GLONASS sats */
             if (rtk->ssat[sat[i]-1].sys!=SYS_GLO) rtk->ssat[sat[i]-1].icbias[k]=0;
         }
-        bias=zeros(ns,1);
+        mark=wspmark(&rtk->ws);
+        bias=wspzeros(&rtk->ws,ns,1);
 
         /* estimate approximate phase-bias by delta phase - delta code */
         for (i=j=0,offset=0.0;i<ns;i++) {
@@ -894,7 +909,7 @@ static void udbias(rtk_t *rtk, double tt, const obsd_t *obs, const int *sat,
             trace(3,"     sat=%3d, F=%d: init phase=%.3f\n",sat[i],k+1,bias[i]);
             rtk->ssat[sat[i]-1].lock[k]=-rtk->opt.minlock;
         }
-        free(bias);
+        wsprelease(&rtk->ws,mark);
     }
 }
 /* Temporal update of states --------------------------------------------------*/
@@ -974,6 +989,51 @@ static void zdres_sat(int base, double r, const obsd_t *obs, const nav_t *nav,
         }
     }
 }
+typedef struct {        /* arguments of zdres_s() type */
+    int base;           /* 1=base,0=rover */
+    const obsd_t *obs;  /* sat observations */
+    const double *rs,*dts,*var; /* sat position/clock/variance */
+    const int *svh;     /* sat health flags */
+    const nav_t *nav;   /* sat nav data */
+    const double *rr,*pos; /* rcvr pos (ecef/geodetic) */
+    double zhd;         /* zenith hydrostatic delay (m) */
+    const prcopt_t *opt; /* options */
+    double *y,*e,*azel,*freq; /* outputs of zdres() */
+} zdarg_t;
+
+/* undifferenced phase/code residual of satellite i (thread) -----------------*/
+static void zdres_s(void *arg_, int i)
+{
+    const zdarg_t *arg=(const zdarg_t *)arg_;
+    const obsd_t *obs=arg->obs;
+    const prcopt_t *opt=arg->opt;
+    double r,dant[NFREQ]={0},mapfh;
+    double *e=arg->e+i*3,*azel=arg->azel+i*2;
+    int nf=NF(opt);
+
+    /* compute geometric-range and azimuth/elevation angle */
+    if ((r=geodist(arg->rs+i*6,arg->rr,e))<=0.0) return;
+    if (satazel(arg->pos,e,azel)<opt->elmin) return;
+
+    /* excluded satellite? */
+    if (satexclude(obs[i].sat,arg->var[i],arg->svh[i],opt)) return;
+
+    /* adjust range for satellite clock-bias */
+    r+=-CLIGHT*arg->dts[i*2];
+
+    /* adjust range for troposphere delay model (hydrostatic) */
+    mapfh=tropmapf(obs[i].time,arg->pos,azel,NULL);
+    r+=mapfh*arg->zhd;
+
+    /* calc receiver antenna phase center correction */
+    antmodel(opt->pcvr+arg->base,opt->antdel[arg->base],azel,opt->posopt[1],
+             dant);
+
+    /* calc undifferenced phase/code residual for satellite */
+    trace(4,"sat=%d r=%.6f c*dts=%.6f zhd=%.6f map=%.6f\n",obs[i].sat,r,CLIGHT*arg->dts[i*2],arg->zhd,mapfh);
+    zdres_sat(arg->base,r,obs+i,arg->nav,azel,dant,opt,arg->y+i*nf*2,
+              arg->freq+i*nf);
+}
 /* undifferenced phase/code residuals ----------------------------------------
     calculate zero diff residuals [observed pseudorange - range]
         output is in y[0:nu-1], only shared input with base is nav
@@ -987,16 +1047,18 @@ static void zdres_sat(int base, double r, const obsd_t *obs, const nav_t *nav,
         I   nav  = sat nav data
         I   rr   = rcvr pos (x,y,z)
         I   opt  = options
+        I   pool = thread pool for satellites (NULL: no thread)
         O   y[(0:1)+i*2] = zero diff residuals {phase,code} (m)
         O   e    = line of sight unit vectors to sats
         O   azel = [az, el] to sats                                           */
 static int zdres(int base, const obsd_t *obs, int n, const double *rs,
                  const double *dts, const double *var, const int *svh,
                  const nav_t *nav, const double *rr, const prcopt_t *opt,
-                 double *y, double *e, double *azel, double *freq)
+                 execpool_t *pool, double *y, double *e, double *azel,
+                 double *freq)
 {
-    double r,rr_[3],pos[3],dant[NFREQ]={0},disp[3];
-    double mapfh,zhd,zazel[]={0.0,90.0*D2R};
+    zdarg_t arg;
+    double rr_[3],pos[3],disp[3],zazel[]={0.0,90.0*D2R};
     int i,nf=NF(opt);
 
     trace(3,"zdres   : n=%d rr=%.2f %.2f %.2f\n",n,rr[0], rr[1], rr[2]);
@@ -1018,31 +1080,13 @@ static int zdres(int base, const obsd_t *obs, int n, const double *rs,
     /* translate rcvr pos from ecef to geodetic */
     ecef2pos(rr_,pos);
 
-    /* loop through satellites */
-    for (i=0;i<n;i++) {
-        /* compute geometric-range and azimuth/elevation angle */
-        if ((r=geodist(rs+i*6,rr_,e+i*3))<=0.0) continue;
-        if (satazel(pos,e+i*3,azel+i*2)<opt->elmin) continue;
-
-        /* excluded satellite? */
-        if (satexclude(obs[i].sat,var[i],svh[i],opt)) continue;
-
-        /* adjust range for satellite clock-bias */
-        r+=-CLIGHT*dts[i*2];
+    /* satellite models by threads */
+    arg.base=base; arg.obs=obs; arg.rs=rs; arg.dts=dts; arg.var=var;
+    arg.svh=svh; arg.nav=nav; arg.rr=rr_; arg.pos=pos; arg.opt=opt;
+    arg.zhd=tropmodel(obs[0].time,pos,zazel,0.0); /* zenith hydrostatic */
+    arg.y=y; arg.e=e; arg.azel=azel; arg.freq=freq;
+    parexec(pool,n,zdres_s,&arg);
 
-        /* adjust range for troposphere delay model (hydrostatic) */
-        zhd=tropmodel(obs[0].time,pos,zazel,0.0);
-        mapfh=tropmapf(obs[i].time,pos,azel+i*2,NULL);
-        r+=mapfh*zhd;
-
-        /* calc receiver antenna phase center correction */
-        antmodel(opt->pcvr+base,opt->antdel[base],azel+i*2,opt->posopt[1],
-                 dant);
-
-        /* calc undifferenced phase/code residual for satellite */
-        trace(4,"sat=%d r=%.6f c*dts=%.6f zhd=%.6f map=%.6f\n",obs[i].sat,r,CLIGHT*dts[i*2],zhd,mapfh);
-        zdres_sat(base,r,obs+i,nav,azel+i*2,dant,opt,y+i*nf*2,freq+i*nf);
-    }
     trace(4,"rr_=%.3f %.3f %.3f\n",rr_[0],rr_[1],rr_[2]);
     trace(4,"pos=%.9f %.9f %.3f\n",pos[0]*R2D,pos[1]*R2D,pos[2]);
     for (i=0;i<n;i++) {
@@ -1085,6 +1129,66 @@ static void ddcov(const int *nb, int n, const double *Ri, const double *Rj,
     }
     trace(5,"R=\n"); tracemat(5,R,nv,nv,8,6);
 }
+/* index active states --------------------------------------------------------
+* index the states with x!=0 and P(i,i)>0 in compact order for the filter.
+* ambiguities of rising satellites are added and those of set or reset
+* satellites are removed by the states updated in udstate().
+* only the filter computation runs on the active subset. rtk->x and rtk->P
+* keep the full nx and nx x nx storage, which udstate(), ppp.c and the
+* monitors index directly, and the active states are gathered from and
+* scattered back to them for each update.
+*-----------------------------------------------------------------------------*/
+static int actstates(rtk_t *rtk)
+{
+    int i;
+
+    for (i=rtk->nxs=0;i<rtk->nx;i++) {
+        if (rtk->x[i]!=0.0&&rtk->P[i+i*rtk->nx]>0.0) {
+            rtk->jxs[i]=rtk->nxs;
+            rtk->ixs[rtk->nxs++]=i;
+        }
+        else rtk->jxs[i]=-1;
+    }
+    trace(4,"actstates: nx=%d nxs=%d\n",rtk->nx,rtk->nxs);
+    return rtk->nxs;
+}
+/* variance of state (P: covariance of active states) ------------------------*/
+static double varstate(const rtk_t *rtk, const double *P, int i)
+{
+    int j;
+
+    if (i>=rtk->nx) return 0.0; /* no phase-bias state in DGPS mode */
+    j=rtk->jxs[i];
+    return j>=0?P[j+j*rtk->nxs]:rtk->P[i+i*rtk->nx];
+}
+/* set partial derivative by state (Hi: partial derivatives of active states) */
+static void setpartial(const rtk_t *rtk, double *Hi, int i, double h)
+{
+    if (i<rtk->nx&&rtk->jxs[i]>=0) Hi[rtk->jxs[i]]=h;
+}
+/* get/set active states and covariance --------------------------------------*/
+static void getstates(const rtk_t *rtk, const double *x, const double *P,
+                      double *xs, double *Ps)
+{
+    int i,j,n=rtk->nxs;
+
+    for (i=0;i<n;i++) {
+        if (xs) xs[i]=x[rtk->ixs[i]];
+        if (!Ps) continue;
+        for (j=0;j<n;j++) Ps[i+j*n]=P[rtk->ixs[i]+rtk->ixs[j]*rtk->nx];
+    }
+}
+static void setstates(const rtk_t *rtk, const double *xs, const double *Ps,
+                      double *x, double *P)
+{
+    int i,j,n=rtk->nxs;
+
+    for (i=0;i<n;i++) {
+        if (xs) x[rtk->ixs[i]]=xs[i];
+        if (!Ps) continue;
+        for (j=0;j<n;j++) P[rtk->ixs[i]+rtk->ixs[j]*rtk->nx]=Ps[i+j*n];
+    }
+}
 /* baseline length constraint ------------------------------------------------*/
 static int constbl(rtk_t *rtk, const double *x, const double *P, double *v,
                    double *H, double *Ri, double *Rj, int index)
@@ -1104,7 +1208,7 @@ static int constbl(rtk_t *rtk, const double *x, const double *P, double *v,
 
     /* approximate variance of solution */
     if (P) {
-        for (i=0;i<3;i++) var+=P[i+i*rtk->nx];
+        for (i=0;i<3;i++) var+=varstate(rtk,P,i);
         var/=3.0;
     }
     /* check nonlinearity */
@@ -1116,7 +1220,7 @@ static int constbl(rtk_t *rtk, const double *x, const double *P, double *v,
     /* constraint to baseline length */
     v[index]=rtk->opt.baseline[0]-bb;
     if (H) {
-        for (i=0;i<3;i++) H[i+index*rtk->nx]=b[i]/bb;
+        for (i=0;i<3;i++) setpartial(rtk,H+index*rtk->nxs,i,b[i]/bb);
     }
     Ri[index]=0.0;
     Rj[index]=SQR(rtk->opt.baseline[1]);
@@ -1190,7 +1294,7 @@ static int ddres(rtk_t *rtk, const obsd_t *obs, double dt, const double *x,
     double bl,dr[3],posu[3],posr[3],didxi=0.0,didxj=0.0,*im,icb,threshadj;
     double *tropr,*tropu,*dtdxr,*dtdxu,*Ri,*Rj,freqi,freqj,*Hi=NULL,df;
     int i,j,k,m,f,nv=0,nb[NFREQ*NSYS*2+2]={0},b=0,sysi,sysj,nf=NF(opt);
-    int ii,jj,frq,code;
+    int ii,jj,frq,code,mark=wspmark(&rtk->ws);
 
     trace(3,"ddres   : dt=%.4f ns=%d\n",dt,ns);
 
@@ -1199,8 +1303,10 @@ static int ddres(rtk_t *rtk, const obsd_t *obs, double dt, const double *x,
     /* translate ecef pos to geodetic pos */
     ecef2pos(x,posu); ecef2pos(rtk->rb,posr);
 
-    Ri=mat(ns*nf*2+2,1); Rj=mat(ns*nf*2+2,1); im=mat(ns,1);
-    tropu=mat(ns,1); tropr=mat(ns,1); dtdxu=mat(ns,3); dtdxr=mat(ns,3);
+    Ri=wspmat(&rtk->ws,ns*nf*2+2,1); Rj=wspmat(&rtk->ws,ns*nf*2+2,1);
+    im=wspmat(&rtk->ws,ns,1); tropu=wspmat(&rtk->ws,ns,1);
+    tropr=wspmat(&rtk->ws,ns,1); dtdxu=wspmat(&rtk->ws,ns,3);
+    dtdxr=wspmat(&rtk->ws,ns,3);
 
     /* zero out residual phase and code biases for all satellites */
     for (i=0;i<MAXSAT;i++) for (j=0;j<NFREQ;j++) {
@@ -1248,8 +1354,8 @@ static int ddres(rtk_t *rtk, const obsd_t *obs, double dt, const double *x,
                 if (!validobs(iu[j],ir[j],f,nf,y)) continue;
 
                 if (H) {
-                    Hi=H+nv*rtk->nx;
-                    for (k=0;k<rtk->nx;k++) Hi[k]=0.0;
+                    Hi=H+nv*rtk->nxs;
+                    for (k=0;k<rtk->nxs;k++) Hi[k]=0.0;
                 }
 
                 /* double-differenced measurements from 2 receivers and 2 sats in meters */
@@ -1259,7 +1365,7 @@ static int ddres(rtk_t *rtk, const obsd_t *obs, double dt, const double *x,
                 /* partial derivatives by rover position, combine unit vectors from two sats */
                 if (H) {
                     for (k=0;k<3;k++) {
-                        Hi[k]=-e[k+iu[i]*3]+e[k+iu[j]*3];  /* translation of innovation to position states */
+                        setpartial(rtk,Hi,k,-e[k+iu[i]*3]+e[k+iu[j]*3]);  /* translation of innovation to position states */
                     }
                 }
                 if (opt->ionoopt==IONOOPT_EST) {
@@ -1268,8 +1374,8 @@ static int ddres(rtk_t *rtk, const obsd_t *obs, double dt, const double *x,
                     didxj=(code?-1.0:1.0)*im[j]*SQR(FREQL1/freqj);
                     v[nv]-=didxi*x[II(sat[i],opt)]-didxj*x[II(sat[j],opt)];
                     if (H) {
-                        Hi[II(sat[i],opt)]= didxi;
-                        Hi[II(sat[j],opt)]=-didxj;
+                        setpartial(rtk,Hi,II(sat[i],opt), didxi);
+                        setpartial(rtk,Hi,II(sat[j],opt),-didxj);
                     }
                 }
                 if (opt->tropopt>=TROPOPT_EST) {
@@ -1277,8 +1383,8 @@ static int ddres(rtk_t *rtk, const obsd_t *obs, double dt, const double *x,
                     v[nv]-=(tropu[i]-tropu[j])-(tropr[i]-tropr[j]);
                     for (k=0;k<(opt->tropopt<TROPOPT_ESTG?1:3);k++) {
                         if (!H) continue;
-                        Hi[IT(0,opt)+k]= (dtdxu[k+i*3]-dtdxu[k+j*3]);
-                        Hi[IT(1,opt)+k]=-(dtdxr[k+i*3]-dtdxr[k+j*3]);
+                        setpartial(rtk,Hi,IT(0,opt)+k, (dtdxu[k+i*3]-dtdxu[k+j*3]));
+                        setpartial(rtk,Hi,IT(1,opt)+k,-(dtdxr[k+i*3]-dtdxr[k+j*3]));
                     }
                 }
                 ii=IB(sat[i],frq,opt);
@@ -1290,15 +1396,15 @@ static int ddres(rtk_t *rtk, const obsd_t *obs, double dt, const double *x,
                         /* phase-bias states are single-differenced so need to difference them */
                         v[nv]-=CLIGHT/freqi*x[ii]-CLIGHT/freqj*x[jj];
                         if (H) {
-                        Hi[ii]= CLIGHT/freqi;
-                        Hi[jj]=-CLIGHT/freqj;
+                        setpartial(rtk,Hi,ii, CLIGHT/freqi);
+                        setpartial(rtk,Hi,jj,-CLIGHT/freqj);
                         }
                     }
                     else {
                         v[nv]-=x[ii]-x[jj];
                         if (H) {
-                            Hi[ii]= 1.0;
-                            Hi[jj]=-1.0;
+                            setpartial(rtk,Hi,ii, 1.0);
+                            setpartial(rtk,Hi,jj,-1.0);
                         }
                     }
                 }
@@ -1310,7 +1416,7 @@ static int ddres(rtk_t *rtk, const obsd_t *obs, double dt, const double *x,
                         /* auto-cal method */
                         df=(freqi-freqj)/(f==0?DFRQ1_GLO:DFRQ2_GLO);
                         v[nv]-=df*x[IL(frq,opt)];
-                        if (H) Hi[IL(frq,opt)]=df;
+                        if (H) setpartial(rtk,Hi,IL(frq,opt),df);
                     }
                     else if (rtk->opt.glomodear==GLO_ARMODE_FIXHOLD && frq<NFREQGLO) {
                         /* fix-and-hold method */
@@ -1333,8 +1439,8 @@ static int ddres(rtk_t *rtk, const obsd_t *obs, double dt, const double *x,
                 else      rtk->ssat[sat[j]-1].resc[frq]=v[nv];  /* carrier phase */
 
                 /* open up outlier threshold if one of the phase biases was just initialized */
-                threshadj=(P[ii+rtk->nx*ii]==SQR(rtk->opt.std[0]))||
-                    (P[jj+rtk->nx*jj]==SQR(rtk->opt.std[0]))?10:1;
+                threshadj=(varstate(rtk,P,ii)==SQR(rtk->opt.std[0]))||
+                    (varstate(rtk,P,jj)==SQR(rtk->opt.std[0]))?10:1;
                 /* if residual too large, flag as outlier */
                 if (fabs(v[nv])>opt->maxinno[code]*threshadj) {
                     rtk->ssat[sat[j]-1].vsat[frq]=0;
@@ -1373,7 +1479,7 @@ static int ddres(rtk_t *rtk, const obsd_t *obs, double dt, const double *x,
                 jj=IB(sat[j],frq,&rtk->opt);
                 trace(3,"sat=%3d-%3d %s%d v=%13.3f R=%9.6f %9.6f icb=%9.3f lock=%5d x=%9.3f P=%.3f\n",
                         sat[i],sat[j],code?"P":"L",frq+1,v[nv],Ri[nv],Rj[nv],icb,
-                        rtk->ssat[sat[j]-1].lock[frq],x[jj],P[jj+jj*rtk->nx]);
+                        rtk->ssat[sat[j]-1].lock[frq],x[jj],varstate(rtk,P,jj));
 
                 vflg[nv++]=(sat[i]<<16)|(sat[j]<<8)|((code?1:0)<<4)|(frq);
                 nb[b]++;
@@ -1387,13 +1493,12 @@ static int ddres(rtk_t *rtk, const obsd_t *obs, double dt, const double *x,
         vflg[nv++]=3<<4;
         nb[b++]++;
     }
-    if (H) {trace(5,"H=\n"); tracemat(5,H,rtk->nx,nv,7,4);}
+    if (H) {trace(5,"H=\n"); tracemat(5,H,rtk->nxs,nv,7,4);}
 
     /* double-differenced measurement error covariance */
     ddcov(nb,b,Ri,Rj,nv,R);
 
-    free(Ri); free(Rj); free(im);
-    free(tropu); free(tropr); free(dtdxu); free(dtdxr);
+    wsprelease(&rtk->ws,mark);
 
     return nv;
 }
@@ -1404,33 +1509,46 @@ static int ddres(rtk_t *rtk, const obsd_t *obs, double dt, const double *x,
 static double intpres(gtime_t time, const obsd_t *obs, int n, const nav_t *nav,
                       rtk_t *rtk, double *y)
 {
-    static obsd_t obsb[MAXOBS];
-    static double yb[MAXOBS*NFREQ*2],rs[MAXOBS*6],dts[MAXOBS*2],var[MAXOBS];
-    static double e[MAXOBS*3],azel[MAXOBS*2],freq[MAXOBS*NFREQ];
-    static int nb=0,svh[MAXOBS*2];
+    obsd_t *obsb;
     prcopt_t *opt=&rtk->opt;
-    double tt,ttb,*p,*q;
-    int i,j,k,nf=NF(opt);
+    double tt,ttb,*p,*q,*yb,*rs,*dts,*var,*e,*azel,*freq;
+    int i,j,k,nb,nf=NF(opt),mark,*svh;
 
     tt=timediff(time,obs[0].time); /* time delta between rover obs and current base obs */
     trace(3,"intpres : n=%d tt=%.1f, epoch=%d\n",n,tt,rtk->epoch);
+
+    if (!rtk->obsb&&!(rtk->obsb=(obsd_t *)malloc(sizeof(obsd_t)*MAXOBS))) {
+        return tt;
+    }
+    obsb=rtk->obsb;
+
     /* use current base obs if first epoch or delta time between rover obs and
        current base obs very small */
-    if (nb==0||rtk->epoch==0||fabs(tt)<DTTOL) {
-        nb=n; for (i=0;i<n;i++) obsb[i]=obs[i];  /* current base obs -> previous base obs */
+    if (rtk->nb==0||rtk->epoch==0||fabs(tt)<DTTOL) {
+        rtk->nb=n; for (i=0;i<n;i++) obsb[i]=obs[i];  /* current base obs -> previous base obs */
         return tt;
     }
+    nb=rtk->nb;
+
     /* use current base obs if delta time between rover obs and previous base obs too large
        or same as between current base and rover */
     ttb=timediff(time,obsb[0].time); /* time delta between rover obs and previous base obs */
 
     if (fabs(ttb)>opt->maxtdiff*2.0||ttb==tt) return tt;
 
+    mark=wspmark(&rtk->ws);
+    yb=wspmat(&rtk->ws,nb,NFREQ*2); rs=wspmat(&rtk->ws,nb,6);
+    dts=wspmat(&rtk->ws,nb,2); var=wspmat(&rtk->ws,nb,1);
+    e=wspmat(&rtk->ws,nb,3); azel=wspmat(&rtk->ws,nb,2);
+    freq=wspmat(&rtk->ws,nb,NFREQ); svh=wspimat(&rtk->ws,nb,2);
+
     /* calculate sat positions for previous base obs */
     satposs(time,obsb,nb,nav,opt->sateph,rs,dts,var,svh);
 
     /* calculate [measured pseudorange - range] for previous base obs */
-    if (!zdres(1,obsb,nb,rs,dts,var,svh,nav,rtk->rb,opt,yb,e,azel,freq)) {
+    if (!zdres(1,obsb,nb,rs,dts,var,svh,nav,rtk->rb,opt,rtk->pool,yb,e,azel,
+               freq)) {
+        wsprelease(&rtk->ws,mark);
         return tt;
     }
     /* interpolate previous and current base obs */
@@ -1449,6 +1567,7 @@ static double intpres(gtime_t time, const obsd_t *obs, int n, const nav_t *nav,
                *p=(ttb*(*p)-tt*(*q))/(ttb-tt);
         }
     }
+    wsprelease(&rtk->ws,mark);
     return fabs(ttb)<fabs(tt)?ttb:tt;
 }
 /* index for single to double-difference transformation matrix (D') --------------------*/
@@ -1551,13 +1670,15 @@ static void restamb(rtk_t *rtk, const double *bias, int nb, double *xa)
 /* hold integer ambiguity ----------------------------------------------------*/
 static void holdamb(rtk_t *rtk, const double *xa)
 {
-    double *v,*H,*R;
+    double *v,*H,*R,*xs,*Ps;
     int i,j,n,m,f,info,index[MAXSAT],nb=rtk->nx-rtk->na,nv=0,nf=NF(&rtk->opt);
+    int mark=wspmark(&rtk->ws);
     double dd;
     
     trace(3,"holdamb :\n");
 
-    v=mat(nb,1); H=zeros(nb,rtk->nx);
+    actstates(rtk);
+    v=wspmat(&rtk->ws,nb,1); H=wspzeros(&rtk->ws,nb,rtk->nxs);
 
     for (m=0;m<6;m++) for (f=0;f<nf;f++) {
 
@@ -1576,27 +1697,30 @@ static void holdamb(rtk_t *rtk, const double *xa)
                  double diff: v(nv)=err(i)-err(0) */
             v[nv]=(xa[index[0]]-xa[index[i]])-(rtk->x[index[0]]-rtk->x[index[i]]);
 
-            H[index[0]+nv*rtk->nx]= 1.0;
-            H[index[i]+nv*rtk->nx]=-1.0;
+            setpartial(rtk,H+nv*rtk->nxs,index[0], 1.0);
+            setpartial(rtk,H+nv*rtk->nxs,index[i],-1.0);
             nv++;
         }
     }
     /* return if less than min sats for hold (skip if fix&hold for GLONASS only) */
     if (rtk->opt.modear==ARMODE_FIXHOLD&&nv<rtk->opt.minholdsats) {
         trace(3,"holdamb: not enough sats to hold ambiguity\n");
-        free(v); free(H);
+        wsprelease(&rtk->ws,mark);
         return;
     }
 
     rtk->holdamb=1;  /* set flag to indicate hold has occurred */
-    R=zeros(nv,nv);
+    R=wspzeros(&rtk->ws,nv,nv);
     for (i=0;i<nv;i++) R[i+i*nv]=rtk->opt.varholdamb;
 
     /* update states with constraints */
-    if ((info=filter(rtk->x,rtk->P,H,v,R,rtk->nx,nv))) {
+    xs=wspmat(&rtk->ws,rtk->nxs,1); Ps=wspmat(&rtk->ws,rtk->nxs,rtk->nxs);
+    getstates(rtk,rtk->x,rtk->P,xs,Ps);
+    if ((info=filterc(xs,Ps,H,v,R,rtk->nxs,nv,0,&rtk->ws))) {
         errmsg(rtk,"filter error (info=%d)\n",info);
     }
-    free(R);free(v); free(H);
+    else setstates(rtk,xs,Ps,rtk->x,rtk->P);
+    wsprelease(&rtk->ws,mark);
 
     /* skip glonass/sbs icbias update if not enabled  */
     if (rtk->opt.glomodear!=GLO_ARMODE_FIXHOLD) return;
@@ -1645,15 +1769,63 @@ static void holdamb(rtk_t *rtk, const double *xa)
         }
     }
 }
+/* initial lambda reduction matrix from previous epoch -------------------------
+* the reduction matrix of the previous search is reused if the double-
+* differenced ambiguities are the same or one ambiguity is added. otherwise
+* the identity is set for the cold start.
+*-----------------------------------------------------------------------------*/
+static void initambz(const rtk_t *rtk, const int *ix, int nb, double *Z)
+{
+    int i,j,k,l,nnew=0,nold=0,map[MAXSAT*NFREQ];
+    
+    for (i=0;i<nb*nb;i++) Z[i]=0.0;
+    for (i=0;i<nb;i++) Z[i+i*nb]=1.0;
+    
+    if (rtk->namb<=0||nb>MAXSAT*NFREQ||nb<rtk->namb||nb>rtk->namb+1) return;
+    
+    /* map ambiguities to those of previous search */
+    for (i=0;i<nb;i++) {
+        for (j=0;j<rtk->namb;j++) {
+            if (rtk->ixamb[j*2]==ix[i*2]&&rtk->ixamb[j*2+1]==ix[i*2+1]) break;
+        }
+        if (j<rtk->namb) {map[i]=j; nold++;} else {map[i]=-1; nnew++;}
+    }
+    if (nold!=rtk->namb||nnew>1) return;
+    
+    for (i=0;i<nb;i++) for (k=0;k<nb;k++) {
+        if ((j=map[i])<0||(l=map[k])<0) continue;
+        Z[i+k*nb]=rtk->Zamb[j+l*rtk->namb];
+    }
+}
+/* save lambda reduction matrix ----------------------------------------------*/
+static void saveambz(rtk_t *rtk, const int *ix, int nb, const double *Z)
+{
+    double *Zamb;
+    int *ixamb;
+    
+    if (nb>rtk->nambmax) {
+        if (!(Zamb=(double *)realloc(rtk->Zamb,sizeof(double)*nb*nb))||
+            !(ixamb=(int *)realloc(rtk->ixamb,sizeof(int)*nb*2))) {
+            if (Zamb) rtk->Zamb=Zamb;
+            rtk->namb=0;
+            return;
+        }
+        rtk->Zamb=Zamb; rtk->ixamb=ixamb; rtk->nambmax=nb;
+    }
+    memcpy(rtk->Zamb,Z,sizeof(double)*nb*nb);
+    memcpy(rtk->ixamb,ix,sizeof(int)*nb*2);
+    rtk->namb=nb;
+}
 /* resolve integer ambiguity by LAMBDA ---------------------------------------*/
 static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa,int gps,int glo,int sbs)
 {
     prcopt_t *opt=&rtk->opt;
-    int i,j,nb,nb1,info,nx=rtk->nx,na=rtk->na;
-    double *DP,*y,*b,*db,*Qb,*Qab,*QQ,s[2];
+    int i,j,nb,nb1,info,nx=rtk->nx,na=rtk->na,mark=wspmark(&rtk->ws);
+    double *DP,*y,*b,*db,*Qb,*Qab,*QQ,*Z=NULL,s[2];
     int *ix;
     double coeff[3];
     double QQb[MAXSAT];
+    lambstat_t lstat;
 
     trace(3,"resamb_LAMBDA : nx=%d\n",nx);
 
@@ -1661,16 +1833,18 @@ static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa,int gps,int glo,in
     rtk->nb_ar=0;
     /* Create index of single to double-difference transformation matrix (D')
           used to translate phase biases to double difference */
-    ix=imat(nx,2);
+    ix=wspimat(&rtk->ws,nx,2);
     if ((nb=ddidx(rtk,ix,gps,glo,sbs))<(rtk->opt.minfixsats-1)) {  /* nb is sat pairs */
         errmsg(rtk,"not enough valid double-differences\n");
-        free(ix);
+        wsprelease(&rtk->ws,mark);
         return -1; /* flag abort */
     }
     rtk->nb_ar=nb;
     /* nx=# of float states, na=# of fixed states, nb=# of double-diff phase biases */
-    y=mat(nb,1); DP=mat(nb,nx-na); b=mat(nb,2); db=mat(nb,1); Qb=mat(nb,nb);
-    Qab=mat(na,nb); QQ=mat(na,nb);
+    y=wspmat(&rtk->ws,nb,1); DP=wspmat(&rtk->ws,nb,nx-na);
+    b=wspmat(&rtk->ws,nb,2); db=wspmat(&rtk->ws,nb,1);
+    Qb=wspmat(&rtk->ws,nb,nb); Qab=wspmat(&rtk->ws,na,nb);
+    QQ=wspmat(&rtk->ws,na,nb);
 
     /* phase-bias covariance (Qb) and real-parameters to bias covariance (Qab) */
     /* y=D*xc, Qb=D*Qc*D', Qab=Qac*D' */
@@ -1694,7 +1868,22 @@ static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa,int gps,int glo,in
     /* lambda/mlambda integer least-square estimation */
     /* return best integer solutions */
     /* b are best integer solutions, s are residuals */
-    if (!(info=lambda(nb,2,y,Qb,b,s))) {
+    if (opt->arwarm) {
+        Z=wspmat(&rtk->ws,nb,nb);
+        initambz(rtk,ix,nb,Z);
+    }
+    info=lambdaw(nb,2,y,Qb,b,s,Z,&rtk->ws,&lstat);
+    if (opt->arwarm) {
+        if (!info) saveambz(rtk,ix,nb,Z); else rtk->namb=0;
+    }
+    rtk->nlamb++;
+    rtk->lstat.nloop+=lstat.nloop;
+    rtk->lstat.nnode+=lstat.nnode;
+    rtk->lstat.ncand+=lstat.ncand;
+    rtk->lstat.nperm+=lstat.nperm;
+    trace(4,"lambda: nloop=%d nnode=%d ncand=%d nperm=%d\n",lstat.nloop,
+          lstat.nnode,lstat.ncand,lstat.nperm);
+    if (!info) {
         trace(3,"N(1)=     "); tracemat(3,b   ,1,nb,7,2);
         trace(3,"N(2)=     "); tracemat(3,b+nb,1,nb,7,2);
 
@@ -1734,7 +1923,7 @@ static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa,int gps,int glo,in
                 y[i]-=b[i];
             }
             /* adjust non phase-bias states and covariances using fixed solution values */
-            if (!matinv(Qb,nb)) {  /* returns 0 if inverse successful */
+            if (!matinvw(Qb,nb,&rtk->ws)) {  /* returns 0 if inverse successful */
                 /* rtk->xa = rtk->x-Qab*Qb^-1*(b0-b) */
                 matmul("NN",nb,1,nb,Qb ,y,db); /* db = Qb^-1*(b0-b) */
                 matmulm("NN",na,1,nb,Qab,db,rtk->xa); /* rtk->xa = rtk->x-Qab*db */
@@ -1763,8 +1952,7 @@ static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa,int gps,int glo,in
         errmsg(rtk,"lambda error (info=%d)\n",info);
         nb=0;
     }
-    free(ix);
-    free(y); free(DP); free(b); free(db); free(Qb); free(Qab); free(QQ);
+    wsprelease(&rtk->ws,mark);
 
     return nb; /* number of ambiguities */
 }
@@ -1906,24 +2094,24 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
 {
     prcopt_t *opt=&rtk->opt;
     gtime_t time=obs[0].time;
-    double *rs,*dts,*var,*y,*e,*azel,*freq,*v,*H,*R,*xp,*Pp,*xa,*bias,dt;
+    double *rs,*dts,*var,*y,*e,*azel,*freq,*v,*H,*R,*xp,*xs,*Pp,*xa,*bias,dt;
     int i,j,f,n=nu+nr,ns,ny,nv,sat[MAXSAT],iu[MAXSAT],ir[MAXSAT];
     int info,vflg[MAXOBS*NFREQ*2+1],svh[MAXOBS*2];
     int stat=rtk->opt.mode<=PMODE_DGPS?SOLQ_DGPS:SOLQ_FLOAT;
-    int nf=opt->ionoopt==IONOOPT_IFLC?1:opt->nf;
+    int nf=opt->ionoopt==IONOOPT_IFLC?1:opt->nf,mark=wspmark(&rtk->ws);
 
     /* time diff between base and rover observations */
     dt=timediff(time,obs[nu].time);
     trace(3,"relpos  : dt=%.3f nu=%d nr=%d\n",dt,nu,nr);
 
     /* define local matrices, n=total observations, base + rover */
-    rs=mat(6,n);            /* range to satellites */
-    dts=mat(2,n);           /* satellite clock biases */
-    var=mat(1,n);
-    y=mat(nf*2,n);
-    e=mat(3,n);
-    azel=zeros(2,n);        /* [az, el] */
-    freq=zeros(nf,n);
+    rs=wspmat(&rtk->ws,6,n);            /* range to satellites */
+    dts=wspmat(&rtk->ws,2,n);           /* satellite clock biases */
+    var=wspmat(&rtk->ws,1,n);
+    y=wspmat(&rtk->ws,nf*2,n);
+    e=wspmat(&rtk->ws,3,n);
+    azel=wspzeros(&rtk->ws,2,n);        /* [az, el] */
+    freq=wspzeros(&rtk->ws,nf,n);
 
     /* init satellite status arrays */
     for (i=0;i<MAXSAT;i++) {
@@ -1941,11 +2129,10 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
          output is in y[nu:nu+nr], see call for rover below for more details                                                 */
     trace(3,"base station:\n");
     if (!zdres(1,obs+nu,nr,rs+nu*6,dts+nu*2,var+nu,svh+nu,nav,rtk->rb,opt,
-               y+nu*nf*2,e+nu*3,azel+nu*2,freq+nu*nf)) {
+               rtk->pool,y+nu*nf*2,e+nu*3,azel+nu*2,freq+nu*nf)) {
         errmsg(rtk,"initial base station position error\n");
 
-        free(rs); free(dts); free(var); free(y); free(e); free(azel);
-        free(freq);
+        wsprelease(&rtk->ws,mark);
         return 0;
     }
     /* time-interpolation of base residuals (for post-processing)  */
@@ -1956,8 +2143,7 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
     if ((ns=selsat(obs,azel,nu,nr,opt,sat,iu,ir))<=0) {
         errmsg(rtk,"no common satellite\n");
 
-        free(rs); free(dts); free(var); free(y); free(e); free(azel);
-        free(freq);
+        wsprelease(&rtk->ws,mark);
         return 0;
     }
     /* update kalman filter states (pos,vel,acc,ionosp, troposp, sat phase biases) */
@@ -1972,13 +2158,16 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
         rtk->ssat[sat[i]-1].snr_base[j] =obs[ir[i]].SNR[j];
     }
 
-    /* initialize Pp,xa to zero, xp to rtk->x */
-    xp=mat(rtk->nx,1); Pp=zeros(rtk->nx,rtk->nx); xa=mat(rtk->nx,1);
+    /* index active states, xp to rtk->x, xs,Pp to active states of rtk->x,P */
+    actstates(rtk);
+    xp=wspmat(&rtk->ws,rtk->nx,1); xs=wspmat(&rtk->ws,rtk->nxs,1);
+    Pp=wspmat(&rtk->ws,rtk->nxs,rtk->nxs); xa=wspmat(&rtk->ws,rtk->nx,1);
     matcpy(xp,rtk->x,rtk->nx,1);
-    matcpy(Pp,rtk->P,rtk->nx,rtk->nx);
+    getstates(rtk,rtk->x,rtk->P,NULL,Pp);
 
     ny=ns*nf*2+2;
-    v=mat(ny,1); H=zeros(rtk->nx,ny); R=mat(ny,ny); bias=mat(rtk->nx,1);
+    v=wspmat(&rtk->ws,ny,1); H=wspzeros(&rtk->ws,rtk->nxs,ny);
+    R=wspmat(&rtk->ws,ny,ny); bias=wspmat(&rtk->ws,rtk->nx,1);
 
     trace(3,"rover:  dt=%.3f\n",dt);
     for (i=0;i<opt->niter;i++) {
@@ -1995,7 +2184,7 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
                 y    = zero diff residuals (code and phase)
                 e    = line of sight unit vectors to sats
                 azel = [az, el] to sats                                   */
-        if (!zdres(0,obs,nu,rs,dts,var,svh,nav,xp,opt,y,e,azel,freq)) {
+        if (!zdres(0,obs,nu,rs,dts,var,svh,nav,xp,opt,rtk->pool,y,e,azel,freq)) {
             errmsg(rtk,"rover initial position error\n");
             stat=SOLQ_NONE;
             break;
@@ -2004,12 +2193,12 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
                 O rtk->ssat[i].resp[j] = residual pseudorange error
                 O rtk->ssat[i].resc[j] = residual carrier phase error
                 I dt = time diff between base and rover observations
-                I Pp = covariance matrix of float solution
+                I Pp = covariance matrix of float solution (active states)
                 I sat = list of common sats
                 I iu,ir = user and ref indices to sats
                 I ns = # of sats
                 O v = double diff residuals (phase and code)
-                O H = partial derivatives
+                O H = partial derivatives (active states)
                 O R = double diff measurement error covariances
                 O vflg = list of sats used for dd  */
         if ((nv=ddres(rtk,obs,dt,xp,Pp,sat,y,e,azel,freq,iu,ir,ns,v,H,R,vflg))<4) {
@@ -2022,16 +2211,18 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
                 xp=x+K*v
                 Pp=(I-K*H')*P                  */
         trace(3,"before filter x=");tracemat(3,rtk->x,1,9,13,6);
-        if ((info=filter(xp,Pp,H,v,R,rtk->nx,nv))) {
+        getstates(rtk,xp,NULL,xs,NULL);
+        if ((info=filterc(xs,Pp,H,v,R,rtk->nxs,nv,opt->seqfilter,&rtk->ws))) {
             errmsg(rtk,"filter error (info=%d)\n",info);
             stat=SOLQ_NONE;
             break;
         }
+        setstates(rtk,xs,NULL,xp,NULL);
         trace(3,"after filter x=");tracemat(3,xp,1,9,13,6);
         trace(4,"x(%d)=",i+1); tracemat(4,xp,1,NR(opt),13,4);
     }
     /* calc zero diff residuals again after kalman filter update */
-    if (stat!=SOLQ_NONE&&zdres(0,obs,nu,rs,dts,var,svh,nav,xp,opt,y,e,azel,freq)) {
+    if (stat!=SOLQ_NONE&&zdres(0,obs,nu,rs,dts,var,svh,nav,xp,opt,rtk->pool,y,e,azel,freq)) {
 
         /* calc double diff residuals again after kalman filter update for float solution */
         nv=ddres(rtk,obs,dt,xp,Pp,sat,y,e,azel,freq,iu,ir,ns,v,NULL,R,vflg);
@@ -2041,7 +2232,7 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
 
             /* copy states */
             matcpy(rtk->x,xp,rtk->nx,1);
-            matcpy(rtk->P,Pp,rtk->nx,rtk->nx);
+            setstates(rtk,NULL,Pp,NULL,rtk->P);
 
             /* update valid satellite status for ambiguity control */
             rtk->sol.ns=0;
@@ -2061,7 +2252,7 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
         if (manage_amb_LAMBDA(rtk,bias,xa,sat,nf,ns)>1) {
 
             /* find zero-diff residuals for fixed solution */
-            if (zdres(0,obs,nu,rs,dts,var,svh,nav,xa,opt,y,e,azel,freq)) {
+            if (zdres(0,obs,nu,rs,dts,var,svh,nav,xa,opt,rtk->pool,y,e,azel,freq)) {
 
                 /* post-fit residuals for fixed solution (xa includes fixed phase biases, rtk->xa does not) */
                 nv=ddres(rtk,obs,dt,xa,Pp,sat,y,e,azel,freq,iu,ir,ns,v,NULL,R,vflg);
@@ -2141,13 +2332,24 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
         if (rtk->ssat[i].lock[j]<0||(rtk->nfix>0&&rtk->ssat[i].fix[j]>=2))
             rtk->ssat[i].lock[j]++;
     }
-    free(rs); free(dts); free(var); free(y); free(e); free(azel); free(freq);
-    free(xp); free(Pp);  free(xa);  free(v); free(H); free(R); free(bias);
+    wsprelease(&rtk->ws,mark);
 
     if (stat!=SOLQ_NONE) rtk->sol.stat=stat;
 
     return stat!=SOLQ_NONE;
 }
+/* initial size of workspace (doubles) ---------------------------------------*/
+static int wspsize(const prcopt_t *opt, int nx)
+{
+    int n=MAXOBS*2,ny=MAXOBS*opt->nf*2+2,ns=nx;
+
+    /* typical number of active states in relpos() */
+    if (opt->mode<=PMODE_FIXED) {
+        ns=MIN(nx,NP(opt)+NT(opt)+NL(opt)+MAXOBS*(NF(opt)+(NI(opt)?1:0)));
+    }
+    /* matrices in relpos()/pppos(), workspace for filter grows on demand */
+    return n*(14+opt->nf*3)+nx*3+ns*(ns+1)+ny*(ns+ny+1);
+}
 /* initialize RTK control ------------------------------------------------------
 * initialize RTK control struct
 * args   : rtk_t    *rtk    IO  TKk control/result struct
@@ -2173,6 +2375,9 @@ extern void rtkinit(rtk_t *rtk, const prcopt_t *opt)
     rtk->P=zeros(rtk->nx,rtk->nx);
     rtk->xa=zeros(rtk->na,1);
     rtk->Pa=zeros(rtk->na,rtk->na);
+    wspinit(&rtk->ws,wspsize(opt,rtk->nx));
+    rtk->obsb=NULL;
+    rtk->nb=0;
     rtk->nfix=rtk->neb=0;
     for (i=0;i<MAXSAT;i++) {
         rtk->ambc[i]=ambc0;
@@ -2181,6 +2386,15 @@ extern void rtkinit(rtk_t *rtk, const prcopt_t *opt)
     rtk->holdamb=0;
     rtk->excsat=0;
     rtk->nb_ar=0;
+    rtk->nlamb=0;
+    rtk->lstat.nloop=rtk->lstat.nnode=rtk->lstat.ncand=rtk->lstat.nperm=0;
+    rtk->Zamb=NULL; rtk->ixamb=NULL;
+    rtk->namb=rtk->nambmax=0;
+    rtk->nxs=0;
+    rtk->ixs=imat(rtk->nx,1);
+    rtk->jxs=imat(rtk->nx,1);
+    for (i=0;i<rtk->nx;i++) rtk->jxs[i]=-1;
+    rtk->pool=newexecpool(opt->nthread);
     for (i=0;i<MAXERRMSG;i++) rtk->errbuf[i]=0;
     rtk->opt=*opt;
     rtk->initial_mode=rtk->opt.mode;
@@ -2200,65 +2414,18 @@ extern void rtkfree(rtk_t *rtk)
     free(rtk->P ); rtk->P =NULL;
     free(rtk->xa); rtk->xa=NULL;
     free(rtk->Pa); rtk->Pa=NULL;
+    wspfree(&rtk->ws);
+    free(rtk->obsb); rtk->obsb=NULL; rtk->nb=0;
+    free(rtk->Zamb); rtk->Zamb=NULL;
+    free(rtk->ixamb); rtk->ixamb=NULL;
+    rtk->namb=rtk->nambmax=0;
+    free(rtk->ixs); rtk->ixs=NULL;
+    free(rtk->jxs); rtk->jxs=NULL;
+    rtk->nxs=0;
+    freeexecpool(rtk->pool); rtk->pool=NULL;
 }
-/* precise positioning ---------------------------------------------------------
-* input observation data and navigation message, compute rover position by
-* precise positioning
-* args   : rtk_t *rtk       IO  RTK control/result struct
-*            rtk->sol       IO  solution
-*                .time      O   solution time
-*                .rr[]      IO  rover position/velocity
-*                               (I:fixed mode,O:single mode)
-*                .dtr[0]    O   receiver clock bias (s)
-*                .dtr[1-5]  O   receiver GLO/GAL/BDS/IRN/QZS-GPS time offset (s)
-*                .Qr[]      O   rover position covarinace
-*                .stat      O   solution status (SOLQ_???)
-*                .ns        O   number of valid satellites
-*                .age       O   age of differential (s)
-*                .ratio     O   ratio factor for ambiguity validation
-*            rtk->rb[]      IO  base station position/velocity
-*                               (I:relative mode,O:moving-base mode)
-*            rtk->nx        I   number of all states
-*            rtk->na        I   number of integer states
-*            rtk->ns        O   number of valid satellites in use
-*            rtk->tt        O   time difference between current and previous (s)
-*            rtk->x[]       IO  float states pre-filter and post-filter
-*            rtk->P[]       IO  float covariance pre-filter and post-filter
-*            rtk->xa[]      O   fixed states after AR
-*            rtk->Pa[]      O   fixed covariance after AR
-*            rtk->ssat[s]   IO  satellite {s+1} status
-*                .sys       O   system (SYS_???)
-*                .az   [r]  O   azimuth angle   (rad) (r=0:rover,1:base)
-*                .el   [r]  O   elevation angle (rad) (r=0:rover,1:base)
-*                .vs   [r]  O   data valid single     (r=0:rover,1:base)
-*                .resp [f]  O   freq(f+1) pseudorange residual (m)
-*                .resc [f]  O   freq(f+1) carrier-phase residual (m)
-*                .vsat [f]  O   freq(f+1) data vaild (0:invalid,1:valid)
-*                .fix  [f]  O   freq(f+1) ambiguity flag
-*                               (0:nodata,1:float,2:fix,3:hold)
-*                .slip [f]  O   freq(f+1) cycle slip flag
-*                               (bit8-7:rcv1 LLI, bit6-5:rcv2 LLI,
-*                                bit2:parity unknown, bit1:slip)
-*                .lock [f]  IO  freq(f+1) carrier lock count
-*                .outc [f]  IO  freq(f+1) carrier outage count
-*                .slipc[f]  IO  freq(f+1) cycle slip count
-*                .rejc [f]  IO  freq(f+1) data reject count
-*                .gf        IO  geometry-free phase (L1-L2 or L1-L5) (m)
-*            rtk->nfix      IO  number of continuous fixes of ambiguity
-*            rtk->neb       IO  bytes of error message buffer
-*            rtk->errbuf    IO  error message buffer
-*            rtk->tstr      O   time string for debug
-*            rtk->opt       I   processing options
-*          obsd_t *obs      I   observation data for an epoch
-*                               obs[i].rcv=1:rover,2:reference
-*                               sorted by receiver and satellte
-*          int    n         I   number of observation data
-*          nav_t  *nav      I   navigation messages
-* return : status (0:no solution,1:valid solution)
-* notes  : before calling function, base station position rtk->sol.rb[] should
-*          be properly set for relative mode except for moving-baseline
-*-----------------------------------------------------------------------------*/
-extern int rtkpos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
+/* precise positioning for an epoch -----------------------------------------*/
+static int posepoch(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
 {
     prcopt_t *opt=&rtk->opt;
     sol_t solb={{0}};
@@ -2270,6 +2437,10 @@ extern int rtkpos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
     trace(4,"obs=\n"); traceobs(4,obs,n);
     /*trace(5,"nav=\n"); tracenav(5,nav);*/
 
+    /* reset lambda search statistics */
+    rtk->nlamb=0;
+    rtk->lstat.nloop=rtk->lstat.nnode=rtk->lstat.ncand=rtk->lstat.nperm=0;
+
     /* set base station position */
     if (opt->refpos<=POSOPT_RINEX&&opt->mode!=PMODE_SINGLE&&
         opt->mode!=PMODE_MOVEB) {
@@ -2376,3 +2547,74 @@ extern int rtkpos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
 
     return 1;
 }
+/* precise positioning ---------------------------------------------------------
+* input observation data and navigation message, compute rover position by
+* precise positioning
+* args   : rtk_t *rtk       IO  RTK control/result struct
+*            rtk->sol       IO  solution
+*                .time      O   solution time
+*                .rr[]      IO  rover position/velocity
+*                               (I:fixed mode,O:single mode)
+*                .dtr[0]    O   receiver clock bias (s)
+*                .dtr[1-5]  O   receiver GLO/GAL/BDS/IRN/QZS-GPS time offset (s)
+*                .Qr[]      O   rover position covarinace
+*                .stat      O   solution status (SOLQ_???)
+*                .ns        O   number of valid satellites
+*                .age       O   age of differential (s)
+*                .ratio     O   ratio factor for ambiguity validation
+*            rtk->rb[]      IO  base station position/velocity
+*                               (I:relative mode,O:moving-base mode)
+*            rtk->nx        I   number of all states
+*            rtk->na        I   number of integer states
+*            rtk->ns        O   number of valid satellites in use
+*            rtk->tt        O   time difference between current and previous (s)
+*            rtk->x[]       IO  float states pre-filter and post-filter
+*            rtk->P[]       IO  float covariance pre-filter and post-filter
+*            rtk->xa[]      O   fixed states after AR
+*            rtk->Pa[]      O   fixed covariance after AR
+*            rtk->ssat[s]   IO  satellite {s+1} status
+*                .sys       O   system (SYS_???)
+*                .az   [r]  O   azimuth angle   (rad) (r=0:rover,1:base)
+*                .el   [r]  O   elevation angle (rad) (r=0:rover,1:base)
+*                .vs   [r]  O   data valid single     (r=0:rover,1:base)
+*                .resp [f]  O   freq(f+1) pseudorange residual (m)
+*                .resc [f]  O   freq(f+1) carrier-phase residual (m)
+*                .vsat [f]  O   freq(f+1) data vaild (0:invalid,1:valid)
+*                .fix  [f]  O   freq(f+1) ambiguity flag
+*                               (0:nodata,1:float,2:fix,3:hold)
+*                .slip [f]  O   freq(f+1) cycle slip flag
+*                               (bit8-7:rcv1 LLI, bit6-5:rcv2 LLI,
+*                                bit2:parity unknown, bit1:slip)
+*                .lock [f]  IO  freq(f+1) carrier lock count
+*                .outc [f]  IO  freq(f+1) carrier outage count
+*                .slipc[f]  IO  freq(f+1) cycle slip count
+*                .rejc [f]  IO  freq(f+1) data reject count
+*                .gf        IO  geometry-free phase (L1-L2 or L1-L5) (m)
+*            rtk->nfix      IO  number of continuous fixes of ambiguity
+*            rtk->neb       IO  bytes of error message buffer
+*            rtk->errbuf    IO  error message buffer
+*            rtk->tstr      O   time string for debug
+*            rtk->opt       I   processing options
+*          obsd_t *obs      I   observation data for an epoch
+*                               obs[i].rcv=1:rover,2:reference
+*                               sorted by receiver and satellte
+*          int    n         I   number of observation data
+*          nav_t  *nav      I   navigation messages
+* return : status (0:no solution,1:valid solution)
+* notes  : before calling function, base station position rtk->sol.rb[] should
+*          be properly set for relative mode except for moving-baseline
+*-----------------------------------------------------------------------------*/
+extern int rtkpos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
+{
+    int stat;
+
+    /* reuse satellite states within the epoch */
+    setsatcache(1,rtk->opt.sattol);
+    setsunmoonint(rtk->opt.sunmoonint);
+
+    stat=posepoch(rtk,obs,n,nav);
+
+    setsatcache(0,0.0);
+    setsunmoonint(0.0);
+    return stat;
+}
@@ -176,6 +176,8 @@ static void update_eph(rtksvr_t *svr, nav_t *nav, int ephsat, int ephset,
                  timediff(eph1->toc,eph2->toc)!=0.0)) {
                 *eph3=*eph2; /* current ->previous */
                 *eph2=*eph1; /* received->current */
+                ephconst(eph2);
+                indexnav(&svr->nav);
                 }
             }
             svr->nmsg[index][1]++;
@@ -189,6 +191,7 @@ static void update_eph(rtksvr_t *svr, nav_t *nav, int ephsat, int ephset,
                    (geph1->iode!=geph3->iode&&geph1->iode!=geph2->iode)) {
                    *geph3=*geph2;
                    *geph2=*geph1;
+                   indexnav(&svr->nav);
                 update_glofcn(svr);
                }
            }
@@ -209,7 +212,7 @@ static void update_sbs(rtksvr_t *svr, sbsmsg_t *sbsmsg, int index)
                 for (i=0;i<MAXSBSMSG-1;i++) svr->sbsmsg[i]=svr->sbsmsg[i+1];
                 svr->sbsmsg[i]=*sbsmsg;
             }
-            sbsupdatecorr(sbsmsg,&svr->nav);
+            if (sbsupdatecorr(sbsmsg,&svr->nav)==9) indexnav(&svr->nav);
         }
         svr->nmsg[index][3]++;
     }
@@ -397,6 +400,7 @@ static int decoderaw(rtksvr_t *svr, int index)
 static void decodefile(rtksvr_t *svr, int index)
 {
     nav_t nav={0};
+    pstrm_t strm={0};
     char file[1024];
     int nb;
     
@@ -415,6 +419,26 @@ static void decodefile(rtksvr_t *svr, int index)
     
     rtksvrunlock(svr);
     
+    if (svr->rtk.opt.pephstrm) { /* precise ephemeris/clock stream */
+        
+        /* open sp3 precise ephemeris or rinex clock stream */
+        if (openpstrm(&strm,file,0)<=0) {
+            tracet(1,"precise eph/clock file open error: %s\n",file);
+            return;
+        }
+        /* replace stream and clear window */
+        rtksvrlock(svr);
+        
+        closepstrm(svr->pstrm+index);
+        svr->pstrm[index]=strm;
+        if (svr->format[index]==STRFMT_SP3) svr->nav.ne=0;
+        else svr->nav.nc=0;
+        svr->ftime[index]=utc2gpst(timeget());
+        strcpy(svr->files[index],file);
+        
+        rtksvrunlock(svr);
+        return;
+    }
     if (svr->format[index]==STRFMT_SP3) { /* precise ephemeris */
         
         /* read sp3 precise ephemeris */
@@ -426,6 +450,7 @@ static void decodefile(rtksvr_t *svr, int index)
         /* update precise ephemeris */
         rtksvrlock(svr);
         
+        closepstrm(svr->pstrm+index);
         if (svr->nav.peph) free(svr->nav.peph);
         svr->nav.ne=svr->nav.nemax=nav.ne;
         svr->nav.peph=nav.peph;
@@ -444,6 +469,7 @@ static void decodefile(rtksvr_t *svr, int index)
         /* update precise clock */
         rtksvrlock(svr);
         
+        closepstrm(svr->pstrm+index);
         if (svr->nav.pclk) free(svr->nav.pclk);
         svr->nav.nc=svr->nav.ncmax=nav.nc;
         svr->nav.pclk=nav.pclk;
@@ -640,6 +666,10 @@ static void *rtksvrthread(void *arg)
             }
             /* rtk positioning */
             rtksvrlock(svr);
+            for (j=0;j<3;j++) {
+                if (svr->pstrm[j].n<=0) continue;
+                updpstrm(svr->pstrm+j,obs.data[0].time,&svr->nav);
+            }
             rtkpos(&svr->rtk,obs.data,obs.n,&svr->nav);
             rtksvrunlock(svr);
             
@@ -723,6 +753,7 @@ extern int rtksvrinit(rtksvr_t *svr)
     for (i=0;i<3;i++) for (j=0;j<10;j++) svr->nmsg[i][j]=0;
     for (i=0;i<3;i++) svr->ftime[i]=time0;
     for (i=0;i<3;i++) svr->files[i][0]='\0';
+    memset(svr->pstrm,0,sizeof(svr->pstrm));
     svr->moni=NULL;
     svr->tick=0;
     svr->thread=0;
@@ -742,6 +773,7 @@ extern int rtksvrinit(rtksvr_t *svr)
     svr->nav.n =MAXSAT *2;
     svr->nav.ng=NSATGLO*2;
     svr->nav.ns=NSATSBS*2;
+    indexnav(&svr->nav);
     
     for (i=0;i<3;i++) for (j=0;j<MAXOBSBUF;j++) {
         if (!(svr->obs[i][j].data=(obsd_t *)malloc(sizeof(obsd_t)*MAXOBS))) {
@@ -774,6 +806,10 @@ extern void rtksvrfree(rtksvr_t *svr)
     free(svr->nav.eph );
     free(svr->nav.geph);
     free(svr->nav.seph);
+    freenavidx(&svr->nav);
+    for (i=0;i<3;i++) closepstrm(svr->pstrm+i);
+    free(svr->nav.peph); svr->nav.peph=NULL; svr->nav.ne=svr->nav.nemax=0;
+    free(svr->nav.pclk); svr->nav.pclk=NULL; svr->nav.nc=svr->nav.ncmax=0;
     for (i=0;i<3;i++) for (j=0;j<MAXOBSBUF;j++) {
         free(svr->obs[i][j].data);
     }
@@ -123,7 +123,7 @@ static int tonum(char *buff, const char *sep, double *v)
     
     for (p=buff,n=0;n<MAXFIELD;p=q+len) {
         if ((q=strstr(p,sep))) *q='\0'; 
-        if (*p) v[n++]=atof(p);
+        if (*p) v[n++]=str2dbl(p,NULL);
         if (!q) break;
     }
     return n;
@@ -1273,10 +1273,13 @@ static int outenu(uint8_t *buff, const char *s, const sol_t *sol,
                sep,sqvar(Q[5]),sep,sqvar(Q[2]),sep,sol->age,sep,sol->ratio);
     return (int)(p-(char *)buff);
 }
-/* output solution in the form of NMEA RMC sentence --------------------------*/
+/* output solution in the form of NMEA RMC sentence ----------------------------
+* the direction of the last solution with velocity >= 1 m/s is kept per thread
+* for the solutions with lower velocity
+*-----------------------------------------------------------------------------*/
 extern int outnmea_rmc(uint8_t *buff, const sol_t *sol)
 {
-    static double dirp=0.0;
+    static rtklib_tls double dirp=0.0;
     gtime_t time;
     double ep[6],pos[3],enuv[3],dms1[3],dms2[3],vel,dir,amag=0.0;
     char *p=(char *)buff,*q,sum;
@@ -29,6 +29,19 @@
 #define GME         3.986004415E+14 /* earth gravitational constant */
 #define GMS         1.327124E+20    /* sun gravitational constant */
 #define GMM         4.902801E+12    /* moon gravitational constant */
+#define NTDC        4               /* number of cached tidal displacements */
+
+typedef struct {        /* tidal displacement cache type */
+    gtime_t tutc;       /* time in utc */
+    double rr[3];       /* site position (ecef) (m) */
+    int opt;            /* options (without unavailable parameters) */
+    double erpv[5];     /* earth rotation parameter values at time */
+    double odisp[6*11]; /* ocean loading parameters (opt&2) */
+    double dr[3];       /* displacement by earth tides (ecef) (m) */
+} tdc_t;
+
+static rtklib_tls int tdc_n=0,tdc_i=0; /* number of entries, next entry */
+static rtklib_tls tdc_t tdc[NTDC];     /* cached displacements */
 
 /* function prototypes -------------------------------------------------------*/
 #ifdef IERS_MODEL
@@ -204,36 +217,14 @@ static void tide_pole(gtime_t tut, const double *pos, const double *erpv,
     
     trace(5,"tide_pole : denu=%.3f %.3f %.3f\n",denu[0],denu[1],denu[2]);
 }
-/* tidal displacement ----------------------------------------------------------
-* displacements by earth tides
-* args   : gtime_t tutc     I   time in utc
-*          double *rr       I   site position (ecef) (m)
-*          int    opt       I   options (or of the followings)
-*                                 1: solid earth tide
-*                                 2: ocean tide loading
-*                                 4: pole tide
-*                                 8: elimate permanent deformation
-*          double *erp      I   earth rotation parameters (NULL: not used)
-*          double *odisp    I   ocean loading parameters  (NULL: not used)
-*                                 odisp[0+i*6]: consituent i amplitude radial(m)
-*                                 odisp[1+i*6]: consituent i amplitude west  (m)
-*                                 odisp[2+i*6]: consituent i amplitude south (m)
-*                                 odisp[3+i*6]: consituent i phase radial  (deg)
-*                                 odisp[4+i*6]: consituent i phase west    (deg)
-*                                 odisp[5+i*6]: consituent i phase south   (deg)
-*                                (i=0:M2,1:S2,2:N2,3:K2,4:K1,5:O1,6:P1,7:Q1,
-*                                   8:Mf,9:Mm,10:Ssa)
-*          double *dr       O   displacement by earth tides (ecef) (m)
-* return : none
-* notes  : see ref [1], [2] chap 7
-*          see ref [4] 5.2.1, 5.2.2, 5.2.3
-*          ver.2.4.0 does not use ocean loading and pole tide corrections
+/* tidal displacement without cache -------------------------------------------
+* erpv: earth rotation parameter values at time (zero without erp)
 *-----------------------------------------------------------------------------*/
-extern void tidedisp(gtime_t tutc, const double *rr, int opt, const erp_t *erp,
-                     const double *odisp, double *dr)
+static void tidedisp_(gtime_t tutc, const double *rr, int opt,
+                      const double *erpv, const double *odisp, double *dr)
 {
     gtime_t tut;
-    double pos[2],E[9],drt[3],denu[3],rs[3],rm[3],gmst,erpv[5]={0};
+    double pos[2],E[9],drt[3],denu[3],rs[3],rm[3],gmst;
     int i;
 #ifdef IERS_MODEL
     double ep[6],fhr;
@@ -242,9 +233,6 @@ extern void tidedisp(gtime_t tutc, const double *rr, int opt, const erp_t *erp,
     
     trace(3,"tidedisp: tutc=%s\n",time_str(tutc,0));
     
-    if (erp) {
-        geterp(erp,utc2gpst(tutc),erpv);
-    }
     tut=timeadd(tutc,erpv[2]);
     
     dr[0]=dr[1]=dr[2]=0.0;
@@ -274,15 +262,87 @@ extern void tidedisp(gtime_t tutc, const double *rr, int opt, const erp_t *erp,
 #endif
         for (i=0;i<3;i++) dr[i]+=drt[i];
     }
-    if ((opt&2)&&odisp) { /* ocean tide loading */
+    if (opt&2) { /* ocean tide loading */
         tide_oload(tut,odisp,denu);
         matmul("TN",3,1,3,E,denu,drt);
         for (i=0;i<3;i++) dr[i]+=drt[i];
     }
-    if ((opt&4)&&erp) { /* pole tide */
+    if (opt&4) { /* pole tide */
         tide_pole(tut,pos,erpv,denu);
         matmul("TN",3,1,3,E,denu,drt);
         for (i=0;i<3;i++) dr[i]+=drt[i];
     }
     trace(5,"tidedisp: dr=%.3f %.3f %.3f\n",dr[0],dr[1],dr[2]);
 }
+/* tidal displacement ----------------------------------------------------------
+* displacements by earth tides
+* args   : gtime_t tutc     I   time in utc
+*          double *rr       I   site position (ecef) (m)
+*          int    opt       I   options (or of the followings)
+*                                 1: solid earth tide
+*                                 2: ocean tide loading
+*                                 4: pole tide
+*                                 8: elimate permanent deformation
+*          double *erp      I   earth rotation parameters (NULL: not used)
+*          double *odisp    I   ocean loading parameters  (NULL: not used)
+*                                 odisp[0+i*6]: consituent i amplitude radial(m)
+*                                 odisp[1+i*6]: consituent i amplitude west  (m)
+*                                 odisp[2+i*6]: consituent i amplitude south (m)
+*                                 odisp[3+i*6]: consituent i phase radial  (deg)
+*                                 odisp[4+i*6]: consituent i phase west    (deg)
+*                                 odisp[5+i*6]: consituent i phase south   (deg)
+*                                (i=0:M2,1:S2,2:N2,3:K2,4:K1,5:O1,6:P1,7:Q1,
+*                                   8:Mf,9:Mm,10:Ssa)
+*          double *dr       O   displacement by earth tides (ecef) (m)
+* return : none
+* notes  : see ref [1], [2] chap 7
+*          see ref [4] 5.2.1, 5.2.2, 5.2.3
+*          ver.2.4.0 does not use ocean loading and pole tide corrections
+*          the displacements for identical time, site position, options and
+*          values of the parameters are reused from a cache of the calling
+*          thread. the cache is keyed on the erp values at the time and the
+*          ocean loading parameters, not on their addresses, so reloaded or
+*          updated tables are never served from stale entries.
+*-----------------------------------------------------------------------------*/
+extern void tidedisp(gtime_t tutc, const double *rr, int opt, const erp_t *erp,
+                     const double *odisp, double *dr)
+{
+    tdc_t *p;
+    double erpv[5]={0};
+    int i,j;
+    
+    if (erp) geterp(erp,utc2gpst(tutc),erpv); else opt&=~4;
+    if (!odisp) opt&=~2;
+    
+    for (i=0;i<tdc_n;i++) {
+        p=tdc+i;
+        if (timediff(tutc,p->tutc)!=0.0||p->rr[0]!=rr[0]||p->rr[1]!=rr[1]||
+            p->rr[2]!=rr[2]||p->opt!=opt) {
+            continue;
+        }
+        for (j=0;j<5;j++) if (p->erpv[j]!=erpv[j]) break;
+        if (j<5) continue;
+        if (opt&2) {
+            for (j=0;j<6*11;j++) if (p->odisp[j]!=odisp[j]) break;
+            if (j<6*11) continue;
+        }
+        trace(4,"tidedisp: cached tutc=%s\n",time_str(tutc,0));
+        for (j=0;j<3;j++) dr[j]=p->dr[j];
+        return;
+    }
+    tidedisp_(tutc,rr,opt,erpv,odisp,dr);
+    
+    p=tdc+tdc_i;
+    tdc_i=(tdc_i+1)%NTDC;
+    if (tdc_n<NTDC) tdc_n++;
+    p->tutc=tutc;
+    for (i=0;i<3;i++) {
+        p->rr[i]=rr[i];
+        p->dr[i]=dr[i];
+    }
+    p->opt=opt;
+    for (i=0;i<5;i++) p->erpv[i]=erpv[i];
+    if (opt&2) {
+        for (i=0;i<6*11;i++) p->odisp[i]=odisp[i];
+    }
+}
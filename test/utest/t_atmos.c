@@ -140,11 +140,47 @@ void utest4(void)
     
     printf("%s utest4 : OK\n",__FILE__);
 }
+/* ionmodels(),ionmapfs(),tropmodels(),tropmapfs() */
+void utest5(void)
+{
+    double e1[]={2007,1,16,6,0,0};
+    double ion[]={
+         0.2E-7,-0.8e-8,-0.5e-7, 0.1e-6, 0.2E+6, 0.2e+6,-0.1e+6,-0.1e+7
+    };
+    double pos[][3]={
+        { 35*D2R, 140*D2R, 100.0},{-80*D2R,-170*D2R,1000.0},{10*D2R,30*D2R,0.0},
+        {-45*D2R,  60*D2R, -50.0},{ 35*D2R, 140*D2R,  2E4 }
+    };
+    double azel[72*2],dion[72],mapfi[72],trp[72],mapfh[72],mapfw[72],mw;
+    gtime_t t1=epoch2time(e1);
+    int i,j,n=0;
+    
+    for (i=0;i<36;i++) for (j=-1;j<=90;j+=13) {
+        if (n>=72) break;
+        azel[n*2]=i*10*D2R; azel[1+n*2]=j*D2R; n++;
+    }
+    for (i=0;i<5;i++) {
+        ionmodels(t1,ion,pos[i],azel,n,dion);
+        ionmapfs(pos[i],azel,n,mapfi);
+        tropmodels(t1,pos[i],azel,n,0.7,trp);
+        tropmapfs(t1,pos[i],azel,n,mapfh,mapfw);
+        
+        for (j=0;j<n;j++) {
+            assert(dion [j]==ionmodel(t1,ion,pos[i],azel+j*2));
+            assert(mapfi[j]==ionmapf(pos[i],azel+j*2));
+            assert(trp  [j]==tropmodel(t1,pos[i],azel+j*2,0.7));
+            assert(mapfh[j]==tropmapf(t1,pos[i],azel+j*2,&mw));
+            assert(mapfw[j]==mw);
+        }
+    }
+    printf("%s utest5 : OK\n",__FILE__);
+}
 int main(void)
 {
     utest1();
     utest2();
     utest3();
     utest4();
+    utest5();
     return 0;
 }
@@ -106,9 +106,35 @@ void utest2(void)
     }
     printf("%s utest2 : OK\n",__FILE__);
 }
+void utest3(void)
+{
+    int i,j,n,m,info;
+    double F[10*2],s[2],Z[10*10]={0};
+    lambstat_t stat;
+    wsp_t ws;
+    
+    n=10; m=2;
+    wspinit(&ws,0);
+    for (i=0;i<n;i++) Z[i+i*n]=1.0;
+    info=lambdaw(n,m,a2,Q2,F,s,Z,&ws,&stat); /* cold start */
+    assert(info==0&&stat.nperm>0);
+    
+    info=lambdaw(n,m,a2,Q2,F,s,Z,&ws,&stat); /* warm start */
+    assert(info==0&&stat.nperm==0);
+    
+    for (j=0;j<m;j++) {
+        for (i=0;i<n;i++) {
+            assert(fabs(F[i+j*n]-F2[j+i*m])<1E-4);
+        }
+        assert(fabs(s[j]-s2[j])<1E-4);
+    }
+    wspfree(&ws);
+    printf("%s utest3 : OK\n",__FILE__);
+}
 int main(void)
 {
     utest1();
     utest2();
+    utest3();
     return 0;
 }
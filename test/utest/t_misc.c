@@ -182,11 +182,34 @@ void utest4(void)
     
     printf("%s utset4 : OK\n",__FILE__);
 }
+/* parexec() */
+static void utest51(void *arg, int i)
+{
+    ((int *)arg)[i]+=i+1;
+}
+void utest5(void)
+{
+    execpool_t *pool;
+    int i,n,nthr,a[100];
+    
+    for (nthr=0;nthr<=20;nthr+=4) {
+        pool=newexecpool(nthr);
+        assert(nthr<2?!pool:pool->nthr==(nthr<MAXEXECTHR?nthr:MAXEXECTHR)-1);
+        for (n=0;n<=100;n+=11) {
+            for (i=0;i<100;i++) a[i]=0;
+            parexec(pool,n,utest51,a);
+            for (i=0;i<100;i++) assert(a[i]==(i<n?i+1:0));
+        }
+        freeexecpool(pool);
+    }
+    printf("%s utset5 : OK\n",__FILE__);
+}
 int main(void)
 {
     utest1();
     utest2();
     utest3();
     utest4();
+    utest5();
     return 0;
 }
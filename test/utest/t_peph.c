@@ -0,0 +1,123 @@
+/*------------------------------------------------------------------------------
+* rtklib unit test driver : precise ephemeris interpolation, storage and stream
+*-----------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <assert.h>
+#include "../../src/rtklib.h"
+
+/* pephcoef() */
+void utest1(void)
+{
+    char *file1="../data/sp3/igs1590*.sp3"; /* 2010/7/1 */
+    nav_t nav={0},navc;
+    double ep[]={2010,7,1,0,0,0};
+    double rs1[6],dts1[2],var1,rs2[6],dts2[2],var2;
+    gtime_t t,time;
+    int i,j,sat,stat1,stat2;
+
+    time=epoch2time(ep);
+
+    readsp3(file1,&nav,0);
+        assert(nav.ne>0);
+    navc=nav;
+    stat1=pephcoef(&navc);
+        assert(stat1&&navc.pephc.n==nav.ne-10);
+
+    for (sat=1;sat<=32;sat++) {
+        for (i=3600;i<86400*2-3600;i+=97) {
+            t=timeadd(time,(double)i);
+            stat1=peph2pos(t,sat,&nav ,0,rs1,dts1,&var1);
+            stat2=peph2pos(t,sat,&navc,0,rs2,dts2,&var2);
+                assert(stat1==stat2);
+            if (!stat1) continue;
+            for (j=0;j<3;j++) {
+                assert(fabs(rs1[j]-rs2[j])<1E-5);
+                assert(fabs(rs1[j+3]-rs2[j+3])<1E-2);
+            }
+                assert(fabs(dts1[0]-dts2[0])<1E-13&&var1==var2);
+        }
+    }
+    freepephc(&navc);
+        assert(navc.pephc.n==0&&!navc.pephc.peph);
+    printf("%s utest1 : OK\n",__FILE__);
+}
+/* readsp3() compact storage */
+void utest2(void)
+{
+    char *file1="../data/sp3/igs1590*.sp3"; /* 2010/7/1 */
+    nav_t nav1={0},nav2={0};
+    double ep[]={2010,7,1,0,0,0};
+    double rs1[6],dts1[2],var1,rs2[6],dts2[2],var2;
+    gtime_t t,time;
+    int i,j,sat,stat1,stat2;
+
+    time=epoch2time(ep);
+
+    readsp3(file1,&nav1,0);
+    readsp3(file1,&nav2,16);
+        assert(nav1.ne==192&&nav2.ne==0&&nav2.pephs.ne==192);
+        assert(nav2.pephs.pos[0]&&!nav2.pephs.pos[MAXSAT-1]);
+
+    for (sat=1;sat<=32;sat++) {
+        for (i=-900;i<86400*2+900;i+=97) {
+            t=timeadd(time,(double)i);
+            stat1=peph2pos(t,sat,&nav1,0,rs1,dts1,&var1);
+            stat2=peph2pos(t,sat,&nav2,0,rs2,dts2,&var2);
+                assert(stat1==stat2);
+            for (j=0;j<6;j++) assert(rs1[j]==rs2[j]);
+                assert(dts1[0]==dts2[0]&&dts1[1]==dts2[1]&&var1==var2);
+        }
+    }
+    freenav(&nav1,0x08);
+    freenav(&nav2,0x08);
+        assert(nav2.pephs.ne==0&&!nav2.pephs.time);
+    printf("%s utest2 : OK\n",__FILE__);
+}
+/* precise ephemeris/clock stream */
+void utest3(void)
+{
+    char *file1="../data/sp3/igs1590*.sp3"; /* 2010/7/1-2 */
+    char *file2="../data/sp3/igs15904.clk";
+    nav_t nav1={0},nav2={0};
+    pstrm_t strm={0};
+    double ep[]={2010,7,1,0,0,0};
+    double rs1[6],dts1[2],var1,rs2[6],dts2[2],var2;
+    gtime_t t,time;
+    int i,j,k,sat,stat1,stat2;
+
+    time=epoch2time(ep);
+
+    readsp3(file1,&nav1,0);
+    readrnxc(file2,&nav1);
+    i=openpstrm(&strm,file1,0);
+    j=openpstrm(&strm,file2,0);
+        assert(i==2&&j==1&&strm.n==3);
+
+    for (k=0;k<2;k++) { /* forward and backward */
+        for (i=-900;i<86400*2+900;i+=k?3607:97) {
+            t=timeadd(time,(double)(k?86400*2-i:i));
+            updpstrm(&strm,t,&nav2);
+                assert(nav2.ne<=4*(10+1));
+            for (sat=1;sat<=32;sat++) {
+                stat1=peph2pos(t,sat,&nav1,0,rs1,dts1,&var1);
+                stat2=peph2pos(t,sat,&nav2,0,rs2,dts2,&var2);
+                    assert(stat1==stat2);
+                if (!stat1) continue;
+                for (j=0;j<6;j++) assert(rs1[j]==rs2[j]);
+                    assert(dts1[0]==dts2[0]&&dts1[1]==dts2[1]&&var1==var2);
+            }
+        }
+    }
+    closepstrm(&strm);
+        assert(strm.n==0&&!strm.file);
+    freenav(&nav1,0x08);
+    freenav(&nav2,0x08);
+    printf("%s utest3 : OK\n",__FILE__);
+}
+int main(int argc, char **argv)
+{
+    utest1();
+    utest2();
+    utest3();
+    return 0;
+}
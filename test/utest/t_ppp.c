@@ -71,10 +71,61 @@ void utest3(void)
     }
     printf("%s utset3 : OK\n",__FILE__);
 }
+/* sunmoonpos() and tidedisp() with cache and interpolation */
+void utest4(void)
+{
+    double ep1[]={2010,12,31,8,9,10}; /* utc */
+    double rr[]={-3957198.431,3310198.621,3737713.474}; /* TSKB */
+    double rs0[3],rm0[3],rs1[3],rm1[3],dr0[3],dr1[3],erpv[5]={0};
+    double odisp[6*11]={0};
+    erpd_t data[2]={{0}};
+    erp_t erp={0};
+    gtime_t time;
+    int i,j;
+    
+    setsunmoonint(60.0);
+    for (i=0;i<200;i++) {
+        time=timeadd(epoch2time(ep1),i*1.37);
+        setsunmoonint(0.0);
+        sunmoonpos(time,erpv,rs0,rm0,NULL);
+        setsunmoonint(60.0);
+        sunmoonpos(time,erpv,rs1,rm1,NULL);
+        for (j=0;j<3;j++) {
+            assert(fabs(rs1[j]-rs0[j])<1E-10*norm(rs0,3));
+            assert(fabs(rm1[j]-rm0[j])<1E-8 *norm(rm0,3));
+        }
+    }
+    setsunmoonint(0.0);
+    
+    for (i=0;i<10;i++) {
+        time=timeadd(epoch2time(ep1),i*30.0);
+        tidedisp(time,rr,1,NULL,NULL,dr0);
+        tidedisp(timeadd(time,1.0),rr,1,NULL,NULL,dr1);
+        tidedisp(time,rr,1,NULL,NULL,dr1);
+        for (j=0;j<3;j++) assert(dr1[j]==dr0[j]);
+    }
+    /* parameters updated in place are not taken from cache */
+    time=epoch2time(ep1);
+    odisp[0]=0.01; /* M2 radial */
+    tidedisp(time,rr,2,NULL,odisp,dr0);
+    odisp[0]=0.02;
+    tidedisp(time,rr,2,NULL,odisp,dr1);
+    assert(fabs(norm(dr1,3)-2.0*norm(dr0,3))<1E-12&&norm(dr0,3)>0.0);
+    
+    data[0].mjd=55561.0; data[1].mjd=55562.0;
+    data[0].xp=data[1].xp=0.2*AS2R;
+    erp.n=erp.nmax=2; erp.data=data;
+    tidedisp(time,rr,4,&erp,NULL,dr0);
+    data[0].xp=data[1].xp=0.4*AS2R;
+    tidedisp(time,rr,4,&erp,NULL,dr1);
+    for (j=0;j<3;j++) assert(dr1[j]!=dr0[j]);
+    printf("%s utset4 : OK\n",__FILE__);
+}
 int main(void)
 {
     utest1();
     utest2();
     utest3();
+    utest4();
     return 0;
 }
@@ -208,6 +208,30 @@ void utest6(void)
     }
     printf("%s utest6 : OK\n",__FILE__);
 }
+/* readrnxt() with RINEX OBS cache */
+void utest7(void)
+{
+    char file[]="../data/rinex/07590920.05o";
+    char cache[]="../data/rinex/07590920.05o.rtkc";
+    obs_t obs0={0},obs1={0},obs2={0};
+    nav_t nav0={0},nav1={0},nav2={0};
+    sta_t sta0={""},sta1={""},sta2={""};
+    gtime_t t0={0};
+    int n0,n1,n2;
+    remove(cache);
+    n0=readrnxt(file,1,t0,t0,0.0,"",&obs0,&nav0,&sta0);
+    n1=readrnxt(file,1,t0,t0,0.0,"-CACHE",&obs1,&nav1,&sta1);
+        assert(n0==1&&n1==1&&obs0.n==obs1.n);
+    n2=readrnxt(file,1,t0,t0,0.0,"-CACHE",&obs2,&nav2,&sta2); /* from cache */
+        assert(n2==1&&obs0.n==obs2.n);
+        assert(!memcmp(obs0.data,obs2.data,sizeof(obsd_t)*obs0.n));
+        assert(!memcmp(&sta0,&sta2,sizeof(sta_t)));
+        assert(!memcmp(nav0.glo_fcn,nav2.glo_fcn,sizeof(nav0.glo_fcn)));
+    free(obs0.data); free(obs1.data); free(obs2.data);
+    freenav(&nav0,0xFF); freenav(&nav1,0xFF); freenav(&nav2,0xFF);
+    assert(remove(cache)==0);
+    printf("%s utest7 : OK\n",__FILE__);
+}
 int main(int argc, char **argv)
 {
     utest1();
@@ -216,5 +240,6 @@ int main(int argc, char **argv)
     utest4();
     utest5();
     utest6();
+    utest7();
     return 0;
 }
@@ -294,6 +294,62 @@ void utest11(void)
     
     printf("%s utset11 : OK\n",__FILE__);
 }
+/* str2num() by strtod() */
+static double str2num_ref(const char *s, int i, int n)
+{
+    char str[256],*p=str;
+    for (s+=i;--n>=0&&*s;s++) *p++=((*s|0x20)=='d')?'E':*s;
+    *p='\0';
+    return strtod(str,NULL);
+}
+/* str2num(), str2dbl() bit-identical to strtod() */
+void utest12(void)
+{
+    const char *s1[]={
+        "","   ","-","+.","  .5","-0.000","0x1A","inf"," -nan","1e","1.5E+",
+        "1.2.3","12D3","1.25d-2","1e400","1e-400","0.1234567890123456789012",
+        "12345678901234567890123","9007199254740993","4.9406564584124654e-324",
+        "-123456789.123"," 1.0000000000000000000","0000000000000000000000012"
+    };
+    char buff[64],*e1,*e2;
+    double a,b,t;
+    int i,j;
+
+    for (i=0;i<(int)(sizeof(s1)/sizeof(*s1));i++) {
+        for (j=0;j<=(int)strlen(s1[i]);j++) {
+            a=str2num(s1[i],0,j); b=str2num_ref(s1[i],0,j);
+            assert(!memcmp(&a,&b,sizeof(a)));
+        }
+        a=str2dbl(s1[i],&e1); b=strtod(s1[i],&e2);
+        assert(!memcmp(&a,&b,sizeof(a))&&e1==e2);
+    }
+    srand(1);
+    for (i=0;i<1000000;i++) {
+        b=((double)rand()/RAND_MAX-0.5)*pow(10.0,rand()%20-6);
+        switch (i%4) {
+            case 0: sprintf(buff,"%14.3f%d%d",b,rand()%10,rand()%10); break;
+            case 1: sprintf(buff,"%19.12E",b); buff[15]='D'; break;
+            case 2: sprintf(buff,"%.*f",rand()%16,b); break;
+            case 3: sprintf(buff,"%14.3f",(double)(rand()%1000000000)*1E-3); break;
+        }
+        j=(int)strlen(buff)-rand()%3;
+        a=str2num(buff,0,j); b=str2num_ref(buff,0,j);
+        assert(!memcmp(&a,&b,sizeof(a)));
+        a=str2dbl(buff,&e1); b=strtod(buff,&e2);
+        assert(!memcmp(&a,&b,sizeof(a))&&e1==e2);
+    }
+    /* benchmark with RINEX OBS fields (F14.3) */
+    strcpy(buff,"  23456789.123  -1234567.456          .000");
+    t=(double)clock();
+    for (i=0,a=0.0;i<3000000;i++) a+=str2num(buff,i%3*14,14);
+    printf("str2num    : %6.3f s\n",((double)clock()-t)/CLOCKS_PER_SEC);
+    t=(double)clock();
+    for (i=0,b=0.0;i<3000000;i++) b+=str2num_ref(buff,i%3*14,14);
+    printf("str2num_ref: %6.3f s\n",((double)clock()-t)/CLOCKS_PER_SEC);
+    assert(!memcmp(&a,&b,sizeof(a)));
+
+    printf("%s utset12 : OK\n",__FILE__);
+}
 int main(void)
 {
     utest1();
@@ -307,5 +363,6 @@ int main(void)
     utest9();
     utest10();
     utest11();
+    utest12();
     return 0;
 }